@@ -712,6 +712,13 @@ public:
   inline bool empty() const { return _num_filled == 0; }
 
   inline size_type bucket_count() const { return _num_buckets; }
+
+  // prefetch the main bucket of key and its empty bit, ahead of a lookup or insert of key
+  inline void prefetch(const KeyT &key) const {
+    const auto bucket = hash_key(key) & _mask;
+    __builtin_prefetch(_pairs + bucket);
+    __builtin_prefetch(_bitmask + bucket / MASK_BIT);
+  }
   inline float load_factor() const { return ((float)_num_filled) / (_mask + 1); }
 
   inline HashT &hash_function() const { return _hasher; }
@@ -0,0 +1,161 @@
+#include "itch50BufferedHistDataSource.h"
+#include "itch50.h"
+#include <absl/log/log.h>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace bookproj {
+namespace datasource {
+
+namespace {
+constexpr size_t HugePageSize = size_t(1) << 21;
+
+constexpr size_t roundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+Itch50BufferedDataSource::Itch50BufferedDataSource(int date, std::string filename, int fd,
+                                                   size_t bufferSize, size_t numBuffers,
+                                                   size_t alignment)
+    : Itch50DataSource(date), filename_(std::move(filename)), fd_(fd),
+      bufferSize_(roundUp(bufferSize, alignment)), filled_(std::max<size_t>(numBuffers, 2)),
+      free_(std::max<size_t>(numBuffers, 2)) {
+  // the reader holds one buffer while waiting for the next, so at least 2
+  numBuffers = std::max<size_t>(numBuffers, 2);
+  const size_t stride = roundUp(Headroom + bufferSize_, alignment);
+  mappingSize_ = roundUp(numBuffers * stride, HugePageSize);
+  void *mapped = mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  hugePages_ = mapped != MAP_FAILED;
+  if (!hugePages_) {
+    // no huge pages reserved, or not enough
+    mapped = mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                  0);
+    if (mapped == MAP_FAILED) {
+      close(fd_);
+      throw std::runtime_error("Error mapping buffers for file " + filename_ + ": " +
+                               strerror(errno));
+    }
+    madvise(mapped, mappingSize_, MADV_HUGEPAGE);
+  }
+  mapping_ = static_cast<std::byte *>(mapped);
+
+  buffers_.reserve(numBuffers);
+  for (size_t ii = 0; ii < numBuffers; ++ii) {
+    buffers_.push_back({mapping_ + ii * stride + Headroom});
+    free_.push(&buffers_.back());
+  }
+}
+
+Itch50BufferedDataSource::~Itch50BufferedDataSource() {
+  stop();
+  munmap(mapping_, mappingSize_);
+  close(fd_);
+}
+
+void Itch50BufferedDataSource::start() {
+  // error_ is published by closing filled_
+  producer_ = std::thread([this] {
+    produce();
+    filled_.close();
+  });
+
+  // update nextTime and nextMessage
+  frame();
+}
+
+void Itch50BufferedDataSource::stop() {
+  if (producer_.joinable()) {
+    stopping_.store(true, std::memory_order_relaxed);
+    free_.close();
+    producer_.join();
+  }
+}
+
+Itch50BufferedDataSource::Buffer *Itch50BufferedDataSource::acquire() {
+  const auto free = free_.front();
+  if (free.empty() || stopping_.load(std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  Buffer *buffer = free[0];
+  free_.pop(1);
+  return buffer;
+}
+
+Itch50BufferedDataSource::Timestamp Itch50BufferedDataSource::advance() {
+  if (!nextMessage_.empty()) [[likely]] {
+    // 2 bytes are the big-endian size header in raw file
+    pos_ += 2 + nextMessage_.size();
+    currentOffset_ += 2 + nextMessage_.size();
+  }
+  return frame();
+}
+
+Itch50BufferedDataSource::Timestamp Itch50BufferedDataSource::skip(size_t bytes) {
+  if (!nextMessage_.empty()) [[likely]] {
+    pos_ += bytes;
+    currentOffset_ += bytes;
+  }
+  return frame();
+}
+
+Itch50BufferedDataSource::Timestamp Itch50BufferedDataSource::frame() {
+  while (!done_) {
+    // format is 2-byte bid-endian size followed by message of size bytes
+    const size_t avail = end_ - pos_;
+    if (avail >= 2) [[likely]] {
+      const size_t msgSize =
+          std::to_integer<size_t>(pos_[0]) * 256 | std::to_integer<size_t>(pos_[1]);
+      if (2 + msgSize <= avail) [[likely]] {
+        if (setNextMessage(pos_, msgSize)) [[likely]] {
+          return nextTime_;
+        }
+        if (msgSize < sizeof(itch50::CommonHeader)) {
+          LOG(ERROR) << "Itch50 file " << filename_ << " is not well formatted, read "
+                     << currentOffset_ << " bytes";
+          failed_ = true;
+        }
+        // else reached endTime
+        break;
+      }
+    }
+
+    // the message is cut off by the end of the buffer, continue it in front of the next one
+    const auto next = filled_.front();
+    if (next.empty() || avail > Headroom) [[unlikely]] {
+      // the producer sets error_ before it closes filled_, so it is only read once it has
+      const std::string error = next.empty() ? error_ : std::string();
+      if (!error.empty() || avail != 0) {
+        LOG(ERROR) << "Itch50 file " << filename_ << " is truncated or corrupt"
+                   << (error.empty() ? "" : ": " + error) << ", read " << currentOffset_
+                   << " bytes";
+        failed_ = true;
+      }
+      break;
+    }
+    Buffer *buffer = next[0];
+    filled_.pop(1);
+    std::byte *start = buffer->data - avail;
+    if (avail != 0) {
+      memcpy(start, pos_, avail);
+    }
+    if (current_ != nullptr) {
+      free_.push(current_);
+    }
+    current_ = buffer;
+    pos_ = start;
+    end_ = buffer->data + buffer->size;
+  }
+
+  // we have reached file end, or reached endTime, or errored out
+  done_ = true;
+  nextTime_ = Timestamp::max();
+  nextMessage_ = {};
+  return nextTime_;
+}
+
+} // namespace datasource
+} // namespace bookproj
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "itch50HistDataSource.h"
+#include "orderbook/SPSCRing.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bookproj {
+namespace datasource {
+
+// Itch50BufferedDataSource hands out the messages of a day file from a ring of buffers which a
+// background thread fills by produce() of the derived source.  The part of a message cut off at
+// the end of a buffer is moved to the headroom in front of the next one, so that each message,
+// and a block from it to the end of the buffer, is contiguous.  The buffers are in one mapping,
+// of reserved huge pages if there are enough, else advised to be backed by transparent ones
+class Itch50BufferedDataSource : public Itch50DataSource {
+public:
+  Itch50BufferedDataSource(const Itch50BufferedDataSource &) = delete;
+  Itch50BufferedDataSource &operator=(const Itch50BufferedDataSource &) = delete;
+
+  virtual ~Itch50BufferedDataSource();
+
+  virtual Timestamp advance() override;
+
+  virtual size_t currentOffset() const override { return currentOffset_; }
+
+  virtual std::span<const std::byte> nextBlock(size_t maxBytes = BlockSize) const override {
+    if (!hasMessage()) {
+      return {};
+    }
+    return {pos_, std::min(maxBytes, size_t(end_ - pos_))};
+  }
+  virtual Timestamp skip(size_t bytes) override;
+
+  // true if the buffers are in reserved huge pages
+  bool hugePages() const { return hugePages_; }
+
+protected:
+  struct Buffer {
+    // after the headroom
+    std::byte *data;
+    size_t size = 0;
+  };
+
+  // buffers of bufferSize rounded up to a multiple of alignment, their data aligned to it.  The
+  // source owns fd, and closes it even if this throws std::runtime_error, when the buffers can
+  // not be mapped
+  Itch50BufferedDataSource(int date, std::string filename, int fd, size_t bufferSize,
+                           size_t numBuffers, size_t alignment = 1);
+
+  // start the producer and frame the first message, last in the constructor of the derived
+  // source
+  void start();
+  // stop the producer, first in the destructor of the derived source
+  void stop();
+
+  // producer, fill buffers from acquire() and publish them until the end of the file, or an
+  // error set in error_, or until acquire() returns nullptr
+  virtual void produce() = 0;
+  // producer, the next buffer to fill, nullptr once the source is stopping
+  Buffer *acquire();
+  void publish(Buffer *buffer) { filled_.push(buffer); }
+
+  const std::string filename_;
+  const int fd_;
+  const size_t bufferSize_;
+  // set by the producer before it returns, the reader reads it once filled_ is closed
+  std::string error_;
+
+private:
+  // room for the cut off part of the largest message, with its size header
+  static constexpr size_t Headroom = size_t(1) << 17;
+
+  // frame the message at pos_, moving to the next buffer if it is cut off
+  Timestamp frame();
+
+  std::byte *mapping_ = nullptr;
+  size_t mappingSize_ = 0;
+  bool hugePages_ = false;
+
+  std::vector<Buffer> buffers_;
+  // filled buffers to read, and read ones to fill again
+  SPSCRing<Buffer *> filled_;
+  SPSCRing<Buffer *> free_;
+
+  Buffer *current_ = nullptr;
+  const std::byte *pos_ = nullptr;
+  const std::byte *end_ = nullptr;
+  size_t currentOffset_ = 0;
+
+  // no more messages after the end of the file, the end time or an error
+  bool done_ = false;
+
+  std::atomic<bool> stopping_ = false;
+  std::thread producer_;
+};
+
+} // namespace datasource
+} // namespace bookproj
\ No newline at end of file
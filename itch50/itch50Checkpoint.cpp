@@ -0,0 +1,206 @@
+#include "itch50Checkpoint.h"
+#include <absl/cleanup/cleanup.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bookproj {
+namespace itch50 {
+
+// file layout, in host byte order: the header, a symbol of 8 chars for each CID, a record for
+// each mapped locate, then the book checkpoint
+struct Itch50Checkpoint::Header {
+  char magic[8];
+  int32_t date;
+  uint32_t allSymbols;
+  int64_t time;
+  uint64_t offset;
+  uint64_t numSymbols;
+  uint64_t numLocates;
+};
+
+struct Itch50Checkpoint::LocateRecord {
+  uint32_t locate;
+  int32_t cid;
+};
+
+namespace {
+constexpr char Magic[8] = {'I', 'T', 'C', 'H', 'C', 'K', 'P', '1'};
+constexpr size_t SymbolSize = 8;
+} // namespace
+
+Itch50Checkpoint::Itch50Checkpoint(const std::string &path) : path_(path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open checkpoint " + path + ": " + strerror(errno));
+  }
+  absl::Cleanup file_closer = [fd] { close(fd); };
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    throw std::runtime_error("Error stating checkpoint " + path + ": " + strerror(errno));
+  }
+  if (size_t(sb.st_size) < sizeof(Header)) {
+    throw std::runtime_error("Checkpoint " + path + " is truncated");
+  }
+  void *mapped = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error("Error mmapping checkpoint " + path + ": " + strerror(errno));
+  }
+  data_ = {reinterpret_cast<const std::byte *>(mapped), size_t(sb.st_size)};
+  // the counts are checked by division, so that those of a corrupt header can not overflow
+  const Header &h = header();
+  const size_t symbolsSize = data_.size() - sizeof(Header);
+  if (!std::equal(std::begin(Magic), std::end(Magic), h.magic) ||
+      symbolsSize / SymbolSize < h.numSymbols ||
+      (symbolsSize - h.numSymbols * SymbolSize) / sizeof(LocateRecord) < h.numLocates) {
+    munmap(mapped, data_.size());
+    throw std::runtime_error("Checkpoint " + path + " is not a checkpoint or is truncated");
+  }
+}
+
+Itch50Checkpoint::~Itch50Checkpoint() {
+  munmap(const_cast<std::byte *>(data_.data()), data_.size());
+}
+
+void Itch50Checkpoint::save(const std::string &path, int date, std::chrono::nanoseconds time,
+                            uint64_t offset, bool allSymbols, const CIndex &cindex,
+                            const StockLocateMap &lindex, const orderbook::OrderBook &book) {
+  std::vector<LocateRecord> locates;
+  for (size_t loc = 1; loc < StockLocateMap::NumLocates; ++loc) {
+    if (const auto cid = lindex[StockLocate(uint16_t(loc))]; cid.valid()) {
+      locates.push_back({uint32_t(loc), orderbook::toUnderlying(cid)});
+    }
+  }
+  Header header{{}, date, allSymbols, time.count(), offset, cindex.size(), locates.size()};
+  std::copy(std::begin(Magic), std::end(Magic), header.magic);
+
+  // written to a temporary file first, so that a reader never sees a partial checkpoint
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (size_t ii = 0; ii < cindex.size(); ++ii) {
+      char symbol[SymbolSize] = {};
+      const Symbol sym = cindex[orderbook::CID(int32_t(ii))];
+      std::ranges::copy(sym.view(), symbol);
+      out.write(symbol, SymbolSize);
+    }
+    out.write(reinterpret_cast<const char *>(locates.data()),
+              locates.size() * sizeof(LocateRecord));
+    book.writeCheckpoint(out);
+    if (!out.flush()) {
+      throw std::runtime_error("Error writing checkpoint " + tmpPath + ": " + strerror(errno));
+    }
+  }
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Error renaming checkpoint " + tmpPath + ": " + strerror(errno));
+  }
+}
+
+const Itch50Checkpoint::Header &Itch50Checkpoint::header() const {
+  return *std::launder(reinterpret_cast<const Header *>(data_.data()));
+}
+
+int Itch50Checkpoint::date() const { return header().date; }
+std::chrono::nanoseconds Itch50Checkpoint::time() const {
+  return std::chrono::nanoseconds(header().time);
+}
+uint64_t Itch50Checkpoint::offset() const { return header().offset; }
+
+Symbol Itch50Checkpoint::symbol(size_t ii) const {
+  const char *chars = reinterpret_cast<const char *>(data_.data() + sizeof(Header)) +
+                      ii * SymbolSize;
+  return Symbol(std::string_view(chars, strnlen(chars, SymbolSize)));
+}
+
+std::span<const Itch50Checkpoint::LocateRecord> Itch50Checkpoint::locates() const {
+  return {std::launder(reinterpret_cast<const LocateRecord *>(
+              data_.data() + sizeof(Header) + header().numSymbols * SymbolSize)),
+          header().numLocates};
+}
+
+bool Itch50Checkpoint::matches(const CIndex &cindex, bool allSymbols) const {
+  if (allSymbols != (header().allSymbols != 0)) {
+    return false;
+  }
+  if (allSymbols) {
+    return cindex.size() == 0;
+  }
+  if (cindex.size() != header().numSymbols) {
+    return false;
+  }
+  for (size_t ii = 0; ii < cindex.size(); ++ii) {
+    if (cindex[orderbook::CID(int32_t(ii))] != symbol(ii)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Itch50Checkpoint::restore(CIndex &cindex, StockLocateMap &lindex,
+                               orderbook::OrderBook &book) const {
+  for (size_t ii = 0; ii < header().numSymbols; ++ii) {
+    if (cindex.findOrInsert(symbol(ii)) != orderbook::CID(int32_t(ii))) {
+      throw std::runtime_error("Checkpoint " + path_ + " has symbols other than the index");
+    }
+  }
+  for (const LocateRecord &record : locates()) {
+    const orderbook::CID cid(record.cid);
+    if (record.locate == 0 || record.locate >= StockLocateMap::NumLocates || !cid.valid() ||
+        std::cmp_greater_equal(record.cid, cindex.size())) {
+      throw std::runtime_error("Checkpoint " + path_ + " has a bad locate record");
+    }
+    if (lindex[cid].valid() || !lindex.insert(StockLocate(uint16_t(record.locate)), cid)) {
+      throw std::runtime_error("Checkpoint " + path_ + " has a duplicate locate record");
+    }
+  }
+  const size_t bookOffset = sizeof(Header) + header().numSymbols * SymbolSize +
+                            header().numLocates * sizeof(LocateRecord);
+  book.restoreCheckpoint(data_.subspan(bookOffset));
+}
+
+std::string Itch50Checkpoint::path(const std::string &dir, int date,
+                                   std::chrono::nanoseconds time) {
+  const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(time);
+  const std::chrono::hh_mm_ss hms(seconds);
+  return std::format("{}/nasdaq_itch.{}.{:02}{:02}{:02}.{:09}.ckpt", dir, date,
+                     hms.hours().count(), hms.minutes().count(), hms.seconds().count(),
+                     (time - seconds).count());
+}
+
+std::optional<std::string> Itch50Checkpoint::findBefore(const std::string &dir, int date,
+                                                        std::chrono::nanoseconds time) {
+  std::optional<std::string> found;
+  std::chrono::nanoseconds foundTime{-1};
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+    const std::string name = entry.path().filename().string();
+    int fileDate, hour, minute, second;
+    long nanos;
+    char suffix[5] = {};
+    if (std::sscanf(name.c_str(), "nasdaq_itch.%8d.%2d%2d%2d.%9ld.%4s", &fileDate, &hour,
+                    &minute, &second, &nanos, suffix) != 6 ||
+        fileDate != date || std::string_view(suffix) != "ckpt") {
+      continue;
+    }
+    const auto fileTime = std::chrono::hours(hour) + std::chrono::minutes(minute) +
+                          std::chrono::seconds(second) + std::chrono::nanoseconds(nanos);
+    if (fileTime < time && fileTime > foundTime) {
+      found = entry.path().string();
+      foundTime = fileTime;
+    }
+  }
+  return found;
+}
+
+} // namespace itch50
+} // namespace bookproj
\ No newline at end of file
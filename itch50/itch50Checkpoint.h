@@ -0,0 +1,66 @@
+#pragma once
+
+#include "itch50OrderBook.h"
+#include "orderbook/OrderBook.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace bookproj {
+namespace itch50 {
+
+// Itch50Checkpoint is the state of a replay of a day file after the messages up to a time: the
+// book, the symbol and locate indices, and the offset in the file of the first message after
+// the time.  Replay resumes from it by restoring the three and moving the source to the offset.
+// The file is mapped and the book restored from it in place, see OrderBook::restoreCheckpoint.
+// Checkpoints of a day are kept in a directory as nasdaq_itch.YYYYMMDD.HHMMSS.nnnnnnnnn.ckpt
+class Itch50Checkpoint {
+public:
+  // map the checkpoint at path, throw std::runtime_error if it can not be read or is not one
+  explicit Itch50Checkpoint(const std::string &path);
+  Itch50Checkpoint(const Itch50Checkpoint &) = delete;
+  Itch50Checkpoint &operator=(const Itch50Checkpoint &) = delete;
+  ~Itch50Checkpoint();
+
+  // write a checkpoint of a replay which books all symbols if allSymbols, else those in cindex.
+  // Throw std::runtime_error if the file can not be written
+  static void save(const std::string &path, int date, std::chrono::nanoseconds time,
+                   uint64_t offset, bool allSymbols, const CIndex &cindex,
+                   const StockLocateMap &lindex, const orderbook::OrderBook &book);
+
+  int date() const;
+  // time since midnight
+  std::chrono::nanoseconds time() const;
+  uint64_t offset() const;
+
+  // true if a replay of the same symbols can resume from the checkpoint: both book all symbols
+  // and cindex is empty, or both book the symbols of cindex
+  bool matches(const CIndex &cindex, bool allSymbols) const;
+
+  // restore the symbols, locates and book.  The book must be empty, cindex empty or holding the
+  // symbols of the checkpoint.  Throw std::runtime_error if the checkpoint is malformed
+  void restore(CIndex &cindex, StockLocateMap &lindex, orderbook::OrderBook &book) const;
+
+  static std::string path(const std::string &dir, int date, std::chrono::nanoseconds time);
+  // path of the latest checkpoint of date in dir before time, nullopt if there is none
+  static std::optional<std::string> findBefore(const std::string &dir, int date,
+                                               std::chrono::nanoseconds time);
+
+private:
+  struct Header;
+  struct LocateRecord;
+
+  const Header &header() const;
+  // symbol of CID ii
+  Symbol symbol(size_t ii) const;
+  std::span<const LocateRecord> locates() const;
+
+  std::string path_;
+  std::span<const std::byte> data_;
+};
+
+} // namespace itch50
+} // namespace bookproj
\ No newline at end of file
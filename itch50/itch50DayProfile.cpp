@@ -0,0 +1,90 @@
+#include "itch50DayProfile.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace bookproj {
+namespace itch50 {
+
+DayProfile DayProfile::load(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Failed to open profile " + path + ": " + strerror(errno));
+  }
+  DayProfile profile;
+  auto error = [&] {
+    return std::runtime_error("Error parsing profile " + path + " after " +
+                              std::to_string(profile.symbols.size()) + " symbols");
+  };
+  std::string line;
+  while (std::getline(in, line)) {
+    // a name and one or two counts
+    std::istringstream fields(line);
+    std::string name;
+    uint64_t first, second = 0;
+    if (!(fields >> name >> first)) {
+      throw error();
+    }
+    const bool hasSecond = bool(fields >> second);
+    if (!hasSecond && !fields.eof()) {
+      throw error();
+    }
+    if (hasSecond && !(fields >> std::ws).eof()) {
+      throw error();
+    }
+    if (name == "book") {
+      if (!hasSecond) {
+        throw error();
+      }
+      profile.maxNumOrders = first;
+      profile.maxNumLevels = second;
+    } else {
+      profile.symbols.push_back({Symbol(name), first, second});
+    }
+  }
+  if (in.bad()) {
+    throw error();
+  }
+  return profile;
+}
+
+void DayProfile::save(const std::string &path) const {
+  std::ofstream out(path);
+  out << "book " << maxNumOrders << ' ' << maxNumLevels << '\n';
+  for (const SymbolProfile &s : symbols) {
+    out << s.symbol.view() << ' ' << s.messages << ' ' << s.maxLevels << '\n';
+  }
+  if (!out.flush()) {
+    throw std::runtime_error("Error writing profile " + path + ": " + strerror(errno));
+  }
+}
+
+void Itch50ProfileHandler::addBook(const orderbook::OrderBook &book, const CIndex &cindex) {
+  maxNumOrders += book.maxNumOrders();
+  maxNumLevels += book.maxNumLevels();
+  cidLevels.resize(std::max(cidLevels.size(), cindex.size()));
+  for (size_t ii = 0; ii < cindex.size(); ++ii) {
+    cidLevels[ii] += book.maxNumLevels(orderbook::CID(ii));
+  }
+}
+
+DayProfile Itch50ProfileHandler::profile(const CIndex &cindex,
+                                         const StockLocateMap &lindex) const {
+  DayProfile profile;
+  profile.maxNumOrders = maxNumOrders;
+  profile.maxNumLevels = maxNumLevels;
+  for (size_t ii = 0; ii < cindex.size(); ++ii) {
+    const orderbook::CID cid(ii);
+    if (const StockLocate locate = lindex[cid]; locate.valid()) {
+      profile.symbols.push_back({cindex[cid], counts[uint16_t(locate)],
+                                 ii < cidLevels.size() ? cidLevels[ii] : 0});
+    }
+  }
+  return profile;
+}
+
+} // namespace itch50
+} // namespace bookproj
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "hash/emhash7.h"
+#include "itch50.h"
+#include "itch50OrderBook.h"
+#include "orderbook/OrderBook.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bookproj {
+namespace itch50 {
+
+// what the profile of a day records of a symbol
+struct SymbolProfile {
+  Symbol symbol;
+  // book messages of the day
+  uint64_t messages = 0;
+  // most levels of its book, see OrderBook::maxNumLevels(CID)
+  uint64_t maxLevels = 0;
+
+  bool operator==(const SymbolProfile &) const = default;
+};
+
+// DayProfile is what a run records about a day to plan the next one with: the peaks of the book,
+// and the book messages and levels of each symbol.  It is saved as a text file of a
+// "book maxNumOrders maxNumLevels" line and "symbol messages maxLevels" lines.  Files of
+// "symbol messages" lines only, from before the peaks were recorded, load with zero peaks
+struct DayProfile {
+  // peaks of the book, summed over shards
+  uint64_t maxNumOrders = 0;
+  uint64_t maxNumLevels = 0;
+  std::vector<SymbolProfile> symbols;
+
+  // peak scaled by headroom to reserve for, or fallback if the profile has no peaks
+  size_t reserveFor(uint64_t peak, double headroom, size_t fallback) const {
+    return maxNumOrders == 0 ? fallback : size_t(double(peak) * headroom);
+  }
+
+  bool operator==(const DayProfile &) const = default;
+
+  // throw std::runtime_error if the file can not be read or parsed
+  static DayProfile load(const std::string &path);
+  // throw std::runtime_error if the file can not be written
+  void save(const std::string &path) const;
+};
+
+// counts the book messages of each locate, for the profile of the day
+struct Itch50ProfileHandler {
+  Itch50ProfileHandler() : counts(StockLocateMap::NumLocates) {}
+
+  void process(const AddOrder &msg) { ++counts[+msg.header.stockLocate]; }
+  void process(const AddOrderMPID &msg) { ++counts[+msg.header.stockLocate]; }
+  void process(const OrderExecuted &msg) { ++counts[+msg.header.stockLocate]; }
+  void process(const OrderExecutedWithPrice &msg) { ++counts[+msg.header.stockLocate]; }
+  void process(const OrderCancel &msg) { ++counts[+msg.header.stockLocate]; }
+  void process(const OrderDelete &msg) { ++counts[+msg.header.stockLocate]; }
+  void process(const OrderReplace &msg) { ++counts[+msg.header.stockLocate]; }
+  template <typename Msg> void process(const Msg &) {}
+
+  // add the peaks of a book built of the day, at its end.  Those of the books of shards add up to
+  // at least the peaks of the books together, set maxNumOrders and maxNumLevels to those of
+  // ShardPeaks after adding them
+  void addBook(const orderbook::OrderBook &book, const CIndex &cindex);
+
+  // counts of the mapped locates and peaks of the books added, by symbol
+  DayProfile profile(const CIndex &cindex, const StockLocateMap &lindex) const;
+
+  std::vector<uint32_t> counts;
+  uint64_t maxNumOrders = 0;
+  uint64_t maxNumLevels = 0;
+  // most levels of each CID
+  std::vector<uint64_t> cidLevels;
+};
+
+// prepares the book of each symbol the stock directory maps for the levels it had in a profile,
+// see OrderBook::reserveLevels.  Without a book it does nothing, for books built by other threads
+template <typename B> struct Itch50ReserveHandler {
+  Itch50ReserveHandler(B *book_, const StockLocateMap &lindex_, const DayProfile &profile,
+                       double headroom)
+      : book(book_), lindex(lindex_) {
+    if (book != nullptr) {
+      for (const SymbolProfile &s : profile.symbols) {
+        levels.emplace(s.symbol, size_t(double(s.maxLevels) * headroom));
+      }
+    }
+  }
+
+  // after the symbol handler has mapped the locate
+  void process(const StockDirectory &msg) {
+    if (const auto cid = lindex[StockLocate(+msg.header.stockLocate)]; cid.valid()) {
+      if (auto it = levels.find(Symbol(stockName(msg.stock))); it != levels.end()) {
+        book->reserveLevels(cid, it->second);
+      }
+    }
+  }
+  template <typename Msg> void process(const Msg &) {}
+
+  B *book;
+  const StockLocateMap &lindex;
+  emhash7::HashMap<Symbol, size_t, Symbol::Hash> levels;
+};
+
+} // namespace itch50
+} // namespace bookproj
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "itch50DirectHistDataSource.h"
+#include "datasource/HistDataSourceFactory.h"
+#include <absl/log/log.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace bookproj {
+namespace datasource {
+
+namespace {
+int openFile(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY | O_DIRECT);
+  if (fd < 0 && errno == EINVAL) {
+    LOG(WARNING) << "O_DIRECT is not supported for file " << filename << ", reading it buffered";
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+  }
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file " + filename + ": " + strerror(errno));
+  }
+  return fd;
+}
+} // namespace
+
+Itch50DirectHistDataSource::Itch50DirectHistDataSource(int date, size_t bufferSize,
+                                                       size_t numBuffers)
+    : Itch50BufferedDataSource(date, filePath(date), openFile(filePath(date)), bufferSize,
+                               numBuffers, Alignment) {
+  start();
+}
+
+Itch50DirectHistDataSource::~Itch50DirectHistDataSource() { stop(); }
+
+void Itch50DirectHistDataSource::produce() {
+  while (Buffer *buffer = acquire()) {
+    buffer->size = 0;
+    bool eof = false;
+    while (buffer->size < bufferSize_ && !eof) {
+      const ssize_t n = ::read(fd_, buffer->data + buffer->size, bufferSize_ - buffer->size);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        error_ = std::string("read failed: ") + strerror(errno);
+        return;
+      }
+      buffer->size += n;
+      // reads are short of a multiple of the alignment only at the end of the file, and the
+      // offset is no longer aligned for another one after it
+      eof = n == 0 || n % Alignment != 0;
+    }
+    if (buffer->size != 0) {
+      publish(buffer);
+    }
+    if (eof) {
+      return;
+    }
+  }
+}
+
+bool Itch50DirectHistDataSource::registerCreator() {
+  return HistDataSourceFactory::instance().registerCreator(
+      std::string(name),
+      [](int date) { return std::make_unique<Itch50DirectHistDataSource>(date); });
+}
+
+} // namespace datasource
+} // namespace bookproj
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "itch50BufferedHistDataSource.h"
+#include <string_view>
+
+namespace bookproj {
+namespace datasource {
+
+// Itch50DirectHistDataSource streams an uncompressed day file with O_DIRECT reads, bypassing the
+// page cache, into a ring of numBuffers buffers of bufferSize bytes which a background thread
+// reads ahead into.  Unlike the mmapped Itch50HistDataSource, it takes no page faults or TLB
+// shootdowns as it goes.  It falls back to buffered reads if the file system does not support
+// O_DIRECT
+class Itch50DirectHistDataSource final : public Itch50BufferedDataSource {
+public:
+  // throw std::runtime_error if the file can not be opened
+  Itch50DirectHistDataSource(int date, size_t bufferSize = BlockSize, size_t numBuffers = 4);
+
+  virtual ~Itch50DirectHistDataSource();
+
+  // string name for for HistDataSourceFactory
+  static constexpr std::string_view name = "nasdaq_itch50_direct";
+  static bool registerCreator();
+
+  // alignment of the buffers, offsets and sizes of O_DIRECT reads
+  static constexpr size_t Alignment = 4096;
+
+private:
+  // read-ahead thread
+  virtual void produce() override;
+};
+
+} // namespace datasource
+} // namespace bookproj
\ No newline at end of file
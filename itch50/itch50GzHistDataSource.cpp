@@ -0,0 +1,102 @@
+#include "itch50GzHistDataSource.h"
+#include "datasource/HistDataSourceFactory.h"
+#include <absl/cleanup/cleanup.h>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace bookproj {
+namespace datasource {
+
+namespace {
+int openFile(const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file " + filename + ": " + strerror(errno));
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  return fd;
+}
+} // namespace
+
+Itch50GzHistDataSource::Itch50GzHistDataSource(int date, size_t bufferSize, size_t numBuffers)
+    : Itch50BufferedDataSource(date, filePath(date) + ".gz", openFile(filePath(date) + ".gz"),
+                               bufferSize, numBuffers) {
+  start();
+}
+
+Itch50GzHistDataSource::~Itch50GzHistDataSource() { stop(); }
+
+void Itch50GzHistDataSource::produce() {
+  z_stream zs = {};
+  // gzip header
+  if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+    error_ = "inflateInit2 failed";
+    return;
+  }
+  absl::Cleanup ender = [&zs] { inflateEnd(&zs); };
+
+  std::vector<unsigned char> input(1 << 20);
+  bool eof = false;
+  bool memberEnd = false;
+  // read more input if all is inflated, false at the end of the file or on error
+  auto read = [&]() {
+    if (zs.avail_in == 0 && !eof) {
+      const ssize_t n = ::read(fd_, input.data(), input.size());
+      if (n < 0) {
+        error_ = std::string("read failed: ") + strerror(errno);
+        return false;
+      }
+      eof = n == 0;
+      zs.next_in = input.data();
+      zs.avail_in = uInt(n);
+    }
+    return zs.avail_in != 0;
+  };
+
+  while (Buffer *buffer = acquire()) {
+    buffer->size = 0;
+    bool more = true;
+    while (buffer->size < bufferSize_ && more) {
+      if (!read()) {
+        // the end of the file must be the end of a member
+        if (error_.empty() && !memberEnd) {
+          error_ = "unexpected end of file";
+        }
+        more = false;
+        break;
+      }
+      if (memberEnd) {
+        // files may be concatenated gzip members
+        inflateReset(&zs);
+        memberEnd = false;
+      }
+      zs.next_out = reinterpret_cast<Bytef *>(buffer->data + buffer->size);
+      zs.avail_out = uInt(bufferSize_ - buffer->size);
+      const int ret = ::inflate(&zs, Z_NO_FLUSH);
+      buffer->size = bufferSize_ - zs.avail_out;
+      if (ret == Z_STREAM_END) {
+        memberEnd = true;
+      } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        error_ = zs.msg != nullptr ? zs.msg : "inflate failed";
+        more = false;
+      }
+    }
+    if (buffer->size != 0) {
+      publish(buffer);
+    }
+    if (!more) {
+      return;
+    }
+  }
+}
+
+bool Itch50GzHistDataSource::registerCreator() {
+  return HistDataSourceFactory::instance().registerCreator(
+      std::string(name), [](int date) { return std::make_unique<Itch50GzHistDataSource>(date); });
+}
+
+} // namespace datasource
+} // namespace bookproj
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "itch50BufferedHistDataSource.h"
+#include <string_view>
+
+namespace bookproj {
+namespace datasource {
+
+// Itch50GzHistDataSource reads a gzipped day file, rootPath/nasdaq_itch.YYYYMMDD.dat.gz.  A
+// background thread inflates the file into a ring of numBuffers buffers of bufferSize bytes, from
+// which messages are handed out in place
+class Itch50GzHistDataSource final : public Itch50BufferedDataSource {
+public:
+  // throw std::runtime_error if the file can not be opened
+  Itch50GzHistDataSource(int date, size_t bufferSize = BlockSize, size_t numBuffers = 4);
+
+  virtual ~Itch50GzHistDataSource();
+
+  // string name for for HistDataSourceFactory
+  static constexpr std::string_view name = "nasdaq_itch50_gz";
+  static bool registerCreator();
+
+private:
+  // inflater thread
+  virtual void produce() override;
+};
+
+} // namespace datasource
+} // namespace bookproj
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "itch50HistDataSource.h"
+#include "datasource/HistDataSourceFactory.h"
 #include "itch50.h"
+#include "itch50SeekIndex.h"
 #include <absl/cleanup/cleanup.h>
 #include <absl/log/log.h>
 #include <cstddef>
@@ -13,7 +15,7 @@
 namespace bookproj {
 namespace datasource {
 
-HistDataSource::Timestamp Itch50HistDataSource::midnightNYTime(int date) {
+HistDataSource::Timestamp Itch50DataSource::midnightNYTime(int date) {
   auto tz = ::getenv("TZ");
   ::setenv("TZ", ":America/New_York", 1);
   ::tzset();
@@ -36,9 +38,53 @@ HistDataSource::Timestamp Itch50HistDataSource::midnightNYTime(int date) {
   return midnight;
 }
 
-Itch50HistDataSource::Itch50HistDataSource(int date) : midnight_(midnightNYTime(date)) {
+Itch50DataSource::Timestamp Itch50DataSource::seek(Timestamp time) {
+  if (seekIndex_ != nullptr && nextTime_ < time) {
+    const auto *entry = seekIndex_->find(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(time - midnight_));
+    if (entry != nullptr && entry->offset > currentOffset()) {
+      jump(entry->offset);
+    }
+  }
+  while (nextTime_ < time) {
+    advance();
+  }
+  return nextTime_;
+}
+
+Itch50DataSource::Timestamp Itch50DataSource::seekOffset(size_t offset) {
+  if (hasMessage() && offset > currentOffset() && !jump(offset)) {
+    while (hasMessage() && currentOffset() < offset) {
+      advance();
+    }
+  }
+  return nextTime_;
+}
+
+bool Itch50DataSource::setNextMessage(const std::byte *msg, size_t msgSize) {
+  if (msgSize < sizeof(itch50::CommonHeader)) [[unlikely]] {
+    return false;
+  }
+  // peak at time first, which is nanoseconds offset from midnight_
+  const itch50::CommonHeader *header =
+      std::launder(reinterpret_cast<const itch50::CommonHeader *>(msg + 2));
+  nextTime_ = midnight_ + std::chrono::nanoseconds(itch50::nanosSinceMidnight(header->timestamp));
+  if (nextTime_ > endTime_) [[unlikely]] {
+    return false;
+  }
+  nextMessage_ = std::span(msg + 2, msgSize);
+  return true;
+}
+
+std::string Itch50DataSource::rootPath_;
+void Itch50DataSource::setRootPath(const std::string &rootPath) { rootPath_ = rootPath; }
+std::string Itch50DataSource::filePath(int date) {
+  return rootPath_ + '/' + "nasdaq_itch." + std::to_string(date) + ".dat";
+}
+
+Itch50HistDataSource::Itch50HistDataSource(int date) : Itch50DataSource(date) {
   // open and mmap the file, throw if anything fails
-  std::string filename = rootPath_ + '/' + "nasdaq_itch." + std::to_string(date) + ".dat";
+  std::string filename = filePath(date);
   int fd = open(filename.c_str(), O_RDONLY);
   if (fd < 0) {
     throw std::runtime_error("Failed to open file " + filename + ": " + strerror(errno));
@@ -69,22 +115,32 @@ Itch50HistDataSource::~Itch50HistDataSource() {
   }
 }
 
-Itch50HistDataSource::Timestamp Itch50HistDataSource::seek(Timestamp time) {
-  while (nextTime_ < time) {
-    Itch50HistDataSource::advance();
-  }
-  return nextTime_;
-}
-
 Itch50HistDataSource::Timestamp Itch50HistDataSource::advance() {
   if (!nextMessage_.empty()) [[likely]] {
     // 2 bytes are the big-endian size header in raw file
     currentOffset_ += 2 + nextMessage_.size();
-    if (currentOffset_ >= unmappedSize_ + CHUNK_SIZE) [[unlikely]] {
-      size_t unmapSz = (currentOffset_ - unmappedSize_) / CHUNK_SIZE * CHUNK_SIZE;
-      munmap(data_ + unmappedSize_, unmapSz);
-      unmappedSize_ += unmapSz;
-    }
+  }
+  return frame();
+}
+
+Itch50HistDataSource::Timestamp Itch50HistDataSource::skip(size_t bytes) {
+  if (!nextMessage_.empty()) [[likely]] {
+    currentOffset_ += bytes;
+  }
+  return frame();
+}
+
+bool Itch50HistDataSource::jump(size_t offset) {
+  currentOffset_ = offset;
+  frame();
+  return true;
+}
+
+Itch50HistDataSource::Timestamp Itch50HistDataSource::frame() {
+  if (currentOffset_ >= unmappedSize_ + CHUNK_SIZE) [[unlikely]] {
+    size_t unmapSz = (currentOffset_ - unmappedSize_) / CHUNK_SIZE * CHUNK_SIZE;
+    munmap(data_ + unmappedSize_, unmapSz);
+    unmappedSize_ += unmapSz;
   }
 
   // format is 2-byte bid-endian size followed by message of size bytes
@@ -94,13 +150,7 @@ Itch50HistDataSource::Timestamp Itch50HistDataSource::advance() {
                      std::to_integer<size_t>(data_[currentOffset_ + 1]);
     if ((msgSize >= sizeof(itch50::CommonHeader)) & (msgStart + msgSize <= totalSize_))
         [[likely]] {
-      // peak at time first, which is nanoseconds offset from midnight_
-      const itch50::CommonHeader *header =
-          std::launder(reinterpret_cast<const itch50::CommonHeader *>(data_ + msgStart));
-      nextTime_ =
-          midnight_ + std::chrono::nanoseconds(itch50::nanosSinceMidnight(header->timestamp));
-      if (nextTime_ <= endTime_) [[likely]] {
-        nextMessage_ = std::span(data_ + msgStart, msgSize);
+      if (setNextMessage(data_ + currentOffset_, msgSize)) [[likely]] {
         return nextTime_;
       } else {
         // reached endTime, update currentOffset_ to suppress error below
@@ -114,14 +164,17 @@ Itch50HistDataSource::Timestamp Itch50HistDataSource::advance() {
     LOG(ERROR) << "Itch50HistDataSource file is not well formatted or truncated, read "
                << currentOffset_ << " out of " << totalSize_ << " bytes";
     currentOffset_ = totalSize_;
+    failed_ = true;
   }
   nextTime_ = Timestamp::max();
   nextMessage_ = {};
   return nextTime_;
 }
 
-std::string Itch50HistDataSource::rootPath_;
-void Itch50HistDataSource::setRootPath(const std::string &rootPath) { rootPath_ = rootPath; }
+bool Itch50HistDataSource::registerCreator() {
+  return HistDataSourceFactory::instance().registerCreator(
+      std::string(name), [](int date) { return std::make_unique<Itch50HistDataSource>(date); });
+}
 
 } // namespace datasource
 } // namespace bookproj
\ No newline at end of file
@@ -1,39 +1,112 @@
 #pragma once
 
 #include "datasource/HistDataSource.h"
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <string>
+
 namespace bookproj {
 namespace datasource {
 
-class Itch50HistDataSource final : public HistDataSource {
-public:
-  Itch50HistDataSource(int date);
-  Itch50HistDataSource(const Itch50HistDataSource &) = delete;
-  Itch50HistDataSource &operator=(const Itch50HistDataSource &) = delete;
-
-  virtual ~Itch50HistDataSource();
+class Itch50SeekIndex;
 
-  virtual Timestamp seek(Timestamp time) override;
-  virtual Timestamp advance() override;
+// Itch50DataSource is a source of the messages of a nasdaq itch50 day file, which can also hand
+// out the following messages as framed in the file, in blocks for itch50::parseMessagesUntil
+class Itch50DataSource : public HistDataSource {
+public:
+  explicit Itch50DataSource(int date) : midnight_(midnightNYTime(date)) {}
 
   // set a end time so that no message should be delivered after the given time,
   // in other words, messages delivered are in the range of [seekTime, endTime]
   void setEndTime(Timestamp endTime) { endTime_ = endTime; }
 
-  // return the current offset into the data file
-  size_t currentOffset() const { return currentOffset_; }
+  // end time as nanoseconds since midnight
+  std::chrono::nanoseconds endTimeSinceMidnight() const {
+    return endTime_ == Timestamp::max() ? std::chrono::nanoseconds::max() : endTime_ - midnight_;
+  }
+
+  Timestamp midnight() const { return midnight_; }
+
+  // seek is a jump by the index, if the source can jump, followed by advancing to time
+  virtual Timestamp seek(Timestamp time) override;
+  // move to the message at offset, at or after the next message, by a jump if the source can
+  Timestamp seekOffset(size_t offset);
+  // index of the day file of the source, nullptr for none
+  void setSeekIndex(std::shared_ptr<const Itch50SeekIndex> index) {
+    seekIndex_ = std::move(index);
+  }
+
+  // return the current offset into the (uncompressed) data file
+  virtual size_t currentOffset() const = 0;
+
+  // the file from the next message on, up to maxBytes, framed as in the file for
+  // itch50::parseMessagesUntil with endTimeSinceMidnight().  Empty if there is no next message
+  virtual std::span<const std::byte> nextBlock(size_t maxBytes = BlockSize) const = 0;
+  // advance past bytes of whole messages of nextBlock(), return the time of the next message
+  virtual Timestamp skip(size_t bytes) = 0;
+  // true if the source ran out of messages on a truncated or corrupt file, or on an error
+  // reading it, rather than at its end or the end time.  The error is logged
+  bool failed() const { return failed_; }
 
   // return a timestamp that represents the midnight of the given date in NY time
   static Timestamp midnightNYTime(int date);
 
   // root path where data files are located, file path as rootPath/nasdaq_itch.YYYYMMDD.dat
   static void setRootPath(const std::string &rootPath);
+  static std::string filePath(int date);
+
+  static constexpr size_t BlockSize = 1 << 22;
+
+protected:
+  // frame the message of msgSize at msg, which starts with the size header, as the next
+  // message.  False if msgSize is too small for a message or the message is after the end time,
+  // nextMessage_ is left as is then
+  bool setNextMessage(const std::byte *msg, size_t msgSize);
+
+  // move to the message at offset, which is after the next message.  False if the source can
+  // not jump, and is left as is then
+  virtual bool jump(size_t) { return false; }
+
+  Timestamp midnight_;
+  Timestamp endTime_ = Timestamp::max();
+  std::shared_ptr<const Itch50SeekIndex> seekIndex_;
+  bool failed_ = false;
+
+  static std::string rootPath_;
+};
+
+// Itch50HistDataSource mmaps an uncompressed day file
+class Itch50HistDataSource final : public Itch50DataSource {
+public:
+  Itch50HistDataSource(int date);
+  Itch50HistDataSource(const Itch50HistDataSource &) = delete;
+  Itch50HistDataSource &operator=(const Itch50HistDataSource &) = delete;
+
+  virtual ~Itch50HistDataSource();
+
+  virtual Timestamp advance() override;
+
+  virtual size_t currentOffset() const override { return currentOffset_; }
+
+  virtual std::span<const std::byte> nextBlock(size_t maxBytes = BlockSize) const override {
+    if (!hasMessage()) {
+      return {};
+    }
+    return {data_ + currentOffset_, std::min(maxBytes, totalSize_ - currentOffset_)};
+  }
+  virtual Timestamp skip(size_t bytes) override;
 
   // string name for for HistDataSourceFactory
   static constexpr std::string name = "nasdaq_itch50";
+  static bool registerCreator();
+
+protected:
+  virtual bool jump(size_t offset) override;
 
 private:
-  Timestamp midnight_;
-  Timestamp endTime_ = Timestamp::max();
+  // frame the message at currentOffset_, unmapping the chunks before it
+  Timestamp frame();
 
   size_t currentOffset_ = 0;
   size_t totalSize_ = 0;
@@ -43,7 +116,6 @@ private:
   size_t unmappedSize_ = 0;
 
   static constexpr size_t CHUNK_SIZE = 1 << 22;
-  static std::string rootPath_;
 };
 
 } // namespace datasource
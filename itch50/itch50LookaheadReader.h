@@ -0,0 +1,129 @@
+#pragma once
+
+#include "datasource/HistDataSource.h"
+#include "itch50.h"
+#include "itch50OrderBook.h"
+#include "itch50RawParser.h"
+#include "orderbook/OrderCommon.h"
+#include <bit>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace bookproj {
+namespace itch50 {
+
+// Itch50LookaheadReader reads messages from a HistDataSource depth messages ahead of the one it
+// hands out, and prefetches the book state of the orders they refer to: the order index slot as
+// a message enters the window, the order and its level once it is halfway through, so the cache
+// misses of upcoming messages overlap with the handling of the current one.  Messages are copied
+// into the window since the source may unmap what it advanced past.  Book is an OrderBook or a
+// StaticOrderBook.  With a StockLocateMap, messages of unmapped locates are not prefetched
+template <typename Book> class Itch50LookaheadReader {
+public:
+  using Timestamp = datasource::HistDataSource::Timestamp;
+  using RefNum = orderbook::ReferenceNum;
+
+  Itch50LookaheadReader(datasource::HistDataSource &source_, const Book &book_, size_t depth_,
+                        const StockLocateMap *lindex_ = nullptr)
+      : source(source_), book(book_), lindex(lindex_), depth(depth_),
+        window(std::bit_ceil(depth + 1)), mask(window.size() - 1) {
+    fill();
+    for (size_t ii = 1; ii <= depth / 2 && ii < count; ++ii) {
+      prefetchOrder(at(ii));
+    }
+  }
+
+  Itch50LookaheadReader(const Itch50LookaheadReader &) = delete;
+  Itch50LookaheadReader &operator=(const Itch50LookaheadReader &) = delete;
+
+  bool hasMessage() const { return count != 0; }
+  Timestamp nextTime() const { return hasMessage() ? at(0).time : Timestamp::max(); }
+  std::span<const std::byte> nextMessage() const {
+    return hasMessage() ? std::span<const std::byte>(at(0).bytes) : std::span<const std::byte>{};
+  }
+
+  void advance() {
+    if (count != 0) {
+      head = (head + 1) & mask;
+      --count;
+    }
+    fill();
+    if (depth / 2 < count) {
+      prefetchOrder(at(depth / 2));
+    }
+  }
+
+private:
+  struct Entry {
+    Timestamp time;
+    std::vector<std::byte> bytes;
+    // reference number of the order the message changes or adds, 0 for none
+    uint64_t refNum = 0;
+    bool isNew = false;
+  };
+
+  // peeks the reference numbers of messages
+  struct Peeker {
+    void process(const AddOrder &msg) { peek(msg.header, +msg.orderReferenceNumber, true); }
+    void process(const AddOrderMPID &msg) { peek(msg.header, +msg.orderReferenceNumber, true); }
+    void process(const OrderExecuted &msg) { peek(msg.header, +msg.orderReferenceNumber); }
+    void process(const OrderExecutedWithPrice &msg) {
+      peek(msg.header, +msg.orderReferenceNumber);
+    }
+    void process(const OrderCancel &msg) { peek(msg.header, +msg.orderReferenceNumber); }
+    void process(const OrderDelete &msg) { peek(msg.header, +msg.orderReferenceNumber); }
+    void process(const OrderReplace &msg) {
+      peek(msg.header, +msg.originalOrderReferenceNumber);
+    }
+    template <typename Msg> void process(const Msg &) {}
+
+    void peek(const CommonHeader &header, uint64_t refNum, bool isNew = false) {
+      if (lindex == nullptr || lindex->contains(StockLocate(+header.stockLocate))) {
+        entry.refNum = refNum;
+        entry.isNew = isNew;
+      }
+    }
+
+    Entry &entry;
+    const StockLocateMap *lindex;
+  };
+
+  Entry &at(size_t ahead) { return window[(head + ahead) & mask]; }
+  const Entry &at(size_t ahead) const { return window[(head + ahead) & mask]; }
+
+  // read from source until depth messages are ahead of the current one
+  void fill() {
+    while (count <= depth && source.hasMessage()) {
+      Entry &entry = at(count++);
+      const auto msg = source.nextMessage();
+      entry.time = source.nextTime();
+      entry.bytes.assign(msg.begin(), msg.end());
+      entry.refNum = 0;
+      Peeker peeker{entry, lindex};
+      parseMessage(entry.bytes, peeker);
+      if (entry.refNum != 0) {
+        book.prefetchIndex(RefNum(entry.refNum));
+      }
+      source.advance();
+    }
+  }
+
+  void prefetchOrder(const Entry &entry) {
+    if (entry.refNum != 0 && !entry.isNew) {
+      book.prefetchOrder(RefNum(entry.refNum));
+    }
+  }
+
+  datasource::HistDataSource &source;
+  const Book &book;
+  const StockLocateMap *lindex;
+  const size_t depth;
+  std::vector<Entry> window;
+  const size_t mask;
+  size_t head = 0;
+  size_t count = 0;
+};
+
+} // namespace itch50
+} // namespace bookproj
\ No newline at end of file
@@ -1,13 +1,15 @@
 #pragma once
 
 #include "ankerl/unordered_dense.h"
-#include "hash/emhash7.h"
 #include "itch50.h"
 #include "orderbook/CIndex.h"
 #include "orderbook/OrderBook.h"
+#include "orderbook/SPSCRing.h"
 #include "orderbook/Symbol.h"
 #include <chrono>
+#include <span>
 #include <utility>
+#include <vector>
 
 namespace bookproj {
 namespace itch50 {
@@ -30,24 +32,35 @@ private:
   uint16_t val;
 };
 
-// a bidirectional hashmap between StockLocate and CID
-// this is similar to a CIndex, but does not sequentially allocate CIDs
+// a bidirectional map between StockLocate and CID
+// this is similar to a CIndex, but does not sequentially allocate CIDs.  Locates are 16 bits, so
+// locate to CID is a flat array, with a bitset of the mapped locates to filter messages on
 struct StockLocateMap {
   using CID = orderbook::CID;
+  static constexpr size_t NumLocates = size_t(1) << 16;
 
-  StockLocateMap() : locate2CID{{StockLocate::invalid(), CID::invalid()}} {}
+  StockLocateMap() : locate2CID(NumLocates, CID::invalid()) {}
 
   bool insert(StockLocate locate, CID cid) {
     assert(cid.valid() && locate.valid());
-    if (locate2CID.emplace(locate, cid).second) {
-      auto ind = orderbook::toUnderlying(cid);
-      if (std::cmp_greater_equal(ind, cid2Locate.size())) {
-        cid2Locate.resize(ind + 1, StockLocate::invalid());
-      }
-      cid2Locate[ind] = locate;
-      return true;
+    if (contains(locate)) {
+      return false;
+    }
+    const uint16_t loc(locate);
+    locate2CID[loc] = cid;
+    mapped[loc / 64] |= uint64_t(1) << (loc % 64);
+    ++count;
+    auto ind = orderbook::toUnderlying(cid);
+    if (std::cmp_greater_equal(ind, cid2Locate.size())) {
+      cid2Locate.resize(ind + 1, StockLocate::invalid());
     }
-    return false;
+    cid2Locate[ind] = locate;
+    return true;
+  }
+
+  bool contains(StockLocate locate) const {
+    const uint16_t loc(locate);
+    return (mapped[loc / 64] >> (loc % 64)) & 1;
   }
 
   StockLocate operator[](CID cid) const {
@@ -57,24 +70,18 @@ struct StockLocateMap {
     return StockLocate::invalid();
   }
 
-  CID operator[](StockLocate locate) const {
-    if (auto it = locate2CID.find(locate); it != locate2CID.end()) {
-      return it->second;
-    }
-    return CID::invalid();
-  }
+  // invalid for an unmapped locate
+  CID operator[](StockLocate locate) const { return locate2CID[uint16_t(locate)]; }
 
-  // minus 1 for invalid mapping
-  size_t size() const { return locate2CID.size() - 1; }
+  size_t size() const { return count; }
 
-  void reserve(size_t n) {
-    locate2CID.reserve(n);
-    cid2Locate.reserve(n);
-  }
+  void reserve(size_t n) { cid2Locate.reserve(n); }
 
 private:
-  emhash7::HashMap<StockLocate, orderbook::CID, StockLocate::Hash> locate2CID;
+  std::vector<CID> locate2CID;
+  uint64_t mapped[NumLocates / 64] = {};
   std::vector<StockLocate> cid2Locate;
+  size_t count = 0;
 };
 
 // UTC time
@@ -83,114 +90,183 @@ using Timestamp = std::chrono::time_point<std::chrono::system_clock, std::chrono
 using Symbol = orderbook::Symbol<8>;
 using CIndex = orderbook::CIndex<orderbook::CID, Symbol>;
 
+// Book is an OrderBook, or a StaticOrderBook to have listeners bound at compile time.
+// AddAllSymbols books every symbol, else only the symbols mapped in the StockLocateMap.  With a
+// batchSize, book operations are collected and applied batchSize at a time with Book::apply,
+// which prefetches ahead; messages not changing the book flush them, so do the end of input via
+// flush.
+template <typename Book = orderbook::OrderBook, bool AddAllSymbols = false>
 struct Itch50QuoteHandler {
-  using Book = orderbook::OrderBook;
-  using Order = Book::OrderExt;
   using RefNum = orderbook::ReferenceNum;
   using Size = orderbook::Quantity;
   using Price = orderbook::Price;
   using CID = orderbook::CID;
   using Side = orderbook::Side;
+  using BookOp = orderbook::BookOp;
 
   Itch50QuoteHandler(Book &book_, const StockLocateMap &lindex_, Timestamp midnight_,
-                     bool addAllSymbols_)
-      : book(book_), lindex(lindex_), midnight(midnight_), addAllSymbols(addAllSymbols_) {}
+                     size_t batchSize_ = 0)
+      : book(book_), lindex(lindex_), midnight(midnight_), batchSize(batchSize_) {
+    // the book keeps order timestamps as nanoseconds since midnight
+    book.setMidnight(midnight);
+    pending.reserve(batchSize);
+  }
 
   void process(const AddOrder &msg) {
     CID cid = lindex[StockLocate(+msg.header.stockLocate)];
     if (cid.valid()) {
-      book.newOrder(RefNum(+msg.orderReferenceNumber), cid,
-                    msg.buySellIndicator == 'B' ? Side::Bid : Side::Ask, Size(msg.shares),
-                    Price(double(+msg.price)), getTimestamp(msg.header));
+      submit(BookOp::newOrder(RefNum(+msg.orderReferenceNumber), cid,
+                              msg.buySellIndicator == 'B' ? Side::Bid : Side::Ask,
+                              Size(msg.shares), toPrice(+msg.price), getTimestamp(msg.header)));
     }
   }
 
   void process(const AddOrderMPID &msg) {
     CID cid = lindex[StockLocate(+msg.header.stockLocate)];
     if (cid.valid()) {
-      book.newOrder(RefNum(+msg.orderReferenceNumber), cid,
-                    msg.buySellIndicator == 'B' ? Side::Bid : Side::Ask, Size(msg.shares),
-                    Price(double(+msg.price)), getTimestamp(msg.header));
+      submit(BookOp::newOrder(RefNum(+msg.orderReferenceNumber), cid,
+                              msg.buySellIndicator == 'B' ? Side::Bid : Side::Ask,
+                              Size(msg.shares), toPrice(+msg.price), getTimestamp(msg.header)));
     }
   }
 
   void process(const OrderExecuted &msg) {
-    if (addAllSymbols || lindex[StockLocate(+msg.header.stockLocate)].valid()) {
+    if (isBooked(msg.header)) {
       orderbook::ExecInfo ei;
       ei.printable = true;
       ei.matchNum = +msg.matchNumber;
-      book.executeOrder(RefNum(+msg.orderReferenceNumber), Size(msg.executedShares), ei,
-                        getTimestamp(msg.header));
+      submit(msg.header,
+             BookOp::executeOrder(RefNum(+msg.orderReferenceNumber), Size(msg.executedShares), ei,
+                                  getTimestamp(msg.header)));
     }
   }
 
   void process(const OrderExecutedWithPrice &msg) {
-    if (addAllSymbols || lindex[StockLocate(+msg.header.stockLocate)].valid()) {
+    if (isBooked(msg.header)) {
       orderbook::ExecInfo ei;
       ei.matchNum = +msg.matchNumber;
-      ei.price = Price(double(+msg.executionPrice));
+      ei.price = toPrice(+msg.executionPrice);
       ei.hasPrice = true;
       ei.printable = msg.printable == 'Y';
-      book.executeOrder(RefNum(+msg.orderReferenceNumber), Size(msg.executedShares), ei,
-                        getTimestamp(msg.header));
+      submit(msg.header,
+             BookOp::executeOrder(RefNum(+msg.orderReferenceNumber), Size(msg.executedShares), ei,
+                                  getTimestamp(msg.header)));
     }
   }
 
   void process(const OrderCancel &msg) {
-    if (addAllSymbols || lindex[StockLocate(+msg.header.stockLocate)].valid()) {
-      book.reduceOrderBy(RefNum(+msg.orderReferenceNumber), Size(+msg.canceledShares),
-                         getTimestamp(msg.header));
+    if (isBooked(msg.header)) {
+      submit(msg.header, BookOp::reduceOrderBy(RefNum(+msg.orderReferenceNumber),
+                                               Size(+msg.canceledShares),
+                                               getTimestamp(msg.header)));
     }
   }
 
   void process(const OrderDelete &msg) {
-    if (addAllSymbols || lindex[StockLocate(+msg.header.stockLocate)].valid()) {
-      book.deleteOrder(RefNum(+msg.orderReferenceNumber), getTimestamp(msg.header));
+    if (isBooked(msg.header)) {
+      submit(msg.header,
+             BookOp::deleteOrder(RefNum(+msg.orderReferenceNumber), getTimestamp(msg.header)));
     }
   }
 
   void process(const OrderReplace &msg) {
-    if (addAllSymbols || lindex[StockLocate(+msg.header.stockLocate)].valid()) {
-      Order *oldOrder = book.findOrder(RefNum(+msg.originalOrderReferenceNumber));
-      if (oldOrder == nullptr) {
-        // unable to add new order since no side/mpid information
-        LOG(WARNING) << "Order with refNum " << msg.originalOrderReferenceNumber
-                     << " not found in replaceOrder, ignored";
-      } else {
-        oldOrder->updateTime = getTimestamp(msg.header);
-        book.replaceOrder(oldOrder, RefNum(+msg.newOrderReferenceNumber), Size(+msg.shares),
-                          Price(double(+msg.price)), oldOrder->updateTime);
-      }
+    if (isBooked(msg.header)) {
+      // the book warns and ignores it if the old order is not found, no side to add it on
+      submit(msg.header, BookOp::replaceOrder(RefNum(+msg.originalOrderReferenceNumber),
+                                              RefNum(+msg.newOrderReferenceNumber),
+                                              Size(+msg.shares), toPrice(+msg.price),
+                                              getTimestamp(msg.header)));
     }
   }
 
-  // catchall, does nothing for other messages
-  template <typename Msg> void process(const Msg &) {}
+  // catchall, applies pending operations so that the book is current for other handlers
+  template <typename Msg> void process(const Msg &) { flush(); }
+
+  // apply pending operations
+  void flush() {
+    if (!pending.empty()) {
+      book.apply(std::span<const BookOp>(pending));
+      pending.clear();
+    }
+  }
 
   Timestamp getTimestamp(const CommonHeader &header) const {
     return midnight + std::chrono::nanoseconds(nanosSinceMidnight(header.timestamp));
   }
 
+  // orders of all symbols are in the book, orders in unmapped locates are not
+  bool isBooked(const CommonHeader &header) const {
+    return AddAllSymbols || lindex.contains(StockLocate(+header.stockLocate));
+  }
+
+  // exact, without going through double
+  static constexpr Price toPrice(Price4 price) { return Price::fromScaled<4>(price.value); }
+
   Book &book;
   const StockLocateMap &lindex;
   const Timestamp midnight;
-  const bool addAllSymbols;
+  const size_t batchSize;
+
+private:
+  void submit(const BookOp &op) {
+    if (batchSize == 0) {
+      book.apply(op);
+      return;
+    }
+    pending.push_back(op);
+    if (pending.size() == batchSize) {
+      flush();
+    }
+  }
+
+  // operations on existing orders carry the CID of the message too, for routing by CID
+  void submit(const CommonHeader &header, BookOp op) {
+    op.cid = lindex[StockLocate(+header.stockLocate)];
+    submit(op);
+  }
+
+  std::vector<BookOp> pending;
 };
 
+// a Book for Itch50QuoteHandler that pushes the book operations to a ring, so that another
+// thread applies them to the book with applyBookOps.  Set the midnight on that book
+struct BookOpWriter {
+  using BookOp = orderbook::BookOp;
+
+  explicit BookOpWriter(SPSCRing<BookOp> &ring_) : ring(ring_) {}
+
+  void setMidnight(Timestamp) {}
+  void apply(const BookOp &op) { ring.push(op); }
+  void apply(std::span<const BookOp> ops) {
+    for (const BookOp &op : ops) {
+      ring.push(op);
+    }
+  }
+
+  SPSCRing<BookOp> &ring;
+};
+
+// apply book operations from ring to book, until the writer closes the ring
+template <typename Book> void applyBookOps(SPSCRing<orderbook::BookOp> &ring, Book &book) {
+  for (auto ops = ring.front(); !ops.empty(); ops = ring.front()) {
+    book.apply(ops);
+    ring.pop(ops.size());
+  }
+}
+
 struct Itch50SymbolHandler {
-  Itch50SymbolHandler(CIndex &cindex_, StockLocateMap &lindex_, bool addAll_)
+  // when adding all symbols, room for numSymbols is reserved in the indices
+  Itch50SymbolHandler(CIndex &cindex_, StockLocateMap &lindex_, bool addAll_,
+                      size_t numSymbols = 16384)
       : cindex(cindex_), lindex(lindex_), addAll(addAll_) {
     if (addAll) {
-      lindex.reserve(16384);
-      cindex.reserve(16384);
+      lindex.reserve(numSymbols);
+      cindex.reserve(numSymbols);
     }
   }
 
-  template <typename Msg>
-    requires requires(Msg msg) {
-      { msg.stock } -> std::same_as<char(&)[8]>;
-    }
-  void process(const Msg &msg) {
+  // the stock directory maps each locate of the day, before any other message of the locate
+  void process(const StockDirectory &msg) {
     handleSymbol(msg.stock, StockLocate(+msg.header.stockLocate));
   }
 
@@ -199,7 +275,7 @@ struct Itch50SymbolHandler {
 private:
   void handleSymbol(const char (&stock)[8], StockLocate locate) {
     if (addAll) {
-      if (locate.valid() && !lindex[locate].valid()) {
+      if (locate.valid() && !lindex.contains(locate)) {
         if (auto cid = cindex.findOrInsert(Symbol(stockName(stock))); cid.valid()) {
           lindex.insert(locate, cid);
         } else {
@@ -1,8 +1,15 @@
 #include "OrderBook.h"
+#include "datasource/HistDataSourceFactory.h"
 #include "itch50.h"
+#include "itch50Checkpoint.h"
+#include "itch50DayProfile.h"
+#include "itch50DirectHistDataSource.h"
+#include "itch50GzHistDataSource.h"
 #include "itch50HistDataSource.h"
+#include "itch50LookaheadReader.h"
 #include "itch50OrderBook.h"
 #include "itch50RawParser.h"
+#include "itch50ShardedBook.h"
 #include "orderbook/OrderBookPrinter.h"
 #include <absl/flags/flag.h>
 #include <absl/flags/parse.h>
@@ -16,6 +23,7 @@
 #include <mimalloc.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <thread>
 #include <unistd.h>
 
 namespace bookproj {
@@ -209,19 +217,37 @@ private:
 } // namespace itch50
 } // namespace bookproj
 
+using bookproj::SPSCRing;
+using bookproj::datasource::HistDataSourceFactory;
+using bookproj::datasource::Itch50DataSource;
+using bookproj::datasource::Itch50DirectHistDataSource;
+using bookproj::datasource::Itch50GzHistDataSource;
 using bookproj::datasource::Itch50HistDataSource;
+using bookproj::itch50::applyBookOps;
+using bookproj::itch50::BookOpWriter;
 using bookproj::itch50::CIndex;
+using bookproj::itch50::Itch50Checkpoint;
+using bookproj::itch50::DayProfile;
+using bookproj::itch50::ShardedBookOpWriter;
+using bookproj::itch50::ShardMap;
+using bookproj::itch50::ShardPeaks;
 using bookproj::itch50::StockLocateMap;
 using bookproj::itch50::Symbol;
 using bookproj::itch50::Timestamp;
 using bookproj::orderbook::BookID;
+using bookproj::orderbook::BookOp;
 using bookproj::orderbook::CID;
+using bookproj::orderbook::StaticOrderBook;
 
 using Listener = bookproj::itch50::Listener;
 using Book = bookproj::orderbook::OrderBook;
 using NBMHandler = bookproj::itch50::Itch50NBMUpdateHandler;
-using QuoteHandler = bookproj::itch50::Itch50QuoteHandler;
+template <typename B, bool AddAllSymbols>
+using QuoteHandler = bookproj::itch50::Itch50QuoteHandler<B, AddAllSymbols>;
 using SymbolHandler = bookproj::itch50::Itch50SymbolHandler;
+using ProfileHandler = bookproj::itch50::Itch50ProfileHandler;
+template <typename B> using ReserveHandler = bookproj::itch50::Itch50ReserveHandler<B>;
+template <typename B> using LookaheadReader = bookproj::itch50::Itch50LookaheadReader<B>;
 
 ABSL_FLAG(int32_t, date, 0, "date of the input itch file, as yyyymmdd");
 ABSL_FLAG(bool, printUpdate, true, "print book updates");
@@ -230,6 +256,44 @@ ABSL_FLAG(bool, printOther, true, "print non-book modifying updates");
 ABSL_FLAG(std::string, startTime, "00:00:00", "start time to print, HH:MM:SS.usec");
 ABSL_FLAG(std::string, endTime, "23:59:59", "stop time, HH:MM:SS.usec");
 ABSL_FLAG(std::vector<std::string>, symbols, {}, "symbols to print");
+ABSL_FLAG(uint64_t, orderWindow, 0,
+          "size of the sliding window of reference numbers whose orders are stored in an array "
+          "instead of the order hashmap, 0 to use the hashmap only");
+ABSL_FLAG(uint64_t, batchSize, 0,
+          "number of book operations applied together, prefetching the orders and levels of "
+          "the ones ahead, 0 to apply each message as it is parsed");
+ABSL_FLAG(uint32_t, lookahead, 0,
+          "number of messages read ahead of the book, prefetching the orders they refer to, 0 to "
+          "read messages one at a time");
+ABSL_FLAG(bool, pipeline, false,
+          "decode messages on a separate thread, which passes book operations to the one "
+          "building the book; requires --printUpdate=false and --lookahead=0");
+ABSL_FLAG(uint32_t, shards, 0,
+          "number of threads building the book, each the books of a share of the symbols, while "
+          "this one decodes messages, 0 for none; requires --printUpdate=false and "
+          "--lookahead=0");
+ABSL_FLAG(std::string, profile, "",
+          "profile written by --writeProfile on a previous day, to balance the symbols of the "
+          "shards by their message counts and to reserve the books for its peaks");
+ABSL_FLAG(double, reserveHeadroom, 1.25,
+          "factor the peaks of --profile are scaled by to reserve the order and level maps and "
+          "pools, the symbol indices and the levels of each symbol for; without a profile they "
+          "are reserved for busy days");
+ABSL_FLAG(std::string, writeProfile, "", "file to write the profile of this day to");
+ABSL_FLAG(bool, gzip, false,
+          "read the gzipped file nasdaq_itch.YYYYMMDD.dat.gz, inflating it on a separate thread");
+ABSL_FLAG(bool, hugePages, true,
+          "allocate the order and level pools of books from reserved huge pages, or from memory "
+          "advised to be backed by transparent ones if there are not enough");
+ABSL_FLAG(bool, direct, false,
+          "read the file with O_DIRECT on a separate thread rather than mmap it");
+ABSL_FLAG(std::string, checkpointDir, "",
+          "directory of book checkpoints.  The book is restored from the latest checkpoint before "
+          "--startTime and only the rest of the day is replayed; requires --pipeline=false, "
+          "--shards=0 and --lookahead=0");
+ABSL_FLAG(std::string, checkpointInterval, "",
+          "write a checkpoint to --checkpointDir at every multiple of this interval since "
+          "midnight, HH:MM:SS.usec, empty for none");
 
 Timestamp::duration parseStringToDuration(const std::string &str) {
   // TODO: update when std::chrono::from_stream is supported
@@ -244,6 +308,266 @@ Timestamp::duration parseStringToDuration(const std::string &str) {
   exit(EXIT_FAILURE);
 }
 
+// the printing listener reads back the book it listens to, so the two are built together.  The
+// book only keeps a reference to the listener, which is constructed right after it
+struct PrintingBook {
+  PrintingBook(const CIndex &cindex, Timestamp start, int depth)
+      : book(BookID{0}, listener), listener(book, cindex, start, depth) {}
+
+  StaticOrderBook<Listener> book;
+  Listener listener;
+};
+
+// the book takes a share of the orders and levels of a day, the peaks of the previous day with
+// some headroom, or sized for busy days without a profile
+template <typename B> void reserveBook(B &book, size_t share, const DayProfile &previous) {
+  if (absl::GetFlag(FLAGS_hugePages)) {
+    book.setChunkProvider(bookproj::HugePageChunkProvider::instance());
+  }
+  const double headroom = absl::GetFlag(FLAGS_reserveHeadroom);
+  book.reserve(65535, previous.reserveFor(previous.maxNumOrders, headroom, 4 << 20) / share,
+               previous.reserveFor(previous.maxNumLevels, headroom, 2 << 19) / share);
+  book.reserveOrderWindow(absl::GetFlag(FLAGS_orderWindow));
+  book.resize(CID(65535));
+}
+
+// build book from the itch file of date, returns the exit code.  AddAllSymbols if cindex is empty
+template <bool AddAllSymbols, typename BookT>
+int buildBook(BookT &book, CIndex &cindex, int date, Timestamp midnight, Timestamp start,
+              Timestamp::duration end) {
+  DayProfile previous;
+  try {
+    if (const std::string path = absl::GetFlag(FLAGS_profile); !path.empty()) {
+      previous = DayProfile::load(path);
+    }
+  } catch (const std::runtime_error &e) {
+    std::cerr << "Error loading profile: " << e.what() << std::endl;
+    return 1;
+  }
+  const double headroom = absl::GetFlag(FLAGS_reserveHeadroom);
+  // quote/misc handlers use StockLocateMap to filter symbols
+  StockLocateMap stockLocateMap;
+  SymbolHandler symbolHandler(
+      cindex, stockLocateMap, AddAllSymbols,
+      previous.symbols.empty() ? 16384 : size_t(double(previous.symbols.size()) * headroom));
+  // the levels of each symbol are reserved as it is mapped, on this thread so only if it builds
+  // the book
+  const bool bookOnThisThread = !absl::GetFlag(FLAGS_pipeline) && absl::GetFlag(FLAGS_shards) == 0;
+  ReserveHandler<BookT> reserveHandler(bookOnThisThread ? &book : nullptr, stockLocateMap,
+                                       previous, headroom);
+  NBMHandler miscHandler(cindex, stockLocateMap, midnight,
+                         absl::GetFlag(FLAGS_printOther) ? start : Timestamp::max(),
+                         AddAllSymbols);
+  ProfileHandler profileHandler;
+
+  Itch50HistDataSource::setRootPath("/opt/data");
+  std::string_view sourceName = Itch50HistDataSource::name;
+  if (absl::GetFlag(FLAGS_gzip)) {
+    sourceName = Itch50GzHistDataSource::name;
+  } else if (absl::GetFlag(FLAGS_direct)) {
+    sourceName = Itch50DirectHistDataSource::name;
+  }
+  std::unique_ptr<Itch50DataSource> source;
+  try {
+    auto created = HistDataSourceFactory::instance().create(std::string(sourceName), date);
+    auto *itch = dynamic_cast<Itch50DataSource *>(created.get());
+    if (itch == nullptr) {
+      std::cerr << "Error creating data source: no itch50 source " << sourceName << std::endl;
+      return 1;
+    }
+    created.release();
+    source.reset(itch);
+    source->setEndTime(midnight + end);
+  } catch (const std::runtime_error &e) {
+    std::cerr << "Error creating data source: " << e.what() << std::endl;
+    return 1;
+  }
+  const auto startProcessing = std::chrono::steady_clock::now();
+  uint64_t numMessages = 0;
+  auto reportError = [&](bookproj::itch50::ParseResultType result, Timestamp time) {
+    std::cerr << "Error parsing message: " << bookproj::itch50::toString(result)
+              << " file offset: " << source->currentOffset() << " time: "
+              << std::format("{:%Y%m%d %H:%M:%S}", bookproj::itch50::toNYTime(time)) << std::endl;
+  };
+  // reader is a lookahead window over the source
+  auto processMessages = [&](auto &reader, auto &quoteHandler) {
+    while (reader.hasMessage()) {
+      ++numMessages;
+      auto result =
+          bookproj::itch50::parseMessage(reader.nextMessage(), symbolHandler, reserveHandler,
+                                         quoteHandler, miscHandler, profileHandler);
+      if (result != bookproj::itch50::ParseResultType::Success) [[unlikely]] {
+        // the source is past the lookahead window
+        reportError(result, reader.nextTime());
+        break;
+      }
+      reader.advance();
+    }
+  };
+  // the replay resumes from the latest checkpoint before start, and writes one after the
+  // messages up to each multiple of the interval
+  const std::string checkpointDir = absl::GetFlag(FLAGS_checkpointDir);
+  std::chrono::nanoseconds resumeTime{0};
+  std::chrono::nanoseconds checkpointInterval{0};
+  std::chrono::nanoseconds nextCheckpoint = std::chrono::nanoseconds::max();
+  if (const std::string interval = absl::GetFlag(FLAGS_checkpointInterval); !interval.empty()) {
+    checkpointInterval = parseStringToDuration(interval);
+  }
+  auto resume = [&]() {
+    if (const auto path = Itch50Checkpoint::findBefore(checkpointDir, date, start - midnight)) {
+      Itch50Checkpoint checkpoint(*path);
+      if (!checkpoint.matches(cindex, AddAllSymbols)) {
+        std::cerr << "Skipping checkpoint of other symbols " << *path << std::endl;
+      } else {
+        checkpoint.restore(cindex, stockLocateMap, book);
+        source->seekOffset(checkpoint.offset());
+        resumeTime = checkpoint.time();
+        std::cerr << "Restored " << book.numOrders() << " orders from checkpoint " << *path
+                  << std::endl;
+      }
+    }
+    if (checkpointInterval.count() > 0) {
+      nextCheckpoint = (resumeTime / checkpointInterval + 1) * checkpointInterval;
+    }
+  };
+  auto writeCheckpoint = [&](std::chrono::nanoseconds time) {
+    const std::string path = Itch50Checkpoint::path(checkpointDir, date, time);
+    try {
+      Itch50Checkpoint::save(path, date, time, source->currentOffset(), AddAllSymbols, cindex,
+                             stockLocateMap, book);
+    } catch (const std::runtime_error &e) {
+      std::cerr << "Error writing checkpoint: " << e.what() << std::endl;
+    }
+  };
+  // blocks of the file are parsed in one loop each, then the source skips what was handled
+  auto processBlocks = [&](auto &quoteHandler) {
+    while (source->hasMessage()) {
+      const auto parsed = bookproj::itch50::parseMessagesUntil(
+          source->nextBlock(), std::min(nextCheckpoint, source->endTimeSinceMidnight()),
+          symbolHandler, reserveHandler, quoteHandler, miscHandler, profileHandler);
+      numMessages += parsed.count;
+      source->skip(parsed.offset);
+      if (parsed.result != bookproj::itch50::ParseResultType::Success) [[unlikely]] {
+        reportError(parsed.result, source->nextTime());
+        break;
+      }
+      if (source->hasMessage() && source->nextTime() - midnight > nextCheckpoint) {
+        // the book has all messages up to the checkpoint, the intervals without any message
+        // would have the same checkpoint
+        quoteHandler.flush();
+        writeCheckpoint(nextCheckpoint);
+        nextCheckpoint = ((source->nextTime() - midnight) / checkpointInterval + 1) *
+                         checkpointInterval;
+      }
+    }
+  };
+  auto readMessages = [&](auto &quoteHandler) {
+    if (const uint32_t lookahead = absl::GetFlag(FLAGS_lookahead); lookahead > 0) {
+      LookaheadReader<BookT> reader(*source, book, lookahead,
+                                    AddAllSymbols ? nullptr : &stockLocateMap);
+      processMessages(reader, quoteHandler);
+    } else {
+      processBlocks(quoteHandler);
+    }
+    quoteHandler.flush();
+  };
+  // stats of the book, summed over shards.  The peaks of shards need not be at the same time, so
+  // those of the books together are taken from ShardPeaks instead
+  size_t numOrders = 0, numLevels = 0, maxNumOrders = 0, maxNumLevels = 0;
+  bookproj::ChunkCounts orderChunks{}, levelChunks{};
+  auto addStats = [&](const auto &b) {
+    numOrders += b.numOrders();
+    numLevels += b.numLevels();
+    maxNumOrders += b.maxNumOrders();
+    maxNumLevels += b.maxNumLevels();
+    for (size_t ii = 0; ii < orderChunks.size(); ++ii) {
+      orderChunks[ii] += b.orderChunks()[ii];
+      levelChunks[ii] += b.levelChunks()[ii];
+    }
+    profileHandler.addBook(b, cindex);
+  };
+  if (const uint32_t numShards = absl::GetFlag(FLAGS_shards); numShards > 0) {
+    // this thread decodes and routes operations by CID, each shard's thread builds its books
+    ShardMap shardMap(numShards, cindex, previous);
+    ShardPeaks peaks(numShards, 1 << 16);
+    ShardedBookOpWriter writer(shardMap, 1 << 16, &peaks);
+    QuoteHandler<ShardedBookOpWriter, AddAllSymbols> decoder(writer, stockLocateMap, midnight);
+    std::vector<std::unique_ptr<StaticOrderBook<>>> shardBooks;
+    std::vector<std::thread> shardThreads;
+    for (uint32_t ii = 0; ii < numShards; ++ii) {
+      auto &shardBook = *shardBooks.emplace_back(new StaticOrderBook<>(BookID(ii)));
+      reserveBook(shardBook, numShards, previous);
+      shardBook.setMidnight(midnight);
+      shardThreads.emplace_back([&peaks, &writer, &shardBook, ii] {
+        peaks.applyBookOps(ii, writer.ring(ii), shardBook);
+      });
+    }
+    std::thread peaksThread([&peaks] { peaks.run(); });
+    readMessages(decoder);
+    writer.close();
+    for (uint32_t ii = 0; ii < numShards; ++ii) {
+      shardThreads[ii].join();
+      std::cerr << std::format("shard {} expected messages={} remaining orders={}\n", ii,
+                               shardMap.expectedLoads()[ii], shardBooks[ii]->numOrders());
+      addStats(*shardBooks[ii]);
+    }
+    peaksThread.join();
+    maxNumOrders = profileHandler.maxNumOrders = peaks.maxNumOrders();
+    maxNumLevels = profileHandler.maxNumLevels = peaks.maxNumLevels();
+  } else if (absl::GetFlag(FLAGS_pipeline)) {
+    // the decoder thread owns the source and the symbol indices, this one only the book
+    SPSCRing<BookOp> ring(1 << 16);
+    BookOpWriter writer(ring);
+    QuoteHandler<BookOpWriter, AddAllSymbols> decoder(writer, stockLocateMap, midnight);
+    reserveBook(book, 1, previous);
+    book.setMidnight(midnight);
+    std::thread decoderThread([&] {
+      readMessages(decoder);
+      ring.close();
+    });
+    applyBookOps(ring, book);
+    decoderThread.join();
+    addStats(book);
+  } else {
+    reserveBook(book, 1, previous);
+    // the handler sets the midnight of the empty book, before it is restored
+    QuoteHandler<BookT, AddAllSymbols> quoteHandler(book, stockLocateMap, midnight,
+                                                    absl::GetFlag(FLAGS_batchSize));
+    if (!checkpointDir.empty()) {
+      try {
+        resume();
+      } catch (const std::runtime_error &e) {
+        std::cerr << "Error restoring checkpoint: " << e.what() << std::endl;
+        return 1;
+      }
+    }
+    readMessages(quoteHandler);
+    addStats(book);
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startProcessing;
+  std::cerr << std::format("processed {} messages in {:.3f}s, {:.0f} messages/s\n", numMessages,
+                           elapsed.count(), numMessages / elapsed.count());
+  std::cerr << "done processing book, remaining orders=" << numOrders
+            << ", remaining levels=" << numLevels << '\n';
+  std::cerr << "maxNumOrders=" << maxNumOrders << ", maxNumLevels=" << maxNumLevels << "\n";
+  std::cerr << "order pool chunks: " << bookproj::toString(orderChunks)
+            << ", level pool chunks: " << bookproj::toString(levelChunks) << '\n';
+  // the book is of part of the day, the source logged why
+  if (source->failed()) {
+    std::cerr << "Error reading data source, the book is incomplete" << std::endl;
+    return 1;
+  }
+  if (const std::string path = absl::GetFlag(FLAGS_writeProfile); !path.empty()) {
+    try {
+      profileHandler.profile(cindex, stockLocateMap).save(path);
+    } catch (const std::runtime_error &e) {
+      std::cerr << "Error writing profile: " << e.what() << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
   mi_option_set(mi_option_allow_large_os_pages, 1);
   absl::SetProgramUsageMessage("Utility to print nasdaq itch50 books for given date");
@@ -258,6 +582,34 @@ int main(int argc, char *argv[]) {
     std::cerr << "Error: a valid date must be provided must be provided via --date\n";
     return 1;
   }
+  // the printing listener reads the symbol index which the decoder thread inserts into, and the
+  // lookahead reader prefetches from the book which the other thread changes
+  if ((absl::GetFlag(FLAGS_pipeline) || absl::GetFlag(FLAGS_shards) > 0) &&
+      (absl::GetFlag(FLAGS_printUpdate) || absl::GetFlag(FLAGS_lookahead) > 0)) {
+    std::cerr << "Error: --pipeline and --shards require --printUpdate=false and --lookahead=0\n";
+    return 1;
+  }
+  // checkpoints are of the one book this thread builds
+  if (!absl::GetFlag(FLAGS_checkpointDir).empty() &&
+      (absl::GetFlag(FLAGS_pipeline) || absl::GetFlag(FLAGS_shards) > 0 ||
+       absl::GetFlag(FLAGS_lookahead) > 0)) {
+    std::cerr << "Error: --checkpointDir requires --pipeline=false, --shards=0 and "
+                 "--lookahead=0\n";
+    return 1;
+  }
+  if (!absl::GetFlag(FLAGS_checkpointInterval).empty() &&
+      absl::GetFlag(FLAGS_checkpointDir).empty()) {
+    std::cerr << "Error: --checkpointInterval requires --checkpointDir\n";
+    return 1;
+  }
+  if (absl::GetFlag(FLAGS_gzip) && absl::GetFlag(FLAGS_direct)) {
+    std::cerr << "Error: --gzip and --direct are exclusive\n";
+    return 1;
+  }
+  // the day file is read by the source of the factory --gzip and --direct name
+  Itch50HistDataSource::registerCreator();
+  Itch50GzHistDataSource::registerCreator();
+  Itch50DirectHistDataSource::registerCreator();
   Timestamp midnight = Itch50HistDataSource::midnightNYTime(date);
   Timestamp start = midnight + parseStringToDuration(absl::GetFlag(FLAGS_startTime));
   Timestamp::duration end = parseStringToDuration(absl::GetFlag(FLAGS_endTime));
@@ -265,58 +617,25 @@ int main(int argc, char *argv[]) {
   std::cerr << std::format("start={:%Y%m%d %H:%M:%S} end={:%H:%M:%S}\n",
                            bookproj::itch50::toNYTime(start),
                            bookproj::itch50::toNYTime(midnight + end));
-  Book book(BookID{0});
-  book.reserve(65535, 4 << 20, 2 << 19);
-  book.resize(CID(65535));
-  static_assert(sizeof(Book::OrderExt) == 72);
-  static_assert(sizeof(Book::Level) == 48);
+  static_assert(sizeof(Book::OrderExt) == 24);
+  static_assert(sizeof(Book::Level) == 40);
 
-  // quote/misc handlers use StockLocateMap to filter symbols
-  StockLocateMap stockLocateMap;
   CIndex cindex;
   for (const auto &symbol : absl::GetFlag(FLAGS_symbols)) {
     cindex.findOrInsert(Symbol(symbol));
   }
-  bool addAllSymbols = cindex.size() == 0;
 
-  Listener listener(book, cindex, start, absl::GetFlag(FLAGS_depth));
+  // without symbols all are booked, the quote handler is compiled for either case
+  auto build = [&](auto &book) {
+    return cindex.size() == 0 ? buildBook<true>(book, cindex, date, midnight, start, end)
+                              : buildBook<false>(book, cindex, date, midnight, start, end);
+  };
+  // listeners are bound to the book at compile time, so without printing the book does not
+  // spend anything on notifications
   if (absl::GetFlag(FLAGS_printUpdate)) {
-    book.addListener(&listener);
+    PrintingBook printing(cindex, start, absl::GetFlag(FLAGS_depth));
+    return build(printing.book);
   }
-
-  SymbolHandler symbolHandler(cindex, stockLocateMap, addAllSymbols);
-  QuoteHandler quoteHandler(book, stockLocateMap, midnight, addAllSymbols);
-  NBMHandler miscHandler(cindex, stockLocateMap, midnight,
-                         absl::GetFlag(FLAGS_printOther) ? start : Timestamp::max(),
-                         addAllSymbols);
-
-  Itch50HistDataSource::setRootPath("/opt/data");
-  std::unique_ptr<Itch50HistDataSource> source;
-  try {
-    source.reset(new Itch50HistDataSource(date));
-    source->setEndTime(midnight + end);
-  } catch (const std::runtime_error &e) {
-    std::cerr << "Error creating data source: " << e.what() << std::endl;
-    return 1;
-  }
-  while (source->hasMessage()) {
-    auto result = bookproj::itch50::parseMessage(source->nextMessage(), symbolHandler,
-                                                 quoteHandler, miscHandler);
-    if (result != bookproj::itch50::ParseResultType::Success) [[unlikely]] {
-      std::cerr << "Error parsing message: " << bookproj::itch50::toString(result)
-                << " file offset: " << source->currentOffset() << " time: "
-                << std::format("{:%Y%m%d %H:%M:%S}",
-                               bookproj::itch50::toNYTime(source->nextTime()))
-                << std::endl;
-      break;
-    }
-    source->advance();
-  }
-  std::cerr << "done processing book, remaining orders=" << book.numOrders()
-            << ", remaining levels=" << book.numLevels() << '\n';
-  std::cerr << "maxNumOrders=" << book.maxNumOrders() << ", maxNumLevels=" << book.maxNumLevels()
-            << "\n";
-
-  book.removeListener(&listener);
-  return 0;
+  StaticOrderBook<> book(BookID{0});
+  return build(book);
 }
\ No newline at end of file
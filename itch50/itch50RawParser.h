@@ -1,6 +1,10 @@
 #pragma once
 
 #include "itch50.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <span>
 
@@ -11,62 +15,131 @@ enum class ParseResultType { Success, BadMsgType, BadSize };
 
 std::string toString(ParseResultType type);
 
+namespace detail {
+// message type char and the message struct of it
+template <char C, typename Msg> struct MsgKind {
+  static constexpr char typeChar = C;
+  using type = Msg;
+};
+
+template <typename... Kinds> struct MsgKinds {};
+
+using AllMsgKinds =
+    MsgKinds<MsgKind<'S', SystemEvent>, MsgKind<'R', StockDirectory>,
+             MsgKind<'H', StockTradingAction>, MsgKind<'Y', RegShoRestriction>,
+             MsgKind<'L', MarketParticipantPosition>, MsgKind<'V', MWCBDeclineLevel>,
+             MsgKind<'W', MWCBStatus>, MsgKind<'K', QuotingPeriodUpdate>,
+             MsgKind<'J', LULDAuctionCollar>, MsgKind<'h', OperationalHalt>,
+             MsgKind<'A', AddOrder>, MsgKind<'F', AddOrderMPID>, MsgKind<'E', OrderExecuted>,
+             MsgKind<'C', OrderExecutedWithPrice>, MsgKind<'X', OrderCancel>,
+             MsgKind<'D', OrderDelete>, MsgKind<'U', OrderReplace>, MsgKind<'P', Trade>,
+             MsgKind<'Q', CrossTrade>, MsgKind<'B', BrokenTrade>, MsgKind<'I', NOII>,
+             MsgKind<'N', RPII>, MsgKind<'O', StockTradingAction>>;
+
+// table of the size and the handler call of each message type char, for a pack of handlers.  A
+// type char without a message has no thunk
+template <typename... Handlers> struct DispatchTable {
+  using Thunk = void (*)(const char *data, Handlers &...handlers);
+  struct Entry {
+    size_t size = std::numeric_limits<size_t>::max();
+    Thunk thunk = nullptr;
+  };
+
+  template <typename Msg> static void dispatch(const char *data, Handlers &...handlers) {
+    const Msg *msg = std::launder(reinterpret_cast<const Msg *>(data));
+    (handlers.process(*msg), ...);
+  }
+
+  template <typename... Kinds> static constexpr std::array<Entry, 256> make(MsgKinds<Kinds...>) {
+    std::array<Entry, 256> table{};
+    ((table[uint8_t(Kinds::typeChar)] = {sizeof(typename Kinds::type),
+                                         &dispatch<typename Kinds::type>}),
+     ...);
+    return table;
+  }
+
+  static constexpr std::array<Entry, 256> entries = make(AllMsgKinds{});
+};
+} // namespace detail
+
 template <typename... Args>
 ParseResultType parseMessage(std::span<const std::byte> msg, Args &...handler) {
   const char *data = reinterpret_cast<const char *>(msg.data());
 
   const CommonHeader *header = std::launder(reinterpret_cast<const CommonHeader *>(data));
-  char typeChar = header->messageType;
-  size_t expectedSz = std::numeric_limits<size_t>::max();
-  switch (typeChar) {
-#define CASE(c, MsgType)                                                                          \
-  case c: {                                                                                       \
-    expectedSz = sizeof(MsgType);                                                                 \
-    if (expectedSz <= msg.size()) {                                                               \
-      const MsgType *msg = std::launder(reinterpret_cast<const MsgType *>(data));                 \
-      (handler.process(*msg), ...);                                                               \
-    }                                                                                             \
-    break;                                                                                        \
-  }
-    CASE('S', SystemEvent);
-    CASE('R', StockDirectory);
-    CASE('H', StockTradingAction);
-    CASE('Y', RegShoRestriction);
-    CASE('L', MarketParticipantPosition);
-    CASE('V', MWCBDeclineLevel);
-    CASE('W', MWCBStatus);
-    CASE('K', QuotingPeriodUpdate);
-    CASE('J', LULDAuctionCollar);
-    CASE('h', OperationalHalt);
-    CASE('A', AddOrder);
-    CASE('F', AddOrderMPID);
-    CASE('E', OrderExecuted);
-    CASE('C', OrderExecutedWithPrice);
-    CASE('X', OrderCancel);
-    CASE('D', OrderDelete);
-    CASE('U', OrderReplace);
-    CASE('P', Trade);
-    CASE('Q', CrossTrade);
-    CASE('B', BrokenTrade);
-    CASE('I', NOII);
-    CASE('N', RPII);
-    CASE('O', StockTradingAction);
-
-#undef CASE
-  default:
-    break;
+  const auto &entry = detail::DispatchTable<Args...>::entries[uint8_t(header->messageType)];
+  // we allow expected size to be smaller in case message has new extension
+  if (entry.size > msg.size()) [[unlikely]] {
+    return entry.thunk == nullptr ? ParseResultType::BadMsgType : ParseResultType::BadSize;
   }
+  entry.thunk(data, handler...);
+  return ParseResultType::Success;
+}
 
-  // we allow expectedSz to be smaller in case message has new extension
-  if (expectedSz > msg.size()) [[unlikely]] {
-    if (expectedSz == std::numeric_limits<size_t>::max()) {
-      return ParseResultType::BadMsgType;
-    } else {
-      return ParseResultType::BadSize;
+struct ParseMessagesResult {
+  // number of messages handled
+  size_t count = 0;
+  // offset of the first message not handled: the end of the buffer, a message cut off by the end
+  // of the buffer, the first one after the end time, or the first one failing to parse
+  size_t offset = 0;
+  // the failure of the message at offset, Success if none failed
+  ParseResultType result = ParseResultType::Success;
+};
+
+namespace detail {
+template <bool CheckEnd, typename... Args>
+ParseMessagesResult parseFramed(std::span<const std::byte> buffer, uint64_t endNanos,
+                                Args &...handler) {
+  const auto &table = DispatchTable<Args...>::entries;
+  const char *data = reinterpret_cast<const char *>(buffer.data());
+  const size_t size = buffer.size();
+  ParseMessagesResult res;
+  size_t offset = 0;
+  // format is 2-byte big-endian size followed by message of size bytes
+  while (offset + 2 <= size) {
+    const size_t msgSize = size_t(uint8_t(data[offset])) << 8 | uint8_t(data[offset + 1]);
+    if (offset + 2 + msgSize > size) {
+      break;
+    }
+    const char *msg = data + offset + 2;
+    if (msgSize < sizeof(CommonHeader)) [[unlikely]] {
+      res.result = ParseResultType::BadSize;
+      break;
+    }
+    const CommonHeader *header = std::launder(reinterpret_cast<const CommonHeader *>(msg));
+    if constexpr (CheckEnd) {
+      if (nanosSinceMidnight(header->timestamp) > endNanos) {
+        break;
+      }
     }
+    const auto &entry = table[uint8_t(header->messageType)];
+    if (entry.size > msgSize) [[unlikely]] {
+      res.result = entry.thunk == nullptr ? ParseResultType::BadMsgType : ParseResultType::BadSize;
+      break;
+    }
+    entry.thunk(msg, handler...);
+    ++res.count;
+    offset += 2 + msgSize;
   }
-  return ParseResultType::Success;
-} // namespace itch50
+  res.offset = offset;
+  return res;
+}
+} // namespace detail
+
+// handle the length-prefixed messages of buffer, as framed in the itch file, until one fails to
+// parse or the buffer ends.  Messages of the chunk are dispatched in one loop, without a round
+// trip through a data source for each
+template <typename... Args>
+ParseMessagesResult parseMessages(std::span<const std::byte> buffer, Args &...handler) {
+  return detail::parseFramed<false>(buffer, 0, handler...);
+}
+
+// parseMessages, also stopping at the first message later than end since midnight
+template <typename... Args>
+ParseMessagesResult parseMessagesUntil(std::span<const std::byte> buffer,
+                                       std::chrono::nanoseconds end, Args &...handler) {
+  return detail::parseFramed<true>(buffer, uint64_t(end.count()), handler...);
+}
 
 } // namespace itch50
 } // namespace bookproj
@@ -0,0 +1,134 @@
+#include "itch50SeekIndex.h"
+#include <absl/log/log.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace bookproj {
+namespace datasource {
+
+namespace {
+// file layout, in host byte order: the header followed by numEntries entries
+struct Header {
+  char magic[8];
+  int64_t interval;
+  uint64_t dataSize;
+  // nanoseconds since the epoch
+  int64_t dataMTime;
+  uint64_t numEntries;
+};
+constexpr char Magic[8] = {'I', 'T', 'C', 'H', 'I', 'D', 'X', '2'};
+
+std::chrono::nanoseconds modificationTime(const struct stat &sb) {
+  return std::chrono::seconds(sb.st_mtim.tv_sec) + std::chrono::nanoseconds(sb.st_mtim.tv_nsec);
+}
+} // namespace
+
+Itch50SeekIndex Itch50SeekIndex::build(Itch50DataSource &source,
+                                       std::chrono::nanoseconds interval) {
+  Itch50SeekIndex index;
+  index.interval_ = interval;
+  uint64_t ordinal = 0;
+  std::chrono::nanoseconds next{0};
+  while (source.hasMessage()) {
+    const auto time = source.nextTime() - source.midnight();
+    if (time >= next) {
+      index.entries_.push_back({time, source.currentOffset(), ordinal});
+      // the multiple of interval after time
+      next = (time / interval + 1) * interval;
+    }
+    ++ordinal;
+    source.advance();
+  }
+  index.dataSize_ = source.currentOffset();
+  return index;
+}
+
+Itch50SeekIndex Itch50SeekIndex::load(const std::string &path, uint64_t dataSize,
+                                      std::chrono::nanoseconds dataMTime) {
+  std::ifstream in(path, std::ios::binary);
+  struct stat sb;
+  if (!in || stat(path.c_str(), &sb) != 0) {
+    throw std::runtime_error("Failed to open seek index " + path + ": " + strerror(errno));
+  }
+  Header header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      !std::equal(std::begin(Magic), std::end(Magic), header.magic) || header.interval <= 0) {
+    throw std::runtime_error("Error reading seek index " + path + ": not a seek index");
+  }
+  if (header.dataSize != dataSize) {
+    throw std::runtime_error("Seek index " + path + " is of a data file of " +
+                             std::to_string(header.dataSize) + " bytes, not " +
+                             std::to_string(dataSize));
+  }
+  if (header.dataMTime != dataMTime.count()) {
+    throw std::runtime_error("Seek index " + path + " is of a data file modified since");
+  }
+  // divided so that a corrupt count can not overflow
+  if ((size_t(sb.st_size) - sizeof(header)) / sizeof(Entry) != header.numEntries) {
+    throw std::runtime_error("Error reading seek index " + path + ": " +
+                             std::to_string(header.numEntries) + " entries in " +
+                             std::to_string(sb.st_size) + " bytes");
+  }
+  Itch50SeekIndex index;
+  index.interval_ = std::chrono::nanoseconds(header.interval);
+  index.dataSize_ = header.dataSize;
+  index.dataMTime_ = dataMTime;
+  index.entries_.resize(header.numEntries);
+  if (!in.read(reinterpret_cast<char *>(index.entries_.data()),
+               header.numEntries * sizeof(Entry))) {
+    throw std::runtime_error("Error reading seek index " + path + ": truncated");
+  }
+  return index;
+}
+
+void Itch50SeekIndex::save(const std::string &path) const {
+  Header header{{}, interval_.count(), dataSize_, dataMTime_.count(), entries_.size()};
+  std::copy(std::begin(Magic), std::end(Magic), header.magic);
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(entries_.data()), entries_.size() * sizeof(Entry));
+  if (!out.flush()) {
+    throw std::runtime_error("Error writing seek index " + path + ": " + strerror(errno));
+  }
+}
+
+Itch50SeekIndex Itch50SeekIndex::loadOrBuild(int date, std::chrono::nanoseconds interval) {
+  const std::string dataPath = Itch50DataSource::filePath(date);
+  const std::string indexPath = path(date);
+  struct stat sb;
+  if (stat(dataPath.c_str(), &sb) != 0) {
+    throw std::runtime_error("Error stating file " + dataPath + ": " + strerror(errno));
+  }
+  if (struct stat ib; stat(indexPath.c_str(), &ib) == 0) {
+    try {
+      Itch50SeekIndex index = load(indexPath, sb.st_size, modificationTime(sb));
+      if (index.interval() == interval) {
+        return index;
+      }
+    } catch (const std::runtime_error &e) {
+      LOG(WARNING) << e.what() << ", rebuilding it";
+    }
+  }
+  Itch50HistDataSource source(date);
+  Itch50SeekIndex index = build(source, interval);
+  index.dataMTime_ = modificationTime(sb);
+  try {
+    index.save(indexPath);
+  } catch (const std::runtime_error &e) {
+    LOG(WARNING) << e.what();
+  }
+  return index;
+}
+
+const Itch50SeekIndex::Entry *Itch50SeekIndex::find(std::chrono::nanoseconds time) const {
+  auto it = std::upper_bound(entries_.begin(), entries_.end(), time,
+                             [](auto t, const Entry &entry) { return t < entry.time; });
+  return it == entries_.begin() ? nullptr : &*(it - 1);
+}
+
+} // namespace datasource
+} // namespace bookproj
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "itch50HistDataSource.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bookproj {
+namespace datasource {
+
+// Itch50SeekIndex maps times of a day file to where its messages are, so that a source seeks by
+// a binary search and a jump rather than by reading every message before the time.  An entry is
+// kept for the first message at or after each multiple of the interval since midnight.  Built
+// once for a day, it is saved next to the day file as nasdaq_itch.YYYYMMDD.dat.idx
+class Itch50SeekIndex {
+public:
+  struct Entry {
+    // time of the message since midnight
+    std::chrono::nanoseconds time;
+    // offset of the message in the file
+    uint64_t offset;
+    // number of messages before it in the file
+    uint64_t ordinal;
+  };
+
+  static constexpr std::chrono::nanoseconds DefaultInterval = std::chrono::milliseconds(10);
+
+  // index the messages of source, which is at the start of the file without an end time
+  static Itch50SeekIndex build(Itch50DataSource &source,
+                               std::chrono::nanoseconds interval = DefaultInterval);
+
+  // throw std::runtime_error if the file can not be read, or is not an index of a data file of
+  // dataSize bytes last modified at dataMTime
+  static Itch50SeekIndex load(const std::string &path, uint64_t dataSize,
+                              std::chrono::nanoseconds dataMTime);
+  // throw std::runtime_error if the file can not be written
+  void save(const std::string &path) const;
+
+  // load the index of the day file of date, or build it if there is none or it is stale and save
+  // it.  Failing to save is logged only.  Throw std::runtime_error if the day file can not be read
+  static Itch50SeekIndex loadOrBuild(int date,
+                                     std::chrono::nanoseconds interval = DefaultInterval);
+  static std::string path(int date) { return Itch50DataSource::filePath(date) + ".idx"; }
+
+  // the last entry at or before time, nullptr if there is none.  The messages before it are all
+  // before time, as times in a day file do not decrease
+  const Entry *find(std::chrono::nanoseconds time) const;
+
+  std::chrono::nanoseconds interval() const { return interval_; }
+  uint64_t dataSize() const { return dataSize_; }
+  // modification time of the data file since the epoch, 0 for an index not saved by loadOrBuild
+  std::chrono::nanoseconds dataMTime() const { return dataMTime_; }
+  const std::vector<Entry> &entries() const { return entries_; }
+
+private:
+  std::chrono::nanoseconds interval_{0};
+  uint64_t dataSize_ = 0;
+  std::chrono::nanoseconds dataMTime_{0};
+  std::vector<Entry> entries_;
+};
+
+} // namespace datasource
+} // namespace bookproj
\ No newline at end of file
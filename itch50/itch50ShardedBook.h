@@ -0,0 +1,213 @@
+#pragma once
+
+#include "hash/emhash7.h"
+#include "itch50DayProfile.h"
+#include "itch50OrderBook.h"
+#include "orderbook/OrderBook.h"
+#include "orderbook/SPSCRing.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace bookproj {
+namespace itch50 {
+
+// ShardMap assigns CIDs to shards, balancing the expected number of book messages of each.  The
+// symbols of a profile are assigned heaviest first to the least loaded shard.  A CID is assigned
+// on its first lookup, a symbol not in the profile goes to the least loaded shard then, weighing
+// as the average profiled symbol.  Lookups must be on the thread inserting into cindex
+class ShardMap {
+public:
+  using CID = orderbook::CID;
+
+  ShardMap(size_t numShards, const CIndex &cindex_, const DayProfile &expected)
+      : cindex(cindex_), loads(numShards, 0) {
+    assert(numShards > 0);
+    auto symbols = expected.symbols;
+    std::ranges::stable_sort(symbols, std::ranges::greater(), &SymbolProfile::messages);
+    uint64_t total = 0;
+    for (const SymbolProfile &s : symbols) {
+      if (symbolShards.emplace(s.symbol, leastLoaded()).second) {
+        loads[symbolShards[s.symbol]] += s.messages;
+        total += s.messages;
+      }
+    }
+    unknownWeight = symbolShards.empty() ? 1 : std::max<uint64_t>(total / symbolShards.size(), 1);
+  }
+
+  size_t numShards() const { return loads.size(); }
+
+  // shard of cid, operations without a CID go to shard 0
+  uint32_t operator[](CID cid) {
+    if (!cid.valid()) [[unlikely]] {
+      return 0;
+    }
+    const auto ind = orderbook::toUnderlying(cid);
+    if (std::cmp_less(ind, cidShards.size()) && cidShards[ind] != Unassigned) [[likely]] {
+      return cidShards[ind];
+    }
+    return assign(cid);
+  }
+
+  // expected messages of each shard, including the estimates of unprofiled symbols seen so far
+  const std::vector<uint64_t> &expectedLoads() const { return loads; }
+
+private:
+  static constexpr uint32_t Unassigned = ~uint32_t(0);
+
+  uint32_t leastLoaded() const {
+    return uint32_t(std::ranges::min_element(loads) - loads.begin());
+  }
+
+  uint32_t assign(CID cid) {
+    const auto ind = orderbook::toUnderlying(cid);
+    if (std::cmp_greater_equal(ind, cidShards.size())) {
+      cidShards.resize(ind + 1, Unassigned);
+    }
+    if (auto it = symbolShards.find(cindex[cid]); it != symbolShards.end()) {
+      return cidShards[ind] = it->second;
+    }
+    const uint32_t shard = leastLoaded();
+    loads[shard] += unknownWeight;
+    return cidShards[ind] = shard;
+  }
+
+  const CIndex &cindex;
+  std::vector<uint64_t> loads;
+  emhash7::HashMap<Symbol, uint32_t, Symbol::Hash> symbolShards;
+  std::vector<uint32_t> cidShards;
+  uint64_t unknownWeight = 1;
+};
+
+// ShardPeaks finds the peak numbers of orders and levels of the books of shards together, which
+// are those of one book applying all operations.  The peaks of the shards need not be at the same
+// time, so their sum may be more.  The writer records the shard of each operation in order, each
+// shard's thread the change of the counts of its book by each of its operations, and run merges
+// the changes in the order of the operations on a thread of its own
+class ShardPeaks {
+public:
+  using BookOp = orderbook::BookOp;
+
+  // rings of ringSize for numShards shards
+  ShardPeaks(size_t numShards, size_t ringSize) : routes(ringSize) {
+    for (size_t ii = 0; ii < numShards; ++ii) {
+      changes.push_back(std::make_unique<SPSCRing<Change>>(ringSize));
+    }
+  }
+
+  // writer, the next operation went to shard
+  void route(uint32_t shard) { routes.push(shard); }
+  // writer, no more operations
+  void close() { routes.close(); }
+
+  // thread of shard, apply operations from ring to book as applyBookOps does, recording the
+  // change of the counts of book by each
+  template <typename Book> void applyBookOps(size_t shard, SPSCRing<BookOp> &ring, Book &book) {
+    SPSCRing<Change> &out = *changes[shard];
+    size_t numOrders = book.numOrders(), numLevels = book.numLevels();
+    for (auto ops = ring.front(); !ops.empty(); ops = ring.front()) {
+      book.apply(ops, [&](const BookOp &) {
+        out.push({int8_t(book.numOrders() - numOrders), int8_t(book.numLevels() - numLevels)});
+        numOrders = book.numOrders();
+        numLevels = book.numLevels();
+      });
+      ring.pop(ops.size());
+    }
+    out.close();
+  }
+
+  // merge the changes of all operations, until the writer is closed
+  void run() {
+    std::vector<std::span<const Change>> pending(changes.size());
+    std::vector<size_t> used(changes.size(), 0);
+    int64_t numOrders = 0, numLevels = 0;
+    for (auto shards = routes.front(); !shards.empty(); shards = routes.front()) {
+      for (const uint32_t shard : shards) {
+        if (used[shard] == pending[shard].size()) {
+          changes[shard]->pop(used[shard]);
+          pending[shard] = changes[shard]->front();
+          used[shard] = 0;
+          assert(!pending[shard].empty());
+        }
+        const Change change = pending[shard][used[shard]++];
+        numOrders += change.orders;
+        numLevels += change.levels;
+        maxOrders = std::max(maxOrders, size_t(numOrders));
+        maxLevels = std::max(maxLevels, size_t(numLevels));
+      }
+      routes.pop(shards.size());
+    }
+  }
+
+  // after run
+  size_t maxNumOrders() const { return maxOrders; }
+  size_t maxNumLevels() const { return maxLevels; }
+
+private:
+  // change of the counts of a book by one operation
+  struct Change {
+    int8_t orders;
+    int8_t levels;
+  };
+
+  SPSCRing<uint32_t> routes;
+  std::vector<std::unique_ptr<SPSCRing<Change>>> changes;
+  size_t maxOrders = 0;
+  size_t maxLevels = 0;
+};
+
+// a Book for Itch50QuoteHandler that pushes each book operation to the ring of the shard of its
+// CID, so that each shard's thread builds the book of its CIDs with applyBookOps.  The orders of a
+// CID only live in its shard, so the books together match one book applying all operations.
+// Set the midnight on the shard books.  With peaks, the shards apply their operations with
+// ShardPeaks::applyBookOps instead
+struct ShardedBookOpWriter {
+  using BookOp = orderbook::BookOp;
+  using Ring = SPSCRing<BookOp>;
+
+  // a ring of ringSize for each shard of shards
+  ShardedBookOpWriter(ShardMap &shards_, size_t ringSize, ShardPeaks *peaks_ = nullptr)
+      : shards(shards_), peaks(peaks_) {
+    for (size_t ii = 0; ii < shards.numShards(); ++ii) {
+      rings.push_back(std::make_unique<Ring>(ringSize));
+    }
+  }
+
+  void setMidnight(Timestamp) {}
+  void apply(const BookOp &op) {
+    const uint32_t shard = shards[op.cid];
+    // routed after the push, so that the change ShardPeaks waits for is of an operation the
+    // shard has
+    rings[shard]->push(op);
+    if (peaks != nullptr) {
+      peaks->route(shard);
+    }
+  }
+  void apply(std::span<const BookOp> ops) {
+    for (const BookOp &op : ops) {
+      apply(op);
+    }
+  }
+
+  // no more operations, after the quote handler is flushed
+  void close() {
+    for (auto &ring : rings) {
+      ring->close();
+    }
+    if (peaks != nullptr) {
+      peaks->close();
+    }
+  }
+
+  Ring &ring(size_t shard) { return *rings[shard]; }
+
+  ShardMap &shards;
+  ShardPeaks *peaks;
+  std::vector<std::unique_ptr<Ring>> rings;
+};
+
+} // namespace itch50
+} // namespace bookproj
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "itch50HistDataSource.h"
 #include "itch50RawParser.h"
+#include "itch50SeekIndex.h"
+#include <cstdio>
 #include <fcntl.h>
 #include <iostream>
 #include <sys/mman.h>
@@ -14,10 +16,30 @@ struct RawPrinter {
   }
 };
 
+// time since midnight of HH:MM:SS.usec, false if str is not one
+bool parseTime(const char *str, std::chrono::nanoseconds &time) {
+  int hour, minute;
+  double sec = 0.0;
+  if (std::sscanf(str, "%2d:%2d:%lf", &hour, &minute, &sec) >= 2 && hour >= 0 && hour < 24 &&
+      minute >= 0 && minute < 60 && sec >= 0 && sec < 60) {
+    const std::chrono::duration<double> seconds(sec);
+    time = std::chrono::hours(hour) + std::chrono::minutes(minute) +
+           std::chrono::duration_cast<std::chrono::nanoseconds>(seconds);
+    return true;
+  }
+  return false;
+}
+
 using bookproj::datasource::Itch50HistDataSource;
+using bookproj::datasource::Itch50SeekIndex;
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    std::cout << "Usage: " << argv[0] << " <itch50_dir> <date>" << std::endl;
+  std::chrono::nanoseconds start{0}, end = std::chrono::hours(24);
+  if (argc < 3 || argc > 5 || (argc > 3 && !parseTime(argv[3], start)) ||
+      (argc > 4 && !parseTime(argv[4], end))) {
+    std::cout << "Usage: " << argv[0] << " <itch50_dir> <date> [<start> [<end>]]\n"
+              << "  start and end times as HH:MM:SS.usec, a start time seeks by the index "
+                 "nasdaq_itch.YYYYMMDD.dat.idx, which is built if there is none"
+              << std::endl;
     return 1;
   }
 
@@ -26,10 +48,16 @@ int main(int argc, char *argv[]) {
   std::unique_ptr<Itch50HistDataSource> source;
   try {
     source.reset(new Itch50HistDataSource(date));
+    if (start.count() > 0) {
+      source->setSeekIndex(
+          std::make_shared<const Itch50SeekIndex>(Itch50SeekIndex::loadOrBuild(date)));
+    }
   } catch (const std::runtime_error &e) {
     std::cerr << "Error creating data source: " << e.what() << std::endl;
     return 1;
   }
+  source->setEndTime(source->midnight() + end);
+  source->seek(source->midnight() + start);
 
   RawPrinter handler;
   while (source->hasMessage()) {
@@ -45,4 +73,5 @@ int main(int argc, char *argv[]) {
     }
     source->advance();
   }
+  return source->failed() ? 1 : 0;
 }
\ No newline at end of file
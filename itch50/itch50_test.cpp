@@ -1,5 +1,8 @@
 #include "itch50.h"
+#include "itch50RawParser.h"
 #include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <vector>
 
 using namespace bookproj;
 
@@ -7,3 +10,135 @@ TEST_CASE("basic") {
   itch50::SystemEvent se;
   CHECK(se.header.messageType == 'S');
 }
+
+namespace {
+// counts the messages of each type, and the add orders seen
+struct Counter {
+  template <typename Msg> void process(const Msg &msg) {
+    ++counts[uint8_t(msg.header.messageType)];
+  }
+  void process(const itch50::AddOrder &msg) {
+    ++counts['A'];
+    refNums.push_back(+msg.orderReferenceNumber);
+  }
+  size_t counts[256] = {};
+  std::vector<uint64_t> refNums;
+};
+
+// append msg as framed in the itch file, with size bytes of it
+template <typename Msg>
+void frame(std::vector<std::byte> &buffer, const Msg &msg, size_t size = sizeof(Msg)) {
+  buffer.push_back(std::byte(size >> 8));
+  buffer.push_back(std::byte(size & 0xff));
+  const size_t offset = buffer.size();
+  buffer.resize(offset + size);
+  memcpy(buffer.data() + offset, &msg, std::min(size, sizeof(Msg)));
+}
+
+void setTime(itch50::CommonHeader &header, uint64_t nanos) {
+  for (int ii = 5; ii >= 0; --ii, nanos >>= 8) {
+    header.timestamp[ii] = uint8_t(nanos);
+  }
+}
+} // namespace
+
+TEST_CASE("parse message") {
+  Counter counter;
+  std::vector<std::byte> buffer;
+  itch50::OrderDelete del;
+  frame(buffer, del);
+  auto msg = std::span<const std::byte>(buffer).subspan(2);
+  CHECK(itch50::parseMessage(msg, counter) == itch50::ParseResultType::Success);
+  CHECK(counter.counts['D'] == 1);
+  // a longer message is an extension of it
+  buffer.clear();
+  frame(buffer, del, sizeof(del) + 4);
+  msg = std::span<const std::byte>(buffer).subspan(2);
+  CHECK(itch50::parseMessage(msg, counter) == itch50::ParseResultType::Success);
+  CHECK(counter.counts['D'] == 2);
+  CHECK(itch50::parseMessage(msg.first(sizeof(del) - 1), counter) ==
+        itch50::ParseResultType::BadSize);
+  del.header.messageType = 'z';
+  buffer.clear();
+  frame(buffer, del);
+  msg = std::span<const std::byte>(buffer).subspan(2);
+  CHECK(itch50::parseMessage(msg, counter) == itch50::ParseResultType::BadMsgType);
+  CHECK(counter.counts['D'] == 2);
+  CHECK(counter.counts['z'] == 0);
+}
+
+TEST_CASE("parse messages") {
+  std::vector<std::byte> buffer;
+  itch50::SystemEvent se;
+  setTime(se.header, 100);
+  frame(buffer, se);
+  itch50::AddOrder add;
+  for (uint64_t ii = 1; ii <= 3; ++ii) {
+    add.orderReferenceNumber = ii;
+    setTime(add.header, 100 + ii);
+    frame(buffer, add);
+  }
+  itch50::OrderDelete del;
+  setTime(del.header, 200);
+  frame(buffer, del);
+  const size_t delEnd = buffer.size();
+
+  SECTION("whole buffer") {
+    Counter counter;
+    auto res = itch50::parseMessages(buffer, counter);
+    CHECK(res.count == 5);
+    CHECK(res.offset == buffer.size());
+    CHECK(res.result == itch50::ParseResultType::Success);
+    CHECK(counter.counts['S'] == 1);
+    CHECK(counter.counts['D'] == 1);
+    CHECK(counter.refNums == std::vector<uint64_t>{1, 2, 3});
+  }
+
+  SECTION("cut off") {
+    // the last message is not complete, its offset is where the next buffer starts
+    Counter counter;
+    auto res = itch50::parseMessages(std::span(buffer).first(delEnd - 1), counter);
+    CHECK(res.count == 4);
+    CHECK(res.offset == delEnd - sizeof(del) - 2);
+    CHECK(res.result == itch50::ParseResultType::Success);
+    res = itch50::parseMessages(std::span(buffer).first(1), counter);
+    CHECK(res.count == 0);
+    CHECK(res.offset == 0);
+  }
+
+  SECTION("end time") {
+    Counter counter;
+    auto res = itch50::parseMessagesUntil(buffer, std::chrono::nanoseconds(102), counter);
+    CHECK(res.count == 3);
+    CHECK(res.offset == 2 + sizeof(se) + 2 * (2 + sizeof(add)));
+    CHECK(res.result == itch50::ParseResultType::Success);
+    CHECK(counter.refNums == std::vector<uint64_t>{1, 2});
+  }
+
+  SECTION("errors") {
+    // handled up to the failing message
+    del.header.messageType = 'z';
+    frame(buffer, del);
+    frame(buffer, se);
+    Counter counter;
+    auto res = itch50::parseMessages(buffer, counter);
+    CHECK(res.count == 5);
+    CHECK(res.offset == delEnd);
+    CHECK(res.result == itch50::ParseResultType::BadMsgType);
+    CHECK(counter.counts['S'] == 1);
+
+    buffer.resize(delEnd);
+    frame(buffer, add, sizeof(add) - 1);
+    res = itch50::parseMessages(buffer, counter);
+    CHECK(res.count == 5);
+    CHECK(res.offset == delEnd);
+    CHECK(res.result == itch50::ParseResultType::BadSize);
+
+    // too short for a header
+    buffer.resize(delEnd);
+    frame(buffer, se, 3);
+    res = itch50::parseMessages(buffer, counter);
+    CHECK(res.offset == delEnd);
+    CHECK(res.result == itch50::ParseResultType::BadSize);
+  }
+}
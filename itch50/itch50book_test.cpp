@@ -1,18 +1,37 @@
+#include "datasource/HistDataSourceFactory.h"
 #include "digest/sha256.h"
+#include "itch50Checkpoint.h"
+#include "itch50DayProfile.h"
+#include "itch50DirectHistDataSource.h"
+#include "itch50GzHistDataSource.h"
 #include "itch50HistDataSource.h"
+#include "itch50LookaheadReader.h"
 #include "itch50OrderBook.h"
 #include "itch50RawParser.h"
+#include "itch50SeekIndex.h"
+#include "itch50ShardedBook.h"
 #include "orderbook/OrderBook.h"
+#include <algorithm>
+#include <array>
 #include <catch2/catch_test_macros.hpp>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <fcntl.h>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
 #include <stdexcept>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <thread>
+#include <tuple>
 #include <unistd.h>
+#include <zlib.h>
 
 using namespace bookproj;
 using itch50::CIndex;
@@ -68,6 +87,14 @@ struct Listener : public orderbook::BookListener {
 
   size_t updates() const { return numUpdates; }
   std::string digestStr() { return digest.digest(); }
+  // digests of the updates of each CID, which do not depend on the order across CIDs
+  std::map<CID, std::string> cidDigestStrs() {
+    std::map<CID, std::string> digests;
+    for (auto &[cid, cidDigest] : cidDigests) {
+      digests[cid] = cidDigest.digest();
+    }
+    return digests;
+  }
 
 private:
   template <typename... Args> void update(CID cid, const Args &...args) {
@@ -75,6 +102,7 @@ private:
     (serialize(args), ...);
     serializeBook(cid);
     digest.update(buffer.data(), buffer.size());
+    cidDigests[cid].update(buffer.data(), buffer.size());
     buffer.clear();
     ++numUpdates;
   }
@@ -145,14 +173,18 @@ private:
   // buffer to store the pieces of bytes from one update, before sending to digest
   std::vector<std::byte> buffer;
   digest::SHA256 digest;
+  std::map<CID, digest::SHA256> cidDigests;
 };
 
-using QuoteHandler = itch50::Itch50QuoteHandler;
+using QuoteHandler = itch50::Itch50QuoteHandler<OrderBook>;
 using SymbolHandler = itch50::Itch50SymbolHandler;
 
-// return false if file is not found
+// return false if file is not found.  batchSize > 0 applies book operations in batches,
+// lookahead > 0 reads messages through an Itch50LookaheadReader, pipeline decodes messages on
+// another thread
 std::pair<size_t, std::string> sha256sum(const std::vector<std::string> &symbols, int depth,
-                                         int date) {
+                                         int date, size_t batchSize = 0, size_t lookahead = 0,
+                                         bool pipeline = false) {
   OrderBook book(BookID{0});
   book.resize(CID(symbols.size()));
 
@@ -167,7 +199,6 @@ std::pair<size_t, std::string> sha256sum(const std::vector<std::string> &symbols
   auto midnight = datasource::Itch50HistDataSource::midnightNYTime(date);
   Listener listener(book, depth, midnight, midnight + 23h + 59min + 59s);
   SymbolHandler symbolHandler(cindex, stockLocateMap, false);
-  QuoteHandler quoteHandler(book, stockLocateMap, midnight, false);
   book.addListener(&listener);
 
   std::unique_ptr<datasource::Itch50HistDataSource> source;
@@ -178,20 +209,121 @@ std::pair<size_t, std::string> sha256sum(const std::vector<std::string> &symbols
     return {0, ""};
   }
 
-  while (source->hasMessage()) {
-    auto result = itch50::parseMessage(source->nextMessage(), symbolHandler, quoteHandler);
-    if (result != itch50::ParseResultType::Success) {
-      std::cerr << "Error parsing message: " << bookproj::itch50::toString(result)
-                << " file offset: " << source->currentOffset() << std::endl;
-      break;
+  auto processMessages = [&](auto &reader, auto &quoteHandler) {
+    while (reader.hasMessage()) {
+      auto result = itch50::parseMessage(reader.nextMessage(), symbolHandler, quoteHandler);
+      if (result != itch50::ParseResultType::Success) {
+        std::cerr << "Error parsing message: " << bookproj::itch50::toString(result)
+                  << " file offset: " << source->currentOffset() << std::endl;
+        break;
+      }
+      reader.advance();
     }
-    source->advance();
+  };
+  if (pipeline) {
+    SPSCRing<orderbook::BookOp> ring(1024);
+    itch50::BookOpWriter writer(ring);
+    itch50::Itch50QuoteHandler<itch50::BookOpWriter> decoder(writer, stockLocateMap, midnight);
+    book.setMidnight(midnight);
+    std::thread decoderThread([&] {
+      processMessages(*source, decoder);
+      decoder.flush();
+      ring.close();
+    });
+    itch50::applyBookOps(ring, book);
+    decoderThread.join();
+  } else if (lookahead > 0) {
+    QuoteHandler quoteHandler(book, stockLocateMap, midnight, batchSize);
+    itch50::Itch50LookaheadReader<OrderBook> reader(*source, book, lookahead, &stockLocateMap);
+    processMessages(reader, quoteHandler);
+    quoteHandler.flush();
+  } else {
+    QuoteHandler quoteHandler(book, stockLocateMap, midnight, batchSize);
+    processMessages(*source, quoteHandler);
+    quoteHandler.flush();
   }
 
   book.removeListener(&listener);
   return {listener.updates(), listener.digestStr()};
 }
 
+// number of updates, the digests of each CID and the peak numbers of orders and levels, of one
+// book built on this thread or of the books of numShards shards built on their own threads
+std::tuple<size_t, std::map<CID, std::string>, std::pair<size_t, size_t>>
+cidDigests(const std::vector<std::string> &symbols, int depth, int date, size_t numShards) {
+  StockLocateMap stockLocateMap;
+  CIndex cindex;
+  for (const auto &symbol : symbols) {
+    cindex.findOrInsert(Symbol(symbol));
+  }
+
+  using namespace std::chrono_literals;
+  auto midnight = datasource::Itch50HistDataSource::midnightNYTime(date);
+  SymbolHandler symbolHandler(cindex, stockLocateMap, false);
+  std::vector<std::unique_ptr<OrderBook>> books;
+  std::vector<std::unique_ptr<Listener>> listeners;
+  for (size_t ii = 0; ii < std::max<size_t>(numShards, 1); ++ii) {
+    auto &book = *books.emplace_back(new OrderBook(BookID(ii)));
+    book.resize(CID(symbols.size()));
+    book.setMidnight(midnight);
+    listeners.emplace_back(new Listener(book, depth, midnight, midnight + 23h + 59min + 59s));
+    book.addListener(listeners.back().get());
+  }
+
+  std::unique_ptr<datasource::Itch50HistDataSource> source;
+  try {
+    source.reset(new datasource::Itch50HistDataSource(date));
+  } catch (const std::runtime_error &e) {
+    std::cerr << "Error creating data source: " << e.what() << std::endl;
+    return {0, {}, {}};
+  }
+
+  auto processMessages = [&](auto &quoteHandler) {
+    while (source->hasMessage()) {
+      auto result = itch50::parseMessage(source->nextMessage(), symbolHandler, quoteHandler);
+      if (result != itch50::ParseResultType::Success) {
+        std::cerr << "Error parsing message: " << bookproj::itch50::toString(result)
+                  << " file offset: " << source->currentOffset() << std::endl;
+        break;
+      }
+      source->advance();
+    }
+    quoteHandler.flush();
+  };
+  std::pair<size_t, size_t> peaks;
+  if (numShards == 0) {
+    QuoteHandler quoteHandler(*books[0], stockLocateMap, midnight);
+    processMessages(quoteHandler);
+    peaks = {books[0]->maxNumOrders(), books[0]->maxNumLevels()};
+  } else {
+    itch50::ShardMap shardMap(numShards, cindex, itch50::DayProfile());
+    itch50::ShardPeaks shardPeaks(numShards, 1024);
+    itch50::ShardedBookOpWriter writer(shardMap, 1024, &shardPeaks);
+    itch50::Itch50QuoteHandler<itch50::ShardedBookOpWriter> decoder(writer, stockLocateMap,
+                                                                     midnight);
+    std::vector<std::thread> threads;
+    for (size_t ii = 0; ii < numShards; ++ii) {
+      threads.emplace_back([&, ii] { shardPeaks.applyBookOps(ii, writer.ring(ii), *books[ii]); });
+    }
+    threads.emplace_back([&] { shardPeaks.run(); });
+    processMessages(decoder);
+    writer.close();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    peaks = {shardPeaks.maxNumOrders(), shardPeaks.maxNumLevels()};
+  }
+
+  size_t updates = 0;
+  std::map<CID, std::string> digests;
+  for (size_t ii = 0; ii < books.size(); ++ii) {
+    books[ii]->removeListener(listeners[ii].get());
+    updates += listeners[ii]->updates();
+    digests.merge(listeners[ii]->cidDigestStrs());
+  }
+  return {updates, digests, peaks};
+}
+
 TEST_CASE("itch50book") {
   std::vector<std::string> symbols{"AAPL", "MSFT", "GOOGL"};
 
@@ -201,4 +333,475 @@ TEST_CASE("itch50book") {
   auto expected = "7f3e9dff6ce62cd38b15e93b35aa2775c4aca3dc27eea1a268106defd40de045";
   CHECK(digest == expected);
   CHECK(updates == 3504243);
+}
+
+TEST_CASE("itch50book batched") {
+  // batching, lookahead and pipelining do not change the updates
+  std::vector<std::string> symbols{"AAPL", "MSFT", "GOOGL"};
+
+  datasource::Itch50HistDataSource::setRootPath("/opt/data");
+  int depth = 5;
+  auto expected = sha256sum(symbols, depth, 20191230);
+  CHECK(sha256sum(symbols, depth, 20191230, 32) == expected);
+  CHECK(sha256sum(symbols, depth, 20191230, 32, 16) == expected);
+  CHECK(sha256sum(symbols, depth, 20191230, 0, 0, true) == expected);
+}
+
+TEST_CASE("itch50book sharded") {
+  // the books of the shards together have the same updates of each CID, and the peaks of one book
+  std::vector<std::string> symbols{"AAPL", "MSFT", "GOOGL"};
+
+  datasource::Itch50HistDataSource::setRootPath("/opt/data");
+  int depth = 5;
+  auto expected = cidDigests(symbols, depth, 20191230, 0);
+  CHECK(std::get<1>(expected).size() == symbols.size());
+  CHECK(std::get<2>(expected).first > 0);
+  CHECK(cidDigests(symbols, depth, 20191230, 1) == expected);
+  CHECK(cidDigests(symbols, depth, 20191230, 2) == expected);
+}
+
+TEST_CASE("shard map") {
+  CIndex cindex;
+  for (const char *symbol : {"A", "B", "C", "D", "E"}) {
+    cindex.findOrInsert(Symbol(symbol));
+  }
+  itch50::DayProfile profile;
+  profile.symbols = {{Symbol("D"), 10}, {Symbol("A"), 100}, {Symbol("C"), 50}, {Symbol("B"), 60}};
+
+  // heaviest first to the least loaded: A, B, C to the lighter B, then D
+  itch50::ShardMap shards(2, cindex, profile);
+  CHECK(shards.expectedLoads() == std::vector<uint64_t>{110, 110});
+  CHECK(shards[cindex[Symbol("A")]] == 0);
+  CHECK(shards[cindex[Symbol("B")]] == 1);
+  CHECK(shards[cindex[Symbol("C")]] == 1);
+  CHECK(shards[cindex[Symbol("D")]] == 0);
+  // unprofiled symbols weigh as the average
+  CHECK(shards[cindex[Symbol("E")]] == 0);
+  CHECK(shards.expectedLoads() == std::vector<uint64_t>{165, 110});
+  CHECK(shards[CID::invalid()] == 0);
+
+  // profiles round trip through their file
+  const std::string path = "/tmp/itch50book_test.profile";
+  profile.save(path);
+  auto loaded = itch50::DayProfile::load(path);
+  CHECK(loaded.symbols == profile.symbols);
+  std::remove(path.c_str());
+  CHECK_THROWS_AS(itch50::DayProfile::load(path), std::runtime_error);
+}
+
+TEST_CASE("day profile") {
+  // a replay profiles the peaks of its book, the next one reserves for them
+  datasource::Itch50HistDataSource::setRootPath("/opt/data");
+  const auto midnight = datasource::Itch50HistDataSource::midnightNYTime(20191230);
+  auto replay = [&](orderbook::OrderBook &book, const itch50::DayProfile &previous) {
+    CIndex cindex;
+    StockLocateMap lindex;
+    itch50::Itch50SymbolHandler symbolHandler(cindex, lindex, true, previous.symbols.size());
+    itch50::Itch50ReserveHandler<orderbook::OrderBook> reserveHandler(&book, lindex, previous,
+                                                                      1.25);
+    itch50::Itch50QuoteHandler<orderbook::OrderBook> quoteHandler(book, lindex, midnight);
+    itch50::Itch50ProfileHandler profileHandler;
+    book.reserve(65535, previous.reserveFor(previous.maxNumOrders, 1.25, 1 << 10),
+                 previous.reserveFor(previous.maxNumLevels, 1.25, 1 << 10));
+    book.resize(CID(65535));
+    datasource::Itch50HistDataSource source(20191230);
+    while (source.hasMessage()) {
+      auto res = itch50::parseMessages(source.nextBlock(), symbolHandler, reserveHandler,
+                                       quoteHandler, profileHandler);
+      source.skip(res.offset);
+    }
+    quoteHandler.flush();
+    profileHandler.addBook(book, cindex);
+    return profileHandler.profile(cindex, lindex);
+  };
+
+  orderbook::OrderBook first(BookID(0));
+  const itch50::DayProfile profile = replay(first, itch50::DayProfile());
+  CHECK(profile.maxNumOrders == first.maxNumOrders());
+  CHECK(profile.maxNumLevels == first.maxNumLevels());
+  CHECK(profile.maxNumOrders > 0);
+  // the peaks of symbols need not be at the same time
+  const uint64_t symbolLevels =
+      std::accumulate(profile.symbols.begin(), profile.symbols.end(), uint64_t(0),
+                      [](uint64_t sum, const auto &s) { return sum + s.maxLevels; });
+  CHECK(symbolLevels >= profile.maxNumLevels);
+  auto aapl = std::ranges::find(profile.symbols, Symbol("AAPL"), &itch50::SymbolProfile::symbol);
+  REQUIRE(aapl != profile.symbols.end());
+  CHECK(aapl->maxLevels > 0);
+  CHECK(aapl->messages > 0);
+
+  // reserving for the day does not change its book
+  orderbook::OrderBook second(BookID(0));
+  CHECK(replay(second, profile) == profile);
+  CHECK(second.validate());
+
+  // profiles round trip through their file, those without peaks load with none
+  const std::string path = "/tmp/itch50book_test.day.profile";
+  profile.save(path);
+  CHECK(itch50::DayProfile::load(path) == profile);
+  std::ofstream(path) << "AAPL 10\nMSFT 20\n";
+  const auto legacy = itch50::DayProfile::load(path);
+  CHECK(legacy.maxNumOrders == 0);
+  CHECK(legacy.symbols ==
+        std::vector<itch50::SymbolProfile>{{Symbol("AAPL"), 10}, {Symbol("MSFT"), 20}});
+  for (const char *content : {"AAPL 10 3 7\n", "AAPL x\n", "book 5\n"}) {
+    std::ofstream(path) << content;
+    CHECK_THROWS_AS(itch50::DayProfile::load(path), std::runtime_error);
+  }
+  std::remove(path.c_str());
+}
+
+// counts the messages of each type, and the time of the last one
+struct MessageCounter {
+  template <typename Msg> void process(const Msg &msg) {
+    ++counts[uint8_t(msg.header.messageType)];
+    last = itch50::nanosSinceMidnight(msg.header.timestamp);
+  }
+  std::array<size_t, 256> counts = {};
+  uint64_t last = 0;
+};
+
+TEST_CASE("parse blocks") {
+  // parsing blocks of the file sees the same messages as parsing them one at a time
+  datasource::Itch50HistDataSource::setRootPath("/opt/data");
+  const auto midnight = datasource::Itch50HistDataSource::midnightNYTime(20191230);
+  for (std::chrono::nanoseconds end : {std::chrono::hours(24), std::chrono::hours(10)}) {
+    MessageCounter expected;
+    datasource::Itch50HistDataSource messages(20191230);
+    messages.setEndTime(midnight + end);
+    bool parsed = true;
+    while (messages.hasMessage()) {
+      parsed &= itch50::parseMessage(messages.nextMessage(), expected) ==
+                itch50::ParseResultType::Success;
+      messages.advance();
+    }
+    REQUIRE(parsed);
+
+    for (size_t blockSize : {size_t(1000), size_t(1) << 22}) {
+      MessageCounter counter;
+      size_t count = 0;
+      datasource::Itch50HistDataSource blocks(20191230);
+      blocks.setEndTime(midnight + end);
+      while (blocks.hasMessage()) {
+        auto res = itch50::parseMessagesUntil(blocks.nextBlock(blockSize),
+                                              blocks.endTimeSinceMidnight(), counter);
+        count += res.count;
+        blocks.skip(res.offset);
+        if (res.result != itch50::ParseResultType::Success) {
+          parsed = false;
+          break;
+        }
+      }
+      CHECK(parsed);
+      CHECK(counter.counts == expected.counts);
+      CHECK(counter.last == expected.last);
+      CHECK(count == std::accumulate(expected.counts.begin(), expected.counts.end(), size_t(0)));
+    }
+  }
+}
+
+TEST_CASE("gzip source") {
+  // gzip the day file in two members, and read it back with buffers small enough that many
+  // messages straddle two of them
+  const std::string dir = "/tmp/itch50book_test_gz";
+  std::filesystem::create_directories(dir);
+  datasource::Itch50HistDataSource::setRootPath("/opt/data");
+  {
+    datasource::Itch50HistDataSource source(20191230);
+    auto file = source.nextBlock(std::numeric_limits<size_t>::max());
+    const std::string path = dir + "/nasdaq_itch.20191230.dat.gz";
+    const size_t half = file.size() / 2;
+    for (auto [mode, part] :
+         {std::pair("wb1", file.first(half)), std::pair("ab1", file.subspan(half))}) {
+      gzFile gz = gzopen(path.c_str(), mode);
+      REQUIRE(gz != nullptr);
+      REQUIRE(gzwrite(gz, part.data(), unsigned(part.size())) == int(part.size()));
+      REQUIRE(gzclose(gz) == Z_OK);
+    }
+  }
+
+  for (size_t bufferSize : {size_t(1000), datasource::Itch50DataSource::BlockSize}) {
+    datasource::Itch50HistDataSource::setRootPath("/opt/data");
+    datasource::Itch50HistDataSource expected(20191230);
+    datasource::Itch50HistDataSource::setRootPath(dir);
+    datasource::Itch50GzHistDataSource gz(20191230, bufferSize, 3);
+    size_t count = 0;
+    bool same = true;
+    while (expected.hasMessage() && same) {
+      same = gz.hasMessage() && gz.nextTime() == expected.nextTime() &&
+             std::ranges::equal(gz.nextMessage(), expected.nextMessage()) &&
+             gz.currentOffset() == expected.currentOffset();
+      expected.advance();
+      gz.advance();
+      ++count;
+    }
+    CHECK(same);
+    CHECK(!gz.hasMessage());
+    CHECK(!gz.failed());
+    CHECK(count == 400017);
+  }
+
+  // blocks of the gzip source
+  const auto midnight = datasource::Itch50HistDataSource::midnightNYTime(20191230);
+  MessageCounter expected;
+  {
+    datasource::Itch50HistDataSource::setRootPath("/opt/data");
+    datasource::Itch50HistDataSource source(20191230);
+    source.setEndTime(midnight + std::chrono::hours(10));
+    itch50::parseMessagesUntil(source.nextBlock(std::numeric_limits<size_t>::max()),
+                               source.endTimeSinceMidnight(), expected);
+  }
+  datasource::Itch50HistDataSource::setRootPath(dir);
+  datasource::Itch50GzHistDataSource gz(20191230, 1000, 3);
+  gz.setEndTime(midnight + std::chrono::hours(10));
+  MessageCounter counter;
+  while (gz.hasMessage()) {
+    auto res = itch50::parseMessagesUntil(gz.nextBlock(), gz.endTimeSinceMidnight(), counter);
+    gz.skip(res.offset);
+    if (res.result != itch50::ParseResultType::Success) {
+      break;
+    }
+  }
+  CHECK(counter.counts == expected.counts);
+  CHECK(counter.last == expected.last);
+  CHECK(!gz.failed());
+
+  // a truncated file ends the messages early, as a failure rather than the end of the day
+  const std::string path = dir + "/nasdaq_itch.20191230.dat.gz";
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) / 3);
+  datasource::Itch50GzHistDataSource truncated(20191230, 1000, 3);
+  size_t count = 0;
+  for (; truncated.hasMessage(); truncated.advance()) {
+    ++count;
+  }
+  CHECK(count > 0);
+  CHECK(count < 400017);
+  CHECK(truncated.failed());
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("direct source") {
+  // buffers of one block of O_DIRECT reads have many messages straddling two of them
+  datasource::Itch50HistDataSource::setRootPath("/opt/data");
+  for (size_t bufferSize : {size_t(1000), datasource::Itch50DataSource::BlockSize}) {
+    datasource::Itch50HistDataSource expected(20191230);
+    datasource::Itch50DirectHistDataSource direct(20191230, bufferSize, 3);
+    size_t count = 0;
+    bool same = true;
+    while (expected.hasMessage() && same) {
+      same = direct.hasMessage() && direct.nextTime() == expected.nextTime() &&
+             std::ranges::equal(direct.nextMessage(), expected.nextMessage()) &&
+             direct.currentOffset() == expected.currentOffset();
+      expected.advance();
+      direct.advance();
+      ++count;
+    }
+    CHECK(same);
+    CHECK(!direct.hasMessage());
+    CHECK(count == 400017);
+  }
+
+  // blocks of the direct source, created by the factory
+  const auto midnight = datasource::Itch50HistDataSource::midnightNYTime(20191230);
+  MessageCounter expected;
+  {
+    datasource::Itch50HistDataSource source(20191230);
+    source.setEndTime(midnight + std::chrono::hours(10));
+    itch50::parseMessagesUntil(source.nextBlock(std::numeric_limits<size_t>::max()),
+                               source.endTimeSinceMidnight(), expected);
+  }
+  auto &factory = datasource::HistDataSourceFactory::instance();
+  datasource::Itch50DirectHistDataSource::registerCreator();
+  auto created = factory.create(std::string(datasource::Itch50DirectHistDataSource::name),
+                                20191230);
+  auto *direct = dynamic_cast<datasource::Itch50DataSource *>(created.get());
+  REQUIRE(direct != nullptr);
+  direct->setEndTime(midnight + std::chrono::hours(10));
+  MessageCounter counter;
+  while (direct->hasMessage()) {
+    auto res =
+        itch50::parseMessagesUntil(direct->nextBlock(), direct->endTimeSinceMidnight(), counter);
+    direct->skip(res.offset);
+    if (res.result != itch50::ParseResultType::Success) {
+      break;
+    }
+  }
+  CHECK(counter.counts == expected.counts);
+  CHECK(counter.last == expected.last);
+}
+
+TEST_CASE("seek index") {
+  using namespace std::chrono_literals;
+  // the index is built next to a link to the day file, then loaded from there
+  const std::string dir = "/tmp/itch50book_test_idx";
+  std::filesystem::create_directories(dir);
+  std::filesystem::create_symlink("/opt/data/nasdaq_itch.20191230.dat",
+                                  dir + "/nasdaq_itch.20191230.dat");
+  datasource::Itch50HistDataSource::setRootPath(dir);
+  const auto built = datasource::Itch50SeekIndex::loadOrBuild(20191230);
+  REQUIRE(std::filesystem::exists(datasource::Itch50SeekIndex::path(20191230)));
+  const auto loaded = datasource::Itch50SeekIndex::loadOrBuild(20191230);
+  CHECK(loaded.dataSize() == std::filesystem::file_size("/opt/data/nasdaq_itch.20191230.dat"));
+  CHECK(loaded.entries().size() == built.entries().size());
+  CHECK(std::ranges::equal(loaded.entries(), built.entries(), [](auto &a, auto &b) {
+    return a.time == b.time && a.offset == b.offset && a.ordinal == b.ordinal;
+  }));
+  const std::string indexPath = datasource::Itch50SeekIndex::path(20191230);
+  CHECK(loaded.dataMTime() == built.dataMTime());
+  CHECK(loaded.dataMTime().count() != 0);
+  CHECK_THROWS_AS(
+      datasource::Itch50SeekIndex::load(indexPath, loaded.dataSize() + 1, loaded.dataMTime()),
+      std::runtime_error);
+  CHECK_THROWS_AS(datasource::Itch50SeekIndex::load(indexPath, loaded.dataSize(),
+                                                    loaded.dataMTime() + 1ns),
+                  std::runtime_error);
+  {
+    // a corrupt number of entries is an error, not a huge allocation
+    std::fstream file(indexPath, std::ios::binary | std::ios::in | std::ios::out);
+    const uint64_t numEntries = uint64_t(1) << 61;
+    file.seekp(32);
+    file.write(reinterpret_cast<const char *>(&numEntries), sizeof(numEntries));
+  }
+  CHECK_THROWS_AS(
+      datasource::Itch50SeekIndex::load(indexPath, loaded.dataSize(), loaded.dataMTime()),
+      std::runtime_error);
+
+  // entries are at the ordinals and offsets of the first messages of their intervals
+  bool same = true;
+  {
+    datasource::Itch50HistDataSource source(20191230);
+    auto entry = loaded.entries().begin();
+    for (uint64_t ordinal = 0; source.hasMessage() && entry != loaded.entries().end();
+         ++ordinal, source.advance()) {
+      if (ordinal == entry->ordinal) {
+        same = same && source.currentOffset() == entry->offset &&
+               source.nextTime() - source.midnight() == entry->time;
+        ++entry;
+      }
+    }
+    same = same && entry == loaded.entries().end();
+  }
+  CHECK(same);
+
+  // seeking by the index lands on the message advancing does, also at and past the file end
+  auto index = std::make_shared<const datasource::Itch50SeekIndex>(loaded);
+  const auto midnight = datasource::Itch50HistDataSource::midnightNYTime(20191230);
+  const std::array<std::chrono::nanoseconds, 7> times = {
+      0ns, loaded.entries()[1].time, loaded.entries()[1].time + 1ns, 4h, 9h + 31min,
+      loaded.entries().back().time, 24h};
+  for (auto time : times) {
+    datasource::Itch50HistDataSource expected(20191230);
+    datasource::Itch50HistDataSource source(20191230);
+    source.setSeekIndex(index);
+    expected.seek(midnight + time);
+    source.seek(midnight + time);
+    same = same && source.nextTime() == expected.nextTime() &&
+           source.currentOffset() == expected.currentOffset() &&
+           std::ranges::equal(source.nextMessage(), expected.nextMessage());
+  }
+  CHECK(same);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("checkpoint") {
+  // a replay resumed from a checkpoint ends with the book of one from the start of the day, and
+  // its listeners see the same updates after the checkpoint
+  using namespace std::chrono_literals;
+  const std::string dir = "/tmp/itch50book_test_ckpt";
+  std::filesystem::create_directories(dir);
+  datasource::Itch50HistDataSource::setRootPath("/opt/data");
+  const auto midnight = datasource::Itch50HistDataSource::midnightNYTime(20191230);
+  const std::chrono::nanoseconds time = 4h + 20s;
+
+  struct Result {
+    size_t updates;
+    std::string digest;
+    size_t numOrders;
+    size_t numLevels;
+    size_t numSymbols;
+    bool valid;
+  };
+  // replay all symbols, writing a checkpoint at time, or resuming from it
+  auto replay = [&](bool resume) {
+    OrderBook book(BookID{0});
+    book.resize(CID(65535));
+    StockLocateMap stockLocateMap;
+    CIndex cindex;
+    SymbolHandler symbolHandler(cindex, stockLocateMap, true);
+    datasource::Itch50HistDataSource source(20191230);
+    // the handler sets the midnight of the empty book
+    QuoteHandler quoteHandler(book, stockLocateMap, midnight);
+    if (resume) {
+      const auto path = itch50::Itch50Checkpoint::findBefore(dir, 20191230, time + 1ns);
+      REQUIRE(path);
+      itch50::Itch50Checkpoint checkpoint(*path);
+      CHECK(checkpoint.time() == time);
+      CHECK(!checkpoint.matches(cindex, false));
+      REQUIRE(checkpoint.matches(cindex, true));
+      checkpoint.restore(cindex, stockLocateMap, book);
+      source.seekOffset(checkpoint.offset());
+      CHECK(source.nextTime() - midnight > time);
+    }
+    Listener listener(book, 5, midnight + time + 1ns, midnight + 24h);
+    book.addListener(&listener);
+    auto run = [&](std::chrono::nanoseconds until) {
+      while (source.hasMessage() && source.nextTime() - midnight <= until) {
+        auto res = itch50::parseMessagesUntil(source.nextBlock(), until, symbolHandler,
+                                              quoteHandler);
+        source.skip(res.offset);
+        if (res.result != itch50::ParseResultType::Success) {
+          break;
+        }
+      }
+      quoteHandler.flush();
+    };
+    if (!resume) {
+      run(time);
+      itch50::Itch50Checkpoint::save(itch50::Itch50Checkpoint::path(dir, 20191230, time),
+                                     20191230, time, source.currentOffset(), true, cindex,
+                                     stockLocateMap, book);
+    }
+    run(std::chrono::nanoseconds::max());
+    book.removeListener(&listener);
+    return Result{listener.updates(), listener.digestStr(), book.numOrders(), book.numLevels(),
+                  cindex.size(), book.validate()};
+  };
+
+  const Result expected = replay(false);
+  CHECK(!itch50::Itch50Checkpoint::findBefore(dir, 20191230, time));
+  const Result resumed = replay(true);
+  CHECK(resumed.valid);
+  CHECK(resumed.updates == expected.updates);
+  CHECK(resumed.digest == expected.digest);
+  CHECK(resumed.numOrders == expected.numOrders);
+  CHECK(resumed.numLevels == expected.numLevels);
+  CHECK(resumed.numSymbols == expected.numSymbols);
+  CHECK(expected.updates > 100000);
+
+  // corrupt copies of the checkpoint: a symbol count whose size wraps around to the right one,
+  // and a locate mapped twice.  The header has the symbol and locate counts at offsets 32 and 40
+  // of its 48 bytes, the symbols and locate records follow
+  std::string bytes;
+  {
+    std::ifstream in(itch50::Itch50Checkpoint::path(dir, 20191230, time), std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  uint64_t numSymbols;
+  std::memcpy(&numSymbols, bytes.data() + 32, 8);
+  auto restoreCorrupt = [&](size_t offset, uint64_t value, size_t valueSize) {
+    std::string copy = bytes;
+    std::memcpy(copy.data() + offset, &value, valueSize);
+    const std::string path = dir + "/corrupt.ckpt";
+    std::ofstream(path, std::ios::binary) << copy;
+    itch50::Itch50Checkpoint checkpoint(path);
+    OrderBook book(BookID{0});
+    StockLocateMap stockLocateMap;
+    CIndex cindex;
+    checkpoint.restore(cindex, stockLocateMap, book);
+  };
+  CHECK_THROWS_AS(restoreCorrupt(32, numSymbols + (uint64_t(1) << 61), 8), std::runtime_error);
+  uint32_t firstLocate;
+  std::memcpy(&firstLocate, bytes.data() + 48 + numSymbols * 8, 4);
+  CHECK_THROWS_AS(restoreCorrupt(48 + numSymbols * 8 + 8, firstLocate, 4), std::runtime_error);
+  std::filesystem::remove_all(dir);
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "ChunkProvider.h"
+#include <absl/log/log.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sys/mman.h>
+
+namespace bookproj {
+
+namespace {
+constexpr size_t HugePageSize2M = size_t(1) << 21;
+
+constexpr size_t roundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+// size of the mapping of a chunk of size
+size_t mappedSize(size_t size) { return roundUp(size, HugePageSize2M); }
+
+// AnonHugePages of the mapping that holds addr in kB, 0 if smaps can not be read
+size_t anonHugePagesKB(const void *addr) {
+  const auto address = reinterpret_cast<uintptr_t>(addr);
+  std::ifstream in("/proc/self/smaps");
+  bool holds = false;
+  for (std::string line; std::getline(in, line);) {
+    // a mapping starts with its range in lowercase hex, its fields with a capital
+    if (std::isdigit(line[0]) || (line[0] >= 'a' && line[0] <= 'f')) {
+      unsigned long start = 0, end = 0;
+      holds = std::sscanf(line.c_str(), "%lx-%lx", &start, &end) == 2 && start <= address &&
+              address < end;
+    } else if (holds && line.starts_with("AnonHugePages:")) {
+      return std::strtoull(line.c_str() + strlen("AnonHugePages:"), nullptr, 10);
+    }
+  }
+  return 0;
+}
+
+// whether the kernel backs memory advised MADV_HUGEPAGE with transparent huge pages, probed once
+// by touching a 2MB aligned page of a mapping of its own.  MADV_DONTFORK keeps the kernel from
+// merging the mapping with others, whose huge pages smaps would count with it
+bool transparentHugePages() {
+  static const bool backed = [] {
+    std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string mode;
+    std::getline(in, mode);
+    if (!in || mode.find("[never]") != std::string::npos) {
+      return false;
+    }
+    void *area = mmap(nullptr, 2 * HugePageSize2M, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+      return false;
+    }
+    std::byte *page = reinterpret_cast<std::byte *>(
+        roundUp(reinterpret_cast<uintptr_t>(area), HugePageSize2M));
+    bool result = madvise(area, 2 * HugePageSize2M, MADV_DONTFORK) == 0 &&
+                  madvise(page, HugePageSize2M, MADV_HUGEPAGE) == 0;
+    if (result) {
+      *reinterpret_cast<volatile std::byte *>(page) = std::byte(0);
+      result = anonHugePagesKB(page) != 0;
+    }
+    munmap(area, 2 * HugePageSize2M);
+    return result;
+  }();
+  return backed;
+}
+
+class HeapChunkProvider final : public ChunkProvider {
+public:
+  virtual void *allocate(size_t size, ChunkBacking &backing) override {
+    backing = ChunkBacking::Heap;
+    return ::operator new(size, std::align_val_t(Alignment));
+  }
+  virtual void deallocate(void *chunk, size_t, ChunkBacking) override {
+    ::operator delete(chunk, std::align_val_t(Alignment));
+  }
+};
+} // namespace
+
+const char *toString(ChunkBacking backing) {
+  switch (backing) {
+  case ChunkBacking::Heap:
+    return "heap";
+  case ChunkBacking::HugeTLB2M:
+    return "hugetlb-2M";
+  case ChunkBacking::TransparentHugePages:
+    return "thp";
+  case ChunkBacking::SmallPages:
+    return "4K";
+  }
+  return "unknown";
+}
+
+std::string toString(const ChunkCounts &counts) {
+  std::string result;
+  for (size_t ii = 0; ii < NumChunkBackings; ++ii) {
+    if (counts[ii] != 0) {
+      result += (result.empty() ? "" : ", ") + std::to_string(counts[ii]) + ' ' +
+                toString(ChunkBacking(ii));
+    }
+  }
+  return result.empty() ? "none" : result;
+}
+
+ChunkProvider &ChunkProvider::heap() {
+  static HeapChunkProvider provider;
+  return provider;
+}
+
+void *HugePageChunkProvider::allocate(size_t size, ChunkBacking &backing) {
+  constexpr int Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  const size_t mapped = mappedSize(size);
+  void *chunk = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                     Flags | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+  if (chunk != MAP_FAILED) {
+    backing = ChunkBacking::HugeTLB2M;
+    return chunk;
+  }
+
+  // no reserved huge pages left, map 2MB more than needed and trim it to a 2MB aligned chunk so
+  // that all of it can be backed by transparent ones
+  void *area = mmap(nullptr, mapped + HugePageSize2M, PROT_READ | PROT_WRITE, Flags, -1, 0);
+  if (area == MAP_FAILED) {
+    LOG(ERROR) << "Error mapping a chunk of " << size << " bytes: " << strerror(errno);
+    throw std::bad_alloc();
+  }
+  std::byte *begin = static_cast<std::byte *>(area);
+  std::byte *aligned = reinterpret_cast<std::byte *>(
+      roundUp(reinterpret_cast<uintptr_t>(begin), HugePageSize2M));
+  if (aligned != begin) {
+    munmap(begin, aligned - begin);
+  }
+  munmap(aligned + mapped, begin + HugePageSize2M - aligned);
+  backing = transparentHugePages() && madvise(aligned, mapped, MADV_HUGEPAGE) == 0
+                ? ChunkBacking::TransparentHugePages
+                : ChunkBacking::SmallPages;
+  return aligned;
+}
+
+void HugePageChunkProvider::deallocate(void *chunk, size_t size, ChunkBacking) {
+  munmap(chunk, mappedSize(size));
+}
+
+HugePageChunkProvider &HugePageChunkProvider::instance() {
+  static HugePageChunkProvider provider;
+  return provider;
+}
+} // namespace bookproj
\ No newline at end of file
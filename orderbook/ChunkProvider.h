@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bookproj {
+// what backs the memory of a chunk
+enum class ChunkBacking : uint8_t {
+  // operator new, which may or may not be on huge pages depending on the allocator
+  Heap,
+  // reserved 2MB huge pages mapped with MAP_HUGETLB
+  HugeTLB2M,
+  // anonymous memory advised MADV_HUGEPAGE, where a probe found that the kernel backs such memory
+  // with transparent huge pages
+  TransparentHugePages,
+  // anonymous memory, transparent huge pages are disabled or the probe was not given one
+  SmallPages,
+};
+constexpr size_t NumChunkBackings = size_t(ChunkBacking::SmallPages) + 1;
+const char *toString(ChunkBacking backing);
+
+// number of chunks of each backing
+using ChunkCounts = std::array<size_t, NumChunkBackings>;
+// e.g. "3 hugetlb-2M, 1 heap", "none" for no chunks
+std::string toString(const ChunkCounts &counts);
+
+// ChunkProvider allocates the large chunks pools carve objects from.  Chunks are allocated
+// rarely, so providers are virtual and chosen at runtime
+class ChunkProvider {
+public:
+  // chunks are aligned to at least this
+  static constexpr size_t Alignment = 64;
+
+  virtual ~ChunkProvider() = default;
+
+  // a chunk of size bytes and what backs it, throw std::bad_alloc if there is no memory
+  virtual void *allocate(size_t size, ChunkBacking &backing) = 0;
+  // free a chunk allocated by this provider with the same size and backing
+  virtual void deallocate(void *chunk, size_t size, ChunkBacking backing) = 0;
+
+  // chunks from operator new, the default of pools
+  static ChunkProvider &heap();
+};
+
+// HugePageChunkProvider maps chunks from reserved 2MB huge pages with MAP_HUGETLB, rounding chunks
+// up to whole pages, pools use chunks of a few MB so 1GB pages would be mostly unused.  Without
+// enough reserved pages it falls back to anonymous memory aligned to 2MB and advised
+// MADV_HUGEPAGE, so the TLB benefit does not depend on how the allocator or host is set up
+class HugePageChunkProvider final : public ChunkProvider {
+public:
+  virtual void *allocate(size_t size, ChunkBacking &backing) override;
+  virtual void deallocate(void *chunk, size_t size, ChunkBacking backing) override;
+
+  static HugePageChunkProvider &instance();
+};
+} // namespace bookproj
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include <cmath>
 #include <concepts>
 #include <functional>
+#include <cstdint>
 #include <limits>
+#include <type_traits>
 
 namespace bookproj {
 
@@ -34,11 +36,34 @@ template <std::integral Storage, int Decimals> struct FPPrice {
   static constexpr FPPrice fromRaw(Storage px) { return FPPrice(px); }
   static constexpr Storage toRaw(FPPrice px) { return px.value; }
 
+  // exact conversion from an integer number of 10^-D units, e.g. fromScaled<4>(123400) is 12.34.
+  // For D <= Decimals it is one integer multiply, for D > Decimals it rounds half away from zero
+  // like FPPrice(double).  The result must fit in Storage
+  template <int D, std::integral I> static constexpr FPPrice fromScaled(I scaled) {
+    static_assert(D >= 0 && D <= 18);
+    using Wide = std::conditional_t<std::is_signed_v<I>, int64_t, uint64_t>;
+    if constexpr (D <= Decimals) {
+      return FPPrice(Storage(Wide(scaled) * Wide(pow10(Decimals - D))));
+    } else {
+      constexpr Wide div = Wide(pow10(D - Decimals));
+      const Wide wide = scaled;
+      return FPPrice(Storage(std::is_signed_v<I> && wide < 0 ? (wide - div / 2) / div
+                                                             : (wide + div / 2) / div));
+    }
+  }
+
   struct Hash {
     constexpr size_t operator()(FPPrice p) const { return std::hash<Storage>()(p.value); }
   }; // namespace bookproj
 
 private:
+  static constexpr uint64_t pow10(int d) {
+    uint64_t p = 1;
+    for (int ii = 0; ii < d; ++ii, p *= 10)
+      ;
+    return p;
+  }
+
   static constexpr Storage round(double px) {
     if constexpr (sizeof(Storage) == sizeof(long long)) {
       return std::llround(px);
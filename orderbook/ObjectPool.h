@@ -1,24 +1,83 @@
 #pragma once
+#include "ChunkProvider.h"
 #include <absl/log/log.h>
+#include <algorithm>
+#include <bit>
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
 #include <vector>
 
 namespace bookproj {
+// PoolHandle addresses an object of T in an ObjectPool by its 32-bit index.  Handles are typed,
+// so that those of different pools do not mix, and hold no address, so that they stay valid
+// wherever the pool chunks are.  The default handle is null
+template <typename T> class PoolHandle {
+public:
+  using Index = uint32_t;
+  static constexpr Index NullIndex = ~Index(0);
+
+  constexpr PoolHandle() = default;
+  constexpr explicit PoolHandle(Index index) : idx(index) {}
+
+  constexpr Index index() const { return idx; }
+  constexpr explicit operator bool() const { return idx != NullIndex; }
+  constexpr bool operator==(const PoolHandle &) const = default;
+
+private:
+  Index idx = NullIndex;
+};
+
+// ObjectPool allocates objects of T from chunks and addresses them by handles whose 32-bit
+// indices hold the chunk number in the high bits and the slot in the chunk in the low bits, so
+// dereferencing a handle is two loads.  Indices are below 2^31, callers may use the top bit to
+// tag their own indices.
+// Chunks come from a ChunkProvider, operator new unless set otherwise.  Each chunk keeps its own
+// free list and objects are created in the lowest chunk with a free slot, so that they stay
+// dense in the first chunks and the last ones empty out.  compact() moves the objects of the last
+// chunk to the others in bounded steps and gives the chunk back, indices stay dense.
 template <typename T> class ObjectPool {
+public:
+  using Handle = PoolHandle<T>;
+  using Index = typename Handle::Index;
+  static constexpr Index NullIndex = Handle::NullIndex;
+
+private:
   union S {
     alignas(T) std::byte storage[sizeof(T)];
-    S *next;
+    Index next;
+  };
+
+  struct Chunk {
+    S *slots;
+    // free slots of the chunk, linked by S::next
+    Index freeList = NullIndex;
+    uint32_t numFree = 0;
+    ChunkBacking backing;
   };
 
   // allocation unit in bytes
   static constexpr size_t DefaultChunkSize = 2ul << 20;
   static constexpr size_t ObjSize = sizeof(S);
+  static constexpr int IndexBits = 31;
+  static_assert(alignof(S) <= ChunkProvider::Alignment);
+  static constexpr size_t NoChunk = ~size_t(0);
+
+  struct UnitCost {
+    size_t operator()(Handle) const { return 1; }
+  };
 
 public:
   ObjectPool() noexcept
       : ObjectPool(DefaultChunkSize < ObjSize ? 1 : DefaultChunkSize / ObjSize) {}
   // batchSize is objects to allocate in one go
-  explicit ObjectPool(size_t batchSize) noexcept : chunkByteSize(batchSize * ObjSize) {}
+  explicit ObjectPool(size_t batchSize) noexcept
+      : chunkByteSize(batchSize * ObjSize), slotBits(std::bit_width(batchSize - 1)),
+        slotMask((Index(1) << slotBits) - 1) {
+    assert(slotBits < IndexBits);
+  }
 
   ObjectPool(const ObjectPool &) = delete;
   ObjectPool &operator=(const ObjectPool &) = delete;
@@ -27,50 +86,243 @@ public:
     if (numAllocated() != 0) {
       LOG(ERROR) << numAllocated() << " objects are not destroyed at destruction of ObjectPool";
     }
-    for (auto c : chunks) {
-      delete[] c;
+    for (const Chunk &chunk : chunks) {
+      provider->deallocate(chunk.slots, chunkByteSize, chunk.backing);
     }
   }
 
-  template <typename... Args> T *create(Args &&...args) {
-    if (0 == freeCount) [[unlikely]] {
-      reserve(chunkByteSize / ObjSize);
-    }
-    S *s = freeList;
-    freeList = freeList->next;
-    --freeCount;
-    return new (s->storage) T(std::forward<Args>(args)...);
+  // allocate chunks from provider, which must outlive the pool.  Must be called before any
+  // chunk is allocated
+  void setChunkProvider(ChunkProvider &p) {
+    assert(chunks.empty());
+    provider = &p;
+  }
+
+  // construct an object, return its handle and address
+  template <typename... Args> std::pair<Handle, T *> create(Args &&...args) {
+    const Index index = allocate();
+    return {Handle(index), new (slot(index)->storage) T(std::forward<Args>(args)...)};
   }
 
-  void destroy(T *t) {
-    t->~T();
-    S *s = reinterpret_cast<S *>(t);
-    s->next = freeList;
-    freeList = s;
+  void destroy(Handle handle) {
+    (*this)[handle]->~T();
+    const Index index = handle.index();
+    const size_t c = index >> slotBits;
+    Chunk &chunk = chunks[c];
+    slot(index)->next = chunk.freeList;
+    chunk.freeList = index;
     ++freeCount;
+    if (chunk.numFree++ == 0 || c == draining) [[unlikely]] {
+      freed(c, index);
+    }
+  }
+
+  // address of a live object
+  T *operator[](Handle handle) const {
+    return std::launder(reinterpret_cast<T *>(slot(handle.index())->storage));
   }
 
   void reserve(size_t nobjs) {
     while (freeCount < nobjs) {
-      S *ss = new S[chunkByteSize / ObjSize];
-      for (size_t i = 0; i < chunkByteSize / ObjSize; ++i) {
-        S *s = ss + (chunkByteSize / ObjSize - i - 1);
-        s->next = freeList;
-        freeList = s;
-        ++freeCount;
+      grow();
+    }
+  }
+
+  // move up to maxMoves objects out of the last chunk, and give back the chunks that become empty.
+  // The last chunk is drained once the others have room for its objects and a quarter chunk
+  // more, so that the pool does not grow again right away, and takes no new objects meanwhile.
+  // Marking a free slot of it counts as a move.  An object is moved by move constructing it at a
+  // free slot of the other chunks, calling moved(from, to) to point references to it at its new
+  // handle, and destroying it at the old one.  Moving an object counts as cost(handle) moves, at
+  // least one, e.g. one per reference moved points elsewhere.  One costing more than the moves
+  // left is left for the next call, unless it is the first of the call, so that a call moves at
+  // most maxMoves or a single object.  Returns false once there is nothing to compact, growing
+  // the pool stops a compaction under way
+  template <typename Moved, typename Cost = UnitCost>
+  bool compact(size_t maxMoves, Moved &&moved, Cost &&cost = Cost()) {
+    const size_t batchSize = chunkByteSize / ObjSize;
+    const size_t budget = maxMoves;
+    while (true) {
+      if (draining == NoChunk) {
+        if (freeCount < batchSize + batchSize / 4) {
+          return false;
+        }
+        startDrain();
+      }
+      // the free slots of the chunk as of the start, those freed since are marked by destroy
+      for (; markCursor != NullIndex && maxMoves != 0; --maxMoves) {
+        drainFree[markCursor & slotMask] = true;
+        markCursor = slot(markCursor)->next;
+      }
+      for (; moveCursor < batchSize && maxMoves != 0; ++moveCursor) {
+        if (!drainFree[moveCursor]) {
+          if (firstFree == chunks.size()) [[unlikely]] {
+            // the others filled up since the drain started
+            stopDrain();
+            return false;
+          }
+          const Handle from(Index(draining << slotBits) | Index(moveCursor));
+          const size_t moves = std::max(size_t(cost(from)), size_t(1));
+          if (moves > maxMoves && maxMoves != budget) {
+            return true;
+          }
+          const Handle to(allocate());
+          new (slot(to.index())->storage) T(std::move(*(*this)[from]));
+          moved(from, to);
+          destroy(from);
+          maxMoves -= std::min(moves, maxMoves);
+        }
+      }
+      if (markCursor != NullIndex || moveCursor < batchSize) {
+        return true;
       }
-      chunks.push_back(ss);
+      assert(chunks[draining].numFree == batchSize);
+      draining = NoChunk;
+      drainFree.clear();
+      popChunk();
+    }
+  }
+
+  // give back the last chunk if it holds no objects, however little room the others have left.
+  // For pools whose users empty the last chunk themselves.  Returns whether it did
+  bool releaseEmptyLast() {
+    if (chunks.size() == 0 || chunks.back().numFree != chunkByteSize / ObjSize) {
+      return false;
     }
+    stopDrain();
+    const size_t c = chunks.size() - 1;
+    hasFree[c / 64] &= ~(uint64_t(1) << (c % 64));
+    popChunk();
+    return true;
   }
 
+  // all handle indices handed out so far are below this, for arrays kept in parallel to the pool
+  size_t indexLimit() const { return chunks.size() << slotBits; }
+
   size_t numFree() const { return freeCount; }
   size_t numAllocated() const { return chunks.size() * (chunkByteSize / ObjSize) - freeCount; }
+  size_t numChunks() const { return chunks.size(); }
+
+  // chunks by what backs them, as the provider reported
+  ChunkCounts chunkCounts() const {
+    ChunkCounts counts{};
+    for (const Chunk &chunk : chunks) {
+      ++counts[size_t(chunk.backing)];
+    }
+    return counts;
+  }
 
 private:
+  S *slot(Index index) const { return chunks[index >> slotBits].slots + (index & slotMask); }
+
+  // pop a free slot of the lowest chunk with one
+  Index allocate() {
+    if (firstFree == chunks.size()) [[unlikely]] {
+      grow();
+    }
+    Chunk &chunk = chunks[firstFree];
+    const Index index = chunk.freeList;
+    chunk.freeList = slot(index)->next;
+    --freeCount;
+    if (--chunk.numFree == 0) [[unlikely]] {
+      hasFree[firstFree / 64] &= ~(uint64_t(1) << (firstFree % 64));
+      firstFree = nextWithFree(firstFree);
+    }
+    return index;
+  }
+
+  // slot index of chunk c was freed, the first free one of the chunk or one of the chunk drained
+  void freed(size_t c, Index index) {
+    if (c == draining) {
+      drainFree[index & slotMask] = true;
+      return;
+    }
+    hasFree[c / 64] |= uint64_t(1) << (c % 64);
+    firstFree = std::min(firstFree, c);
+  }
+
+  // the lowest chunk from c on with a free slot, chunks.size() if none
+  size_t nextWithFree(size_t c) const {
+    for (size_t w = c / 64; w < hasFree.size(); ++w) {
+      const uint64_t mask = w == c / 64 ? ~uint64_t(0) << (c % 64) : ~uint64_t(0);
+      if (const uint64_t bits = hasFree[w] & mask; bits != 0) {
+        return w * 64 + std::countr_zero(bits);
+      }
+    }
+    return chunks.size();
+  }
+
+  void grow() {
+    if (chunks.size() >= (size_t(1) << (IndexBits - slotBits))) [[unlikely]] {
+      throw std::bad_alloc();
+    }
+    stopDrain();
+    const size_t batchSize = chunkByteSize / ObjSize;
+    const Index base = Index(chunks.size()) << slotBits;
+    Chunk &chunk = chunks.emplace_back();
+    chunk.slots = static_cast<S *>(provider->allocate(chunkByteSize, chunk.backing));
+    for (size_t i = 0; i < batchSize; ++i) {
+      Index index = base | Index(batchSize - i - 1);
+      slot(index)->next = chunk.freeList;
+      chunk.freeList = index;
+    }
+    chunk.numFree = uint32_t(batchSize);
+    freeCount += batchSize;
+    hasFree.resize((chunks.size() + 63) / 64);
+    freed(chunks.size() - 1, base);
+  }
+
+  // give back the last chunk, which is empty and marked as having no free slot
+  void popChunk() {
+    provider->deallocate(chunks.back().slots, chunkByteSize, chunks.back().backing);
+    chunks.pop_back();
+    hasFree.resize((chunks.size() + 63) / 64);
+    firstFree = std::min(firstFree, chunks.size());
+    freeCount -= chunkByteSize / ObjSize;
+  }
+
+  // drain the last chunk: it takes no new objects, its free slots are marked, then its objects
+  // are moved
+  void startDrain() {
+    draining = chunks.size() - 1;
+    hasFree[draining / 64] &= ~(uint64_t(1) << (draining % 64));
+    if (firstFree == draining) {
+      firstFree = nextWithFree(draining);
+    }
+    drainFree.assign(chunkByteSize / ObjSize, false);
+    markCursor = chunks[draining].freeList;
+    moveCursor = 0;
+  }
+
+  // give the chunk drained back its free slots
+  void stopDrain() {
+    if (draining != NoChunk) {
+      const size_t c = std::exchange(draining, NoChunk);
+      drainFree.clear();
+      if (chunks[c].numFree != 0) {
+        freed(c, NullIndex);
+      }
+    }
+  }
+
   const size_t chunkByteSize;
+  const int slotBits;
+  const Index slotMask;
 
-  S *freeList = nullptr;
-  std::vector<S *> chunks;
+  ChunkProvider *provider = &ChunkProvider::heap();
+  std::vector<Chunk> chunks;
+  // bit per chunk, set if it has a free slot and is not drained
+  std::vector<uint64_t> hasFree;
+  // the lowest chunk with a free slot, chunks.size() if none
+  size_t firstFree = 0;
   size_t freeCount = 0;
+
+  // the chunk being drained by compact, NoChunk if none
+  size_t draining = NoChunk;
+  // free slots of the chunk drained
+  std::vector<bool> drainFree;
+  // next free slot to mark, and next slot to move
+  Index markCursor = NullIndex;
+  size_t moveCursor = 0;
 };
 } // namespace bookproj
\ No newline at end of file
@@ -1,4 +1,8 @@
 #include "OrderBook.h"
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <stdexcept>
 
 namespace bookproj::orderbook {
 std::string OrderBook::getLevelString(const Level &level) {
@@ -17,52 +21,99 @@ bool OrderBook::validate(CID cid) const {
   const auto &book = books[toUnderlying(cid)];
   const auto &bidHalf = book.halves[0];
   if (!std::is_sorted(bidHalf.begin(), bidHalf.end(),
-                      [](auto &a, auto &b) { return a.first > b.first; })) {
+                      [](const auto &a, const auto &b) { return a.first > b.first; })) {
     LOG(ERROR) << "Bid levels are not ordered by price for half: " << getHalfString(bidHalf);
     success = false;
   }
   const auto &askHalf = book.halves[1];
   if (!std::is_sorted(askHalf.begin(), askHalf.end(),
-                      [](auto &a, auto &b) { return a.first < b.first; })) {
+                      [](const auto &a, const auto &b) { return a.first < b.first; })) {
     LOG(ERROR) << "Ask levels are not ordered by price for half: " << getHalfString(askHalf);
     success = false;
   }
 
   for (auto &half : book.halves) {
-    for (auto &levelref : half) {
+    const Level *top = half.empty() ? nullptr : half.begin()->second;
+    const size_t numTops = half.numTopLevels();
+    bool topsMatch = half.top() == top && numTops == std::min(half.size(), Half::TopSize);
+    auto levelIter = half.begin();
+    for (size_t ii = 0; topsMatch && ii < numTops; ++ii, ++levelIter) {
+      const Level *level = levelIter->second;
+      topsMatch = half.topLevel(ii) == level && half.topPrices()[ii] == level->price &&
+                  half.topShares()[ii] == level->totalShares &&
+                  half.topNumOrders()[ii] == level->numOrders();
+    }
+    if (!topsMatch) {
+      LOG(ERROR) << "Top levels mismatch for half: " << getHalfString(half);
+      success = false;
+    }
+    const BBO::Quote &quote = half.side == Side::Bid ? book.bbo.bid : book.bbo.ask;
+    BBO::Quote expected;
+    if (top != nullptr) {
+      expected = {top->price, top->totalShares, uint32_t(top->numOrders())};
+    }
+    if (quote != expected) {
+      LOG(ERROR) << "BBO mismatch, Price=" << static_cast<double>(quote.price)
+                 << " TotalShares=" << quote.totalShares << " NumOrders=" << quote.numOrders
+                 << " half: " << getHalfString(half);
+      success = false;
+    }
+    for (const auto &levelref : half) {
       const Level *level = levelref.second;
       if (level->half != &half) {
         LOG(ERROR) << "Level half mismatch, level: " << getLevelString(*level)
                    << ", half: " << getHalfString(half);
         success = false;
       }
+      if (half.find(level->price) != level) {
+        LOG(ERROR) << "Level not found by price in half, level: " << getLevelString(*level);
+        success = false;
+      }
       if (level->empty()) {
         LOG(ERROR) << "Level is empty, " << getLevelString(*level);
         success = false;
       }
 
       Quantity totalShares = 0;
-      for (const auto &oref : *level) {
-        auto order = &oref;
-        if (order->level != level || order->cid != cid || order->side != level->side() ||
-            order->price != level->price) {
-          LOG(ERROR) << "Order level mismatch, order: " << toUnderlying(cid) << ", "
-                     << order->toString() << ", level: " << getLevelString(*level);
+      size_t numOrders = 0;
+      OrderIndex prev = NullIndex;
+      for (OrderIndex index = level->head; index != NullIndex; index = orderAt(index)->next) {
+        const OrderExt *order = orderAt(index);
+        if (order->index != index) {
+          LOG(ERROR) << "Order index mismatch, order: " << toOrder(*order, half).toString();
+          success = false;
+        }
+        if (levelOf(order) != level || toPrice(order->price) != level->price) {
+          LOG(ERROR) << "Order level mismatch, order: " << toOrder(*order, half).toString()
+                     << ", level: " << getLevelString(*level);
+          success = false;
+        }
+        if (order->prev != prev) {
+          LOG(ERROR) << "Order prev link mismatch, order: " << toOrder(*order, half).toString();
           success = false;
         }
         if (order->quantity <= 0) {
-          LOG(ERROR) << "Order quantity is non-positive, order: " << order->toString();
+          LOG(ERROR) << "Order quantity is non-positive, order: "
+                     << toOrder(*order, half).toString();
           success = false;
         }
-        if (auto oit = orders.find(order->refNum); oit == orders.end()) {
-          LOG(ERROR) << "Order not found in orders map, " << order->toString();
+        if (auto found = findOrder(refNumOf(order)); found == nullptr) {
+          LOG(ERROR) << "Order not found in orders map, " << toOrder(*order, half).toString();
           success = false;
-        } else if (oit->second != order) {
-          LOG(ERROR) << "Order is not the same as in orders map, order: " << order->toString()
-                     << ", in order map: " << oit->second->toString();
+        } else if (found != order) {
+          LOG(ERROR) << "Order is not the same as in orders map, order: "
+                     << toOrder(*order, half).toString()
+                     << ", in order map: " << toOrder(*found, half).toString();
           success = false;
         }
         totalShares += order->quantity;
+        ++numOrders;
+        prev = index;
+      }
+      if (level->tail != prev || level->size() != numOrders) {
+        LOG(ERROR) << "Level order list mismatch, Size=" << level->size()
+                   << " LinkedOrders=" << numOrders << " level: " << getLevelString(*level);
+        success = false;
       }
       if (level->totalShares != totalShares) {
         LOG(ERROR) << "Level totalShares is mismatched, LevelTotalShares=" << level->totalShares
@@ -81,43 +132,268 @@ bool OrderBook::validate() const {
     success &= validate(static_cast<CID>(ii));
   }
   // all orders are linked at this point
-  if (orderCount != orders.size()) {
+  const size_t numIndexed = orders.size() + orderWindow.size();
+  if (orderCount != numIndexed) {
     LOG(ERROR) << "Order count mismatch, OrderCount=" << orderCount
-               << " OrdersMapSize=" << orders.size();
+               << " OrdersMapSize=" << numIndexed;
     success = false;
   }
   for (auto &order : orders) {
-    if (order.second->level == nullptr) {
-      LOG(ERROR) << "Order is not linked, " << order.second->toString();
+    if (!orderPool[OrderHandle(order.second)]->level) {
+      LOG(ERROR) << "Order is not linked, refNum: " << toUnderlying(order.first);
+      success = false;
+    }
+    if (poolCold[order.second].refNum != order.first) {
+      LOG(ERROR) << "Order refNum mismatch in orders map, refNum: " << toUnderlying(order.first);
+      success = false;
+    }
+    if (orderWindow.inRange(toUnderlying(order.first))) {
+      LOG(ERROR) << "Order in window range is in orders map, refNum: "
+                 << toUnderlying(order.first);
       success = false;
     }
   }
-  for (auto &level : levels) {
-    if (level.second->empty()) {
-      LOG(ERROR) << "Level is not linked, " << getLevelString(*level.second);
+  orderWindow.forEach([&](const OrderExt &order) {
+    if (!order.level) {
+      LOG(ERROR) << "Order is not linked, refNum: " << toUnderlying(refNumOf(&order));
       success = false;
     }
+  });
+  if (!std::ranges::is_sorted(highOutliers) ||
+      (!highOutliers.empty() && orderWindow.inRange(highOutliers.front()))) {
+    LOG(ERROR) << "High outliers are not sorted or are in window range";
+    success = false;
   }
   size_t totalLevels = 0;
   size_t totalOrders = 0;
   for (auto &book : books) {
     for (auto &half : book.halves) {
       totalLevels += half.size();
-      for (auto &level : half) {
+      for (const auto &level : half) {
         totalOrders += level.second->size();
       }
     }
   }
-  if (totalLevels != levels.size()) {
-    LOG(ERROR) << "Level count mismatch, LevelCount=" << totalLevels
-               << " LevelsMapSize=" << levels.size();
+  if (totalLevels != levelCount || totalLevels != levelPool.numAllocated()) {
+    LOG(ERROR) << "Level count mismatch, CountedLevels=" << totalLevels
+               << " LevelCount=" << levelCount << " LevelPoolSize=" << levelPool.numAllocated();
     success = false;
   }
-  if (totalOrders != orders.size() || totalOrders != orderCount) {
+  if (totalOrders != numIndexed || totalOrders != orderCount) {
     LOG(ERROR) << "Order count mismatch, CountedOrders=" << totalOrders
-               << " OrderCount=" << orderCount << " OrdersMapSize=" << orders.size();
+               << " OrderCount=" << orderCount << " OrdersMapSize=" << numIndexed;
     success = false;
   }
   return success;
 }
+
+bool OrderBook::compact(size_t maxMoves) {
+  // orders are copied to their new slot, their neighbours, level and index entry are pointed to it
+  const bool moreOrders = orderPool.compact(maxMoves, [this](OrderHandle from, OrderHandle to) {
+    OrderExt *moved = orderPool[to];
+    moved->index = to.index();
+    const OrderCold &cold = poolCold[to.index()] = poolCold[from.index()];
+    relinkOrder(*moved);
+    orders.find(cold.refNum)->second = to.index();
+  });
+  poolCold.resize(orderPool.indexLimit());
+  // levels are moved out of their half, which is pointed to the new one, as are their orders
+  const bool moreLevels = levelPool.compact(
+      maxMoves,
+      [this](LevelIndex, LevelIndex to) {
+        Level *moved = levelPool[to];
+        moved->index = to;
+        moved->half->relocate(moved->price, moved);
+        for (OrderIndex ii = moved->head; ii != NullIndex; ii = orderAt(ii)->next) {
+          orderAt(ii)->level = to;
+        }
+      },
+      [this](LevelIndex from) { return levelPool[from]->numOrders() + 1; });
+  return moreOrders || moreLevels;
+}
+
+namespace {
+constexpr char CheckpointMagic[8] = {'B', 'O', 'O', 'K', 'C', 'K', 'P', '1'};
+static_assert(sizeof(OrderBook::CheckpointHeader) % 8 == 0);
+static_assert(sizeof(OrderBook::CheckpointLevel) % 8 == 0);
+static_assert(sizeof(OrderBook::CheckpointOrder) % 8 == 0);
+
+template <typename T> void writeRecord(std::ostream &out, const T &t) {
+  out.write(reinterpret_cast<const char *>(&t), sizeof(T));
+}
+} // namespace
+
+size_t OrderBook::writeCheckpoint(std::ostream &out) const {
+  // records are zeroed first, so that their padding is written as zeros
+  CheckpointHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::copy(std::begin(CheckpointMagic), std::end(CheckpointMagic), header.magic);
+  header.midnight = midnight.time_since_epoch().count();
+  header.numCids = books.size();
+  header.numLevels = levelCount;
+  header.numOrders = orderCount;
+  header.maxNumOrders = maxOrderCount;
+  header.maxNumLevels = maxLevelCount;
+  writeRecord(out, header);
+  for (const auto &book : books) {
+    for (const auto &half : book.halves) {
+      for (const auto &levelref : half) {
+        CheckpointLevel record;
+        std::memset(&record, 0, sizeof(record));
+        record.price = Price::toRaw(levelref.first);
+        record.cid = toUnderlying(half.cid);
+        record.side = half.side;
+        record.numOrders = uint32_t(levelref.second->numOrders());
+        writeRecord(out, record);
+      }
+    }
+  }
+  for (const auto &book : books) {
+    for (const auto &half : book.halves) {
+      for (const auto &levelref : half) {
+        for (const OrderExt &order : *levelref.second) {
+          const OrderCold &cold = coldAt(order.index);
+          CheckpointOrder record{toUnderlying(cold.refNum), order.quantity, 0, 0};
+#if BOOKPROJ_ORDER_TIMESTAMPS
+          record.createTime = cold.createTime;
+          record.updateTime = cold.updateTime;
+#endif
+          writeRecord(out, record);
+        }
+      }
+    }
+  }
+  return sizeof(header) + levelCount * sizeof(CheckpointLevel) +
+         orderCount * sizeof(CheckpointOrder);
+}
+
+size_t OrderBook::restoreCheckpoint(std::span<const std::byte> data) {
+  assert(orderCount == 0 && levelCount == 0 && orders.empty() && orderWindow.empty());
+  CheckpointHeader header;
+  if (data.size() < sizeof(header)) {
+    throw std::runtime_error("Book checkpoint is truncated");
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (!std::equal(std::begin(CheckpointMagic), std::end(CheckpointMagic), header.magic)) {
+    throw std::runtime_error("Not a book checkpoint");
+  }
+  // the counts are checked by division, so that those of a corrupt header can not overflow
+  const size_t levelsSize = data.size() - sizeof(header);
+  if (levelsSize / sizeof(CheckpointLevel) < header.numLevels ||
+      (levelsSize - header.numLevels * sizeof(CheckpointLevel)) / sizeof(CheckpointOrder) <
+          header.numOrders ||
+      reinterpret_cast<uintptr_t>(data.data()) % 8 != 0) {
+    throw std::runtime_error("Book checkpoint is truncated or misaligned");
+  }
+  const size_t size = sizeof(header) + header.numLevels * sizeof(CheckpointLevel) +
+                      header.numOrders * sizeof(CheckpointOrder);
+  const std::span levels(
+      std::launder(reinterpret_cast<const CheckpointLevel *>(data.data() + sizeof(header))),
+      header.numLevels);
+  const std::span records(
+      std::launder(reinterpret_cast<const CheckpointOrder *>(levels.data() + levels.size())),
+      header.numOrders);
+
+  midnight = Timestamp(std::chrono::nanoseconds(header.midnight));
+  if (!std::in_range<int32_t>(header.numCids)) {
+    throw std::runtime_error("Book checkpoint has a bad number of CIDs");
+  }
+  if (std::cmp_less(books.size(), header.numCids)) {
+    // a count in the range of CIDs may still be corrupt, and more than fits in memory
+    try {
+      resize(CID(int32_t(header.numCids)));
+    } catch (const std::bad_alloc &) {
+      throw std::runtime_error("Book checkpoint has more CIDs than fit in memory");
+    }
+  }
+  // the window ends at the newest reference number, where replay leaves it, so it does not slide
+  // while orders are added.  Only orders below it go to the pool and the orders map
+  if (const uint64_t capacity = orderWindow.capacity(); capacity != 0 && !records.empty()) {
+    uint64_t maxRefNum = 0;
+    for (const auto &record : records) {
+      maxRefNum = std::max(maxRefNum, record.refNum);
+    }
+    const uint64_t base = maxRefNum >= capacity ? maxRefNum - capacity + 1 : 0;
+    if (base < orderWindow.base()) {
+      orderWindow.reset(capacity);
+    }
+    orderWindow.advance(base, [](OrderExt &) {});
+    highOutliers.clear();
+  }
+  size_t numPooled = 0;
+  for (const auto &record : records) {
+    // before any level is created.  A book with orders of no quantity does not validate
+    if (record.quantity == 0 || !isOrderQuantity(Quantity(record.quantity))) {
+      throw std::runtime_error("Book checkpoint has a bad order record");
+    }
+    numPooled += !orderWindow.inRange(record.refNum);
+  }
+  orders.reserve(numPooled);
+  orderPool.reserve(numPooled);
+  poolCold.resize(orderPool.indexLimit());
+  levelPool.reserve(levels.size());
+
+  auto record = records.begin();
+  for (const auto &levelRecord : levels) {
+    const Price price = Price::fromRaw(levelRecord.price);
+    if (levelRecord.cid < 0 || std::cmp_greater_equal(levelRecord.cid, books.size()) ||
+        (levelRecord.side != Side::Bid && levelRecord.side != Side::Ask) ||
+        !isOrderPrice(price) || levelRecord.numOrders == 0 ||
+        size_t(records.end() - record) < levelRecord.numOrders) {
+      throw std::runtime_error("Book checkpoint has a bad level record");
+    }
+    Half &half = books[levelRecord.cid].halves[levelRecord.side != Side::Bid];
+    if (half.find(price) != nullptr) {
+      throw std::runtime_error("Book checkpoint has a duplicate level record");
+    }
+    Level *level = findOrCreateLevel(half, price);
+    for (uint32_t ii = 0; ii < levelRecord.numOrders; ++ii, ++record) {
+      OrderExt *order;
+      if (orderWindow.inRange(record->refNum)) {
+        if (orderWindow.find(record->refNum) != nullptr) {
+          throw std::runtime_error("Book checkpoint has a duplicate order record");
+        }
+        order = orderWindow.emplace(record->refNum, Quantity(record->quantity), price);
+        order->index = WindowBit | OrderIndex(orderWindow.slotOf(order));
+      } else {
+        auto [iter, inserted] = orders.try_emplace(ReferenceNum(record->refNum), NullIndex);
+        if (!inserted) {
+          throw std::runtime_error("Book checkpoint has a duplicate order record");
+        }
+        order = createPoolOrder(level, level->tail, Quantity(record->quantity), price);
+        iter->second = order->index;
+      }
+      OrderCold &cold = coldAt(order->index);
+      cold.refNum = ReferenceNum(record->refNum);
+#if BOOKPROJ_ORDER_TIMESTAMPS
+      cold.createTime = record->createTime;
+      cold.updateTime = record->updateTime;
+#endif
+      // append to the level, as linkOrder does
+      order->level = level->index;
+      order->prev = level->tail;
+      if (level->tail != NullIndex) {
+        orderAt(level->tail)->next = order->index;
+      } else {
+        level->head = order->index;
+      }
+      level->tail = order->index;
+      ++level->count;
+      level->totalShares += order->quantity;
+      ++orderCount;
+    }
+    half.updateTop(*level);
+  }
+  if (record != records.end()) {
+    throw std::runtime_error("Book checkpoint has order records of no level");
+  }
+  for (auto &book : books) {
+    for (auto &half : book.halves) {
+      refreshBBO(half);
+    }
+  }
+  maxOrderCount = std::max<size_t>(orderCount, header.maxNumOrders);
+  maxLevelCount = std::max<size_t>(levelCount, header.maxNumLevels);
+  return size;
+}
 } // namespace bookproj::orderbook
\ No newline at end of file
@@ -3,22 +3,47 @@
 #include "CIndex.h"
 #include "ObjectPool.h"
 #include "OrderCommon.h"
+#include "PriceLadder.h"
+#include "SlabPool.h"
+#include "SlidingWindow.h"
 #include "absl/log/log.h"
 #include "ankerl/unordered_dense.h"
 #include "hash/emhash7.h"
 #include "tlx/container/btree_map.hpp"
-#include <boost/intrusive/list.hpp>
 #include <cassert>
+#include <chrono>
+#include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <algorithm>
+#include <iosfwd>
+#include <iterator>
+#include <span>
+#include <tuple>
 #include <utility>
 #include <vector>
 
-using namespace boost::intrusive;
+// order create/update times are tracked unless built with BOOKPROJ_ORDER_TIMESTAMPS=0, listeners
+// then see default constructed timestamps
+#ifndef BOOKPROJ_ORDER_TIMESTAMPS
+#define BOOKPROJ_ORDER_TIMESTAMPS 1
+#endif
+
+// number of best levels of each half book kept in an array, see OrderBook::Half::topLevels
+#ifndef BOOKPROJ_TOP_LEVELS
+#define BOOKPROJ_TOP_LEVELS 10
+#endif
+
+// orders are allocated in slabs per price level if built with BOOKPROJ_ORDER_SLABS=1, see
+// OrderBook::OrderSlabSize
+#ifndef BOOKPROJ_ORDER_SLABS
+#define BOOKPROJ_ORDER_SLABS 0
+#endif
 
 namespace bookproj {
 namespace orderbook {
 
+// Order is what listeners see of an order, the book keeps orders in a more compact form
 struct Order {
   // first argument must be ReferenceNum
   Order(ReferenceNum refNum, CID cid, Side side, Quantity quantity, Price price, Timestamp tm)
@@ -50,6 +75,66 @@ struct ExecInfo {
   std::string toString() const;
 };
 
+// one OrderBook mutation, for applying a batch of them with OrderBook::apply.  Fields not used
+// by the type of the operation are left default
+struct BookOp {
+  enum class Type : uint8_t { NewOrder, ReduceBy, ReduceTo, Replace, Delete, Execute };
+
+  static BookOp newOrder(ReferenceNum refNum, CID cid, Side side, Quantity quantity, Price price,
+                         Timestamp tm) {
+    return {.type = Type::NewOrder, .cid = cid, .side = side, .refNum = refNum,
+            .quantity = quantity, .price = price, .tm = tm};
+  }
+  static BookOp reduceOrderBy(ReferenceNum refNum, Quantity changeQuantity, Timestamp ut) {
+    return {.type = Type::ReduceBy, .refNum = refNum, .quantity = changeQuantity, .tm = ut};
+  }
+  static BookOp reduceOrderTo(ReferenceNum refNum, Quantity newQuantity, Timestamp ut) {
+    return {.type = Type::ReduceTo, .refNum = refNum, .quantity = newQuantity, .tm = ut};
+  }
+  static BookOp replaceOrder(ReferenceNum oldRefNum, ReferenceNum newRefNum, Quantity newQuantity,
+                             Price newPrice, Timestamp tm) {
+    return {.type = Type::Replace, .refNum = oldRefNum, .newRefNum = newRefNum,
+            .quantity = newQuantity, .price = newPrice, .tm = tm};
+  }
+  static BookOp deleteOrder(ReferenceNum refNum, Timestamp ut) {
+    return {.type = Type::Delete, .refNum = refNum, .tm = ut};
+  }
+  static BookOp executeOrder(ReferenceNum refNum, Quantity quantity, const ExecInfo &ei,
+                             Timestamp ut) {
+    return {.type = Type::Execute, .refNum = refNum, .quantity = quantity, .tm = ut, .ei = ei};
+  }
+
+  Type type = Type::Delete;
+  // cid and side of a new order.  The cid of other operations is not used by the book, the
+  // caller may set it to route operations by CID
+  CID cid = CID::invalid();
+  Side side = Side::Bid;
+  // the order, the old order of a replace
+  ReferenceNum refNum = {};
+  // the new order of a replace
+  ReferenceNum newRefNum = {};
+  Quantity quantity = 0;
+  Price price = {};
+  Timestamp tm = {};
+  ExecInfo ei = {};
+};
+
+// best bid and ask of a CID, one cache line.  A side without orders has all fields zero
+struct alignas(64) BBO {
+  struct Quote {
+    Price price = {};
+    Quantity totalShares = 0;
+    uint32_t numOrders = 0;
+
+    bool operator==(const Quote &) const = default;
+  };
+
+  Quote bid;
+  Quote ask;
+
+  bool operator==(const BBO &) const = default;
+};
+
 struct BookListener {
   virtual void onNewOrder(BookID book, const Order *order) = 0;
   virtual void onDeleteOrder(BookID book, const Order *order, Quantity oldQuantity) = 0;
@@ -60,6 +145,163 @@ struct BookListener {
                              Price oldPrice) = 0;
 };
 
+// LevelListener sees the book by price level rather than by order.  Each mutation, e.g. one feed
+// message, yields at most one onLevelChange per level it changed, with the state of the level
+// after it.  isNew is set if the level did not exist before, isRemoved if it is gone, in which
+// case totalShares and numOrders are 0
+struct LevelListener {
+  virtual void onLevelChange(BookID book, CID cid, Side side, Price price, Quantity totalShares,
+                             size_t numOrders, bool isNew, bool isRemoved) = 0;
+};
+
+// BBOListener is told of changes to the best bid or ask of a CID, at most once per mutation.
+// Mutations that leave both tops as they were, which most do, are not reported
+struct BBOListener {
+  virtual void onBBOChange(BookID book, CID cid, const BBO &bbo) = 0;
+};
+
+// OrderBook mutators notify listeners through a dispatch object.  enabled() tells whether there
+// is anyone to notify of orders, when it is false the Order view passed to listeners is not even
+// built.  levelsEnabled() and bboEnabled() tell the same of level and BBO listeners
+template <typename D>
+concept BookDispatch = requires(const D &d) {
+  { d.enabled() } -> std::convertible_to<bool>;
+  { d.levelsEnabled() } -> std::convertible_to<bool>;
+  { d.bboEnabled() } -> std::convertible_to<bool>;
+};
+
+// dispatch to BookListeners, LevelListeners and BBOListeners registered at runtime, via virtual
+// calls
+struct DynamicDispatch {
+  const std::vector<BookListener *> &listeners;
+  const std::vector<LevelListener *> &levelListeners;
+  const std::vector<BBOListener *> &bboListeners;
+
+  bool enabled() const { return !listeners.empty(); }
+  bool levelsEnabled() const { return !levelListeners.empty(); }
+  bool bboEnabled() const { return !bboListeners.empty(); }
+  void onNewOrder(BookID book, const Order *order) const {
+    for (auto *listener : listeners) {
+      listener->onNewOrder(book, order);
+    }
+  }
+  void onDeleteOrder(BookID book, const Order *order, Quantity oldQuantity) const {
+    for (auto *listener : listeners) {
+      listener->onDeleteOrder(book, order, oldQuantity);
+    }
+  }
+  void onReplaceOrder(BookID book, const Order *order, const Order *oldOrder) const {
+    for (auto *listener : listeners) {
+      listener->onReplaceOrder(book, order, oldOrder);
+    }
+  }
+  void onExecOrder(BookID book, const Order *order, Quantity oldQuantity, Quantity fillQuantity,
+                   const ExecInfo &ei) const {
+    for (auto *listener : listeners) {
+      listener->onExecOrder(book, order, oldQuantity, fillQuantity, ei);
+    }
+  }
+  void onUpdateOrder(BookID book, const Order *order, Quantity oldQuantity,
+                     Price oldPrice) const {
+    for (auto *listener : listeners) {
+      listener->onUpdateOrder(book, order, oldQuantity, oldPrice);
+    }
+  }
+  void onLevelChange(BookID book, CID cid, Side side, Price price, Quantity totalShares,
+                     size_t numOrders, bool isNew, bool isRemoved) const {
+    for (auto *listener : levelListeners) {
+      listener->onLevelChange(book, cid, side, price, totalShares, numOrders, isNew, isRemoved);
+    }
+  }
+  void onBBOChange(BookID book, CID cid, const BBO &bbo) const {
+    for (auto *listener : bboListeners) {
+      listener->onBBOChange(book, cid, bbo);
+    }
+  }
+};
+
+// a listener type with the BookListener callbacks
+template <typename L>
+concept OrderListenerType = requires(L &l, const Order *order) { l.onNewOrder(BookID{}, order); };
+
+// a listener type with the LevelListener callback
+template <typename L>
+concept LevelListenerType = requires(L &l, CID cid, Price price, Quantity shares, size_t count) {
+  l.onLevelChange(BookID{}, cid, Side::Bid, price, shares, count, false, false);
+};
+
+// a listener type with the BBOListener callback
+template <typename L>
+concept BBOListenerType = requires(L &l, CID cid, const BBO &bbo) {
+  l.onBBOChange(BookID{}, cid, bbo);
+};
+
+// dispatch to a pack of listeners known at compile time.  Listeners are any types with the
+// BookListener callbacks, the LevelListener callback, the BBOListener callback, or any mix of
+// them.  Calls are direct so they can be inlined, and with no listener of a kind enabled(),
+// levelsEnabled() or bboEnabled() is a constant false
+template <typename... Listeners> struct StaticDispatch {
+  std::tuple<Listeners &...> listeners;
+
+  static constexpr bool enabled() { return (OrderListenerType<Listeners> || ...); }
+  static constexpr bool levelsEnabled() { return (LevelListenerType<Listeners> || ...); }
+  static constexpr bool bboEnabled() { return (BBOListenerType<Listeners> || ...); }
+
+  void onNewOrder(BookID book, const Order *order) const {
+    forOrderListeners([&](auto &l) { l.onNewOrder(book, order); });
+  }
+  void onDeleteOrder(BookID book, const Order *order, Quantity oldQuantity) const {
+    forOrderListeners([&](auto &l) { l.onDeleteOrder(book, order, oldQuantity); });
+  }
+  void onReplaceOrder(BookID book, const Order *order, const Order *oldOrder) const {
+    forOrderListeners([&](auto &l) { l.onReplaceOrder(book, order, oldOrder); });
+  }
+  void onExecOrder(BookID book, const Order *order, Quantity oldQuantity, Quantity fillQuantity,
+                   const ExecInfo &ei) const {
+    forOrderListeners([&](auto &l) { l.onExecOrder(book, order, oldQuantity, fillQuantity, ei); });
+  }
+  void onUpdateOrder(BookID book, const Order *order, Quantity oldQuantity,
+                     Price oldPrice) const {
+    forOrderListeners([&](auto &l) { l.onUpdateOrder(book, order, oldQuantity, oldPrice); });
+  }
+  void onLevelChange(BookID book, CID cid, Side side, Price price, Quantity totalShares,
+                     size_t numOrders, bool isNew, bool isRemoved) const {
+    forLevelListeners([&](auto &l) {
+      l.onLevelChange(book, cid, side, price, totalShares, numOrders, isNew, isRemoved);
+    });
+  }
+  void onBBOChange(BookID book, CID cid, const BBO &bbo) const {
+    forBBOListeners([&](auto &l) { l.onBBOChange(book, cid, bbo); });
+  }
+
+private:
+  // call f on each listener of the kind
+  template <typename F> void forOrderListeners(F &&f) const {
+    std::apply([&](auto &...ls) { (orderCall(ls, f), ...); }, listeners);
+  }
+  template <typename F> void forLevelListeners(F &&f) const {
+    std::apply([&](auto &...ls) { (levelCall(ls, f), ...); }, listeners);
+  }
+  template <typename F> void forBBOListeners(F &&f) const {
+    std::apply([&](auto &...ls) { (bboCall(ls, f), ...); }, listeners);
+  }
+  template <typename L, typename F> static void orderCall(L &l, F &f) {
+    if constexpr (OrderListenerType<L>) {
+      f(l);
+    }
+  }
+  template <typename L, typename F> static void levelCall(L &l, F &f) {
+    if constexpr (LevelListenerType<L>) {
+      f(l);
+    }
+  }
+  template <typename L, typename F> static void bboCall(L &l, F &f) {
+    if constexpr (BBOListenerType<L>) {
+      f(l);
+    }
+  }
+};
+
 // OrderBook class is an aggregate of books of all CIDs.  It has a hashmap from reference numbers
 // to order objects of all CIDs (CID is integer index starting from 0, a CID 1-1 corresponds to a
 // symbol name).  For each CID, it maintains 2 half books, one for bid orders, one for ask orders.
@@ -68,104 +310,237 @@ struct BookListener {
 // the bid side, the highest priced order is at the front. For the ask side, the lowest priced
 // order is at the front.  Each level is a linked list of orders, sorted by the time they are added
 // to the book. Orders are inserted, deleted, or modified (reduced, executed or replaced).
+// Orders and levels are linked by 32-bit indices and pool handles rather than pointers, to keep
+// the records small and let pools move them.  The best bid and ask of each CID are also cached
+// in a BBO record.
+// OrderBook notifies BookListeners, LevelListeners and BBOListeners added at runtime, see
+// StaticOrderBook for listeners bound at compile time.
 
 class OrderBook {
 public:
   struct Level;
-  // instrument order to include linked list iterator
-  struct OrderExt : public Order {
-    using Order::Order;
+  struct Half;
 
-    // a back pointer to the level that has this order
-    Level *level = nullptr;
+  // index of an order in orderPool, or of its slot in orderWindow with WindowBit set
+  using OrderIndex = uint32_t;
+  // handle of a level in levelPool, null if none
+  using LevelIndex = PoolHandle<Level>;
+  static constexpr uint32_t NullIndex = ~uint32_t(0);
 
-    list_member_hook<link_mode<normal_link>> hook;
+  // order prices are kept in units of 0.0001 as unsigned 32 bits, the resolution and range of ITCH
+  // prices
+  using OrderPrice = FPPrice<uint32_t, 4>;
+
+  // the order record kept by the book, only what book maintenance touches, so that it fits in
+  // half a cache line.  It has no cid or side, they are those of its level.  refNum and
+  // timestamps are kept apart, see OrderCold.  Use refNumOf and toOrder to get at them
+  struct OrderExt {
+    OrderExt(Quantity quantity, Price price)
+        : quantity(toOrderQuantity(quantity)), price(toOrderPrice(price)) {}
+
+    uint32_t quantity;
+    OrderPrice price;
 
   private:
     friend class OrderBook;
-  };
 
-  using OrderList =
-      list<OrderExt,
-           member_hook<OrderExt, list_member_hook<link_mode<normal_link>>, &OrderExt::hook>,
-           constant_time_size<true>>;
+    // neighbours in the level, in time priority
+    OrderIndex prev = NullIndex;
+    OrderIndex next = NullIndex;
+    // the level that has this order, null if not linked
+    LevelIndex level;
+    // index of this order, which also locates its OrderCold
+    OrderIndex index = NullIndex;
+  };
 
   OrderBook(BookID id_) : bkid(id_) {};
   OrderBook(const OrderBook &) = delete;
   OrderBook &operator=(const OrderBook &) = delete;
-  ~OrderBook() { clear(false); };
+  ~OrderBook() { clear(StaticDispatch<>{}, false); };
 
   // note maxCid is exclusive.  If maxCid is 10, then the CIDs are 0-9
   void resize(CID maxCid);
 
-  // reserve space for hashmaps to avoid resizing overhead at runtime
+  // reserve space for hashmaps and pools to avoid resizing overhead at runtime
   void reserve(size_t cidSize, size_t orderMapSize, size_t levelMapSize) {
     books.reserve(cidSize);
     orders.reserve(orderMapSize);
-    levels.reserve(levelMapSize);
     orderPool.reserve(orderMapSize);
+    poolCold.resize(orderPool.indexLimit());
     levelPool.reserve(levelMapSize);
   }
 
+  // prepare the halves of cid for about numLevels levels, so that its first levels of the day do
+  // not allocate: the price ladders are allocated unless numLevels is 0.  The overflow maps are
+  // btrees, which grow a node at a time and have nothing to reserve
+  void reserveLevels(CID cid, size_t numLevels) {
+    if (numLevels != 0) {
+      for (Half &half : books[toUnderlying(cid)].halves) {
+        half.reserve();
+      }
+    }
+  }
+
+  // allocate the order and level pools from provider, which must outlive the book.  Must be
+  // called before reserve and on an empty book
+  void setChunkProvider(ChunkProvider &provider) {
+    orderPool.setChunkProvider(provider);
+    levelPool.setChunkProvider(provider);
+  }
+
+  // give back the memory of the order and level pools after a peak: move up to maxMoves orders
+  // and maxMoves levels out of the last chunks of the pools into free slots of the others, and
+  // release the chunks that become empty, see ObjectPool::compact and SlabPool::compact.  Moving
+  // a level counts a move per order of it, whose level is pointed to the new one, and a level of
+  // more orders than maxMoves is moved by a call of its own.  Meant for quiet periods in between
+  // mutations, each call is a bounded pause and the next one carries on.  False once there is
+  // nothing left to compact
+  bool compact(size_t maxMoves);
+
+  // keep orders whose reference numbers fall in a sliding window of given size (rounded up to a
+  // power of 2) in an array indexed by reference number, instead of the orders hashmap.  Orders
+  // outside of the window still go to the hashmap.  0 disables the window.  Note orders in the
+  // window are moved to the hashmap as the window slides past them, so an order pointer is only
+  // valid until the next newOrder or replaceOrder call.  Must be called on an empty book
+  void reserveOrderWindow(size_t windowSize) {
+    assert(orderCount == 0 && orders.empty());
+    orderWindow.reset(windowSize);
+    windowCold.assign(orderWindow.capacity(), OrderCold{});
+    highOutliers.clear();
+  }
+
+  // set the midnight order timestamps are kept relative to, timestamps must not be before it.
+  // Must be called on an empty book
+  void setMidnight(Timestamp tm) {
+    assert(orders.empty() && orderWindow.empty());
+    midnight = tm;
+  }
+
   // add a listener
   void addListener(BookListener *listener) { listeners.push_back(listener); }
   void removeListener(BookListener *listener) { std::erase(listeners, listener); }
 
+  // add a listener of aggregated level changes
+  void addLevelListener(LevelListener *listener) { levelListeners.push_back(listener); }
+  void removeLevelListener(LevelListener *listener) { std::erase(levelListeners, listener); }
+
+  // add a listener of best bid/ask changes
+  void addBBOListener(BBOListener *listener) { bboListeners.push_back(listener); }
+  void removeBBOListener(BBOListener *listener) { std::erase(bboListeners, listener); }
+
   // return the book id
   BookID id() const { return bkid; }
 
   // return the number of active (non-zero quantity) orders in book
   size_t numOrders() const { return orderCount; }
-  size_t numLevels() const { return levels.size(); }
+  size_t numLevels() const { return levelCount; }
 
   // some stats for future hashmap sizing
   size_t maxNumOrders() const { return maxOrderCount; }
   size_t maxNumLevels() const { return maxLevelCount; }
+  // most levels of cid, the peaks of its halves summed, which need not be at the same time
+  size_t maxNumLevels(CID cid) const {
+    return half(cid, Side::Bid).maxSize() + half(cid, Side::Ask).maxSize();
+  }
+  // chunks of the order and level pools by what backs them
+  ChunkCounts orderChunks() const { return orderPool.chunkCounts(); }
+  ChunkCounts levelChunks() const { return levelPool.chunkCounts(); }
 
   // look up an order
   OrderExt *findOrder(ReferenceNum refNum);
   const OrderExt *findOrder(ReferenceNum refNum) const;
 
-  // add order to book, notifies listeners via onNewOrder
+  // level of an order, nullptr if it is not in the book
+  const Level *levelOf(const OrderExt *order) const {
+    return order->level ? levelAt(order->level) : nullptr;
+  }
+  // level of a handle, e.g. of Half::topLevels, which must be of a level in the book
+  const Level *levelOf(LevelIndex index) const { return levelAt(index); }
+
+  // reference number of an order in the book
+  ReferenceNum refNumOf(const OrderExt *order) const { return coldAt(order->index).refNum; }
+
+  // Order view of an order in the book, as listeners see it
+  Order toOrder(const OrderExt *order) const { return toOrder(*order, *levelOf(order)->half); }
+
+  // add order to book, notifies listeners via onNewOrder.  Orders at prices that are not
+  // multiples of 0.0001 or out of the range of OrderPrice, 0 to 429496.7295, or with quantities
+  // out of the uint32_t range are dropped, returning nullptr
   OrderExt *newOrder(ReferenceNum refNum, CID cid, Side side, Quantity quantity, Price price,
-                     Timestamp tm);
+                     Timestamp tm) {
+    return newOrder(dynamicDispatch(), refNum, cid, side, quantity, price, tm);
+  }
 
   // reduce order size in place, notifies listeners via onUpdateOrder
-  void reduceOrderBy(OrderExt *order, Quantity changeQuantity, Timestamp ut);
-  void reduceOrderBy(ReferenceNum refNum, Quantity changeQuantity, Timestamp ut);
+  void reduceOrderBy(OrderExt *order, Quantity changeQuantity, Timestamp ut) {
+    reduceOrderBy(dynamicDispatch(), order, changeQuantity, ut);
+  }
+  void reduceOrderBy(ReferenceNum refNum, Quantity changeQuantity, Timestamp ut) {
+    reduceOrderBy(dynamicDispatch(), refNum, changeQuantity, ut);
+  }
 
-  void reduceOrderTo(OrderExt *order, Quantity newQuantity, Timestamp ut);
-  void reduceOrderTo(ReferenceNum refNum, Quantity newQuantity, Timestamp ut);
+  // a newQuantity an order can not hold, see newOrder, deletes the order
+  void reduceOrderTo(OrderExt *order, Quantity newQuantity, Timestamp ut) {
+    reduceOrderTo(dynamicDispatch(), order, newQuantity, ut);
+  }
+  void reduceOrderTo(ReferenceNum refNum, Quantity newQuantity, Timestamp ut) {
+    reduceOrderTo(dynamicDispatch(), refNum, newQuantity, ut);
+  }
 
   // replace order in book with new one, notifies listeners via onReplaceOrder, the new order
   // must share the same cid and side as the old order. Note this is almost equivalent to a
   // deleteOrder followed by a newOrder, except that listeners will be notified once via
-  // onReplaceOrder, instead of separate onDelteOrder and onNewOrder
+  // onReplaceOrder, instead of separate onDelteOrder and onNewOrder.  If newPrice or newQuantity
+  // is not one an order can hold, see newOrder, the old order is deleted and nullptr returned
   OrderExt *replaceOrder(OrderExt *order, ReferenceNum newRefNum, Quantity newQuantity,
-                         Price newPrice, Timestamp tm);
+                         Price newPrice, Timestamp tm) {
+    return replaceOrder(dynamicDispatch(), order, newRefNum, newQuantity, newPrice, tm);
+  }
   OrderExt *replaceOrder(ReferenceNum oldRefNum, ReferenceNum newRefNum, Quantity newQuantity,
-                         Price newPrice, Timestamp tm);
+                         Price newPrice, Timestamp tm) {
+    return replaceOrder(dynamicDispatch(), oldRefNum, newRefNum, newQuantity, newPrice, tm);
+  }
 
   // delete an order from book, notifies listeners via onDeleteOrder
-  void deleteOrder(OrderExt *order, Timestamp ut);
-  void deleteOrder(ReferenceNum refNum, Timestamp ut);
+  void deleteOrder(OrderExt *order, Timestamp ut) { deleteOrder(dynamicDispatch(), order, ut); }
+  void deleteOrder(ReferenceNum refNum, Timestamp ut) {
+    deleteOrder(dynamicDispatch(), refNum, ut);
+  }
 
   // (partially) fill an order.  If the order is completely filled, it will be
   // deleted, notifies listeners via onExecOrder
-  void executeOrder(OrderExt *order, Quantity quantity, const ExecInfo &ei, Timestamp ut);
-  void executeOrder(ReferenceNum refNum, Quantity quantity, const ExecInfo &ei, Timestamp ut);
+  void executeOrder(OrderExt *order, Quantity quantity, const ExecInfo &ei, Timestamp ut) {
+    executeOrder(dynamicDispatch(), order, quantity, ei, ut);
+  }
+  void executeOrder(ReferenceNum refNum, Quantity quantity, const ExecInfo &ei, Timestamp ut) {
+    executeOrder(dynamicDispatch(), refNum, quantity, ei, ut);
+  }
 
   // clear all orders of a CID, notifies listeners via onDeleteOrder.  Note orders may be deleted
   // in any order.
-  void clearBook(CID cid) { clear(cid, true); }
+  void clearBook(CID cid) { clear(dynamicDispatch(), cid, true); }
+
+  // apply an operation, same as calling its mutator
+  void apply(const BookOp &op) { apply(dynamicDispatch(), op); }
+  // apply operations in order, with the same results and notifications as applying them one by
+  // one.  Orders and levels of operations a few ahead are prefetched, to overlap their cache
+  // misses with the work on the current one
+  void apply(std::span<const BookOp> ops) { apply(dynamicDispatch(), ops); }
+  // apply operations as above, calling applied(op) after each, e.g. to follow numOrders and
+  // numLevels operation by operation
+  template <typename Applied> void apply(std::span<const BookOp> ops, Applied &&applied) {
+    apply(dynamicDispatch(), ops, applied);
+  }
 
-  struct Half;
+  // prefetch the order index slot of refNum, for a lookup or a new order a little later
+  void prefetchIndex(ReferenceNum refNum) const;
+  // look up refNum and prefetch its order and level, best called once the index slot arrived
+  void prefetchOrder(ReferenceNum refNum) const;
 
-  // price level for CID/side/price
-  struct Level : public OrderList {
-    Level(Half *half_, Price price_) : price(price_), totalShares(0), half(half_) {
-      half->insert(price, this);
-    }
+  // price level for CID/side/price, a linked list of orders in time priority
+  struct Level {
+    // the book adds a new level to its half once it has a handle, it takes itself out of it
+    Level(Half *half_, Price price_) : price(price_), totalShares(0), half(half_) {}
 
     Level(const Level &) = delete;
     Level &operator=(const Level &) = delete;
@@ -174,7 +549,48 @@ public:
     Side side() const { return half->side; }
     CID cid() const { return half->cid; }
 
-    size_t numOrders() const { return OrderList::size(); }
+    size_t numOrders() const { return count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    class const_iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = OrderExt;
+      using difference_type = std::ptrdiff_t;
+      using reference = const OrderExt &;
+      using pointer = const OrderExt *;
+
+      const_iterator() = default;
+
+      reference operator*() const { return *book->orderAt(index); }
+      pointer operator->() const { return book->orderAt(index); }
+
+      const_iterator &operator++() {
+        index = book->orderAt(index)->next;
+        return *this;
+      }
+      const_iterator operator++(int) {
+        auto tmp = *this;
+        ++*this;
+        return tmp;
+      }
+
+      bool operator==(const const_iterator &other) const { return index == other.index; }
+
+    private:
+      friend struct Level;
+      const_iterator(const OrderBook *book, OrderIndex index) : book(book), index(index) {}
+
+      const OrderBook *book = nullptr;
+      OrderIndex index = NullIndex;
+    };
+    using iterator = const_iterator;
+
+    const_iterator begin() const { return {half->book, head}; }
+    const_iterator end() const { return {half->book, NullIndex}; }
+    const OrderExt &front() const { return *half->book->orderAt(head); }
+    const OrderExt &back() const { return *half->book->orderAt(tail); }
 
     Price price;
     Quantity totalShares;
@@ -183,6 +599,19 @@ public:
 
   private:
     friend class OrderBook;
+    friend class ObjectPool<Level>;
+
+    // for compaction of levelPool, the moved from level is left out of its half
+    Level(Level &&other) noexcept
+        : price(other.price), totalShares(other.totalShares),
+          half(std::exchange(other.half, nullptr)), head(other.head), tail(other.tail),
+          count(other.count), index(other.index) {}
+
+    OrderIndex head = NullIndex;
+    OrderIndex tail = NullIndex;
+    uint32_t count = 0;
+    // handle of this level in levelPool
+    LevelIndex index;
   };
 
   struct LevelCompare {
@@ -194,33 +623,245 @@ public:
     }
   };
 
-  using LevelMap = tlx::btree_map<Price, Level *, LevelCompare>;
-  using LevelKey = std::tuple<CID, Side, Price>;
+  using LevelMap = tlx::btree_map<Price, LevelIndex, LevelCompare>;
 
   // get the best level for cid/side, nullptr if empty
   const Level *topLevel(CID cid, Side side) const;
 
+  // best bid and ask of cid
+  const BBO &bbo(CID cid) const {
+    assert(toUnderlying(cid) >= 0 && std::cmp_less(toUnderlying(cid), books.size()));
+    return books[toUnderlying(cid)].bbo;
+  }
+
   // get n-th best level for cid/side, nullptr if not enough levels, n==0 returns the best level
   const Level *nthLevel(CID cid, Side side, size_t n) const;
 
   // get a level for cid/side at the given price, nullptr if no such level atm
   const Level *getLevel(CID cid, Side side, Price price) const;
 
-  // one side of the book of a CID
-  struct Half : public LevelMap {
-    Half(CID cid, Side side) : LevelMap(LevelCompare(side)), cid(cid), side(side) {}
+  // one side of the book of a CID.  Levels whose prices are on the tick grid and within a window
+  // of LadderSize ticks that follows the best price are kept in a PriceLadder, which finds the
+  // next level with a couple of bit scans.  The rest, i.e. far away or sub-tick prices, go to an overflow
+  // LevelMap.  Iteration merges the two in price priority order, dereferencing an iterator gives
+  // a (price, level) pair by value.  The best TopSize levels are also kept in an array.  All
+  // three hold levels by their levelPool handles
+  struct Half {
+    // ladder size in ticks.  The ladder is kept around the best price, or slid worse to the
+    // levels of a touch that moved away from a stale best level
+    static constexpr size_t LadderSize = 512;
+    using Ladder = PriceLadder<LevelIndex, LadderSize>;
+    // number of best levels kept in the top levels array
+    static constexpr size_t TopSize = BOOKPROJ_TOP_LEVELS;
+    static_assert(TopSize > 0);
+
+    Half(const OrderBook *book, CID cid, Side side)
+        : book(book), cid(cid), side(side), overflow(LevelCompare(side)) {}
     Half(const Half &) = delete;
     Half(Half &&) = default;
     Half &operator=(const Half &) = delete;
     Half &operator=(Half &&) = default;
 
+    const OrderBook *book;
     CID cid;
     Side side;
 
-    LevelMap::iterator insert(Price price, Level *level) {
-      auto [iter, inserted] = LevelMap::insert2(price, level);
-      return iter;
+    struct LevelRef {
+      Price first;
+      Level *second;
+    };
+
+    class const_iterator {
+    public:
+      using iterator_concept = std::bidirectional_iterator_tag;
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = LevelRef;
+      using difference_type = std::ptrdiff_t;
+      using reference = LevelRef;
+      struct pointer {
+        LevelRef ref;
+        const LevelRef *operator->() const { return &ref; }
+      };
+
+      const_iterator() = default;
+
+      LevelRef operator*() const {
+        if (inLadder()) {
+          Level *level = half->levelAt(half->ladder.get(key));
+          return {level->price, level};
+        }
+        return {oit->first, half->levelAt(oit->second)};
+      }
+      pointer operator->() const { return {**this}; }
+
+      const_iterator &operator++() {
+        if (inLadder()) {
+          key = half->ladder.next(key + 1);
+        } else {
+          ++oit;
+        }
+        return *this;
+      }
+      const_iterator operator++(int) {
+        auto tmp = *this;
+        ++*this;
+        return tmp;
+      }
+
+      // step back to the worse of the two previous levels
+      const_iterator &operator--() {
+        int64_t prevKey = half->ladder.prev(key);
+        if (prevKey < half->ladder.low()) {
+          --oit;
+        } else if (oit == half->overflow.begin() ||
+                   half->overflow.key_comp()(std::prev(oit)->first,
+                                             half->levelAt(half->ladder.get(prevKey))->price)) {
+          key = prevKey;
+        } else {
+          --oit;
+        }
+        return *this;
+      }
+      const_iterator operator--(int) {
+        auto tmp = *this;
+        --*this;
+        return tmp;
+      }
+
+      bool operator==(const const_iterator &other) const {
+        return key == other.key && oit == other.oit;
+      }
+
+    private:
+      friend struct Half;
+      const_iterator(const Half *half, int64_t key, LevelMap::const_iterator oit)
+          : half(half), key(key), oit(oit) {}
+
+      // true if the current level comes from the ladder, i.e. it is better than the current
+      // overflow level
+      bool inLadder() const {
+        return key != half->ladder.high() &&
+               (oit == half->overflow.end() ||
+                half->overflow.key_comp()(half->levelAt(half->ladder.get(key))->price,
+                                          oit->first));
+      }
+
+      const Half *half = nullptr;
+      // ladder key of the next ladder level, ladder.high() if none
+      int64_t key = 0;
+      // the next overflow level
+      LevelMap::const_iterator oit;
+    };
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    const_iterator begin() const {
+      return {this, ladder.next(ladder.low()), overflow.begin()};
+    }
+    const_iterator end() const { return {this, ladder.high(), overflow.end()}; }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    size_t size() const { return ladder.size() + overflow.size(); }
+    bool empty() const { return size() == 0; }
+
+    // number of levels kept in the overflow map, for stats and testing
+    size_t overflowSize() const { return overflow.size(); }
+    // most levels the half had at once, for sizing the books of the next day
+    size_t maxSize() const { return maxLevels; }
+
+    // the best level, nullptr if empty
+    Level *top() const { return numTops != 0 ? levelAt(tops[0]) : nullptr; }
+    // the best levels in price priority, min(size(), TopSize) of them by handle.  See
+    // OrderBook::levelOf
+    std::span<const LevelIndex> topLevels() const { return {tops, numTops}; }
+    // prices, total shares and order counts of the top levels, in parallel arrays so that depth
+    // snapshots copy them without dereferencing the levels
+    std::span<const Price> topPrices() const { return {depth.prices, numTops}; }
+    std::span<const Quantity> topShares() const { return {depth.shares, numTops}; }
+    std::span<const uint32_t> topNumOrders() const { return {depth.numOrders, numTops}; }
+    // number of best levels kept in price priority, min(size(), TopSize)
+    size_t numTopLevels() const { return numTops; }
+    // the n-th best level, n must be less than numTopLevels()
+    Level *topLevel(size_t n) const {
+      assert(n < numTops);
+      return levelAt(tops[n]);
     }
+
+    // the first level worse than price
+    const_iterator upper_bound(Price price) const {
+      const int64_t key = std::clamp(floorKey(price) + 1, ladder.low(), ladder.high());
+      return {this, ladder.next(key), overflow.upper_bound(price)};
+    }
+
+    // find the level at price, nullptr if none
+    Level *find(Price price) const {
+      if (int64_t key; toKey(price, key) && ladder.inWindow(key)) {
+        const LevelIndex index = ladder.get(key);
+        return index ? levelAt(index) : nullptr;
+      }
+      auto iter = overflow.find(price);
+      return iter == overflow.end() ? nullptr : levelAt(iter->second);
+    }
+
+    // prefetch the ladder slot of price
+    void prefetch(Price price) const {
+      if (int64_t key; toKey(price, key) && ladder.inWindow(key)) {
+        ladder.prefetch(key);
+      }
+    }
+
+    // allocate the ladder ahead of the first level
+    void reserve() { ladder.reserve(); }
+    // add a level, there must be no level at price yet
+    void insert(Price price, Level *level);
+    // remove the level at price, which must exist
+    void erase(Price price);
+    // the level at price moved to level
+    void relocate(Price price, Level *level);
+    // the total shares or order count of level changed
+    void updateTop(const Level &level);
+
+  private:
+    Level *levelAt(LevelIndex index) const { return book->levelAt(index); }
+
+    // ladder keys are tick numbers increasing with worse prices, i.e. negated for bids.  Returns
+    // false if price is not a multiple of the tick
+    bool toKey(Price price, int64_t &key) const {
+      auto raw = Price::toRaw(price);
+      if (raw % tickRaw != 0) {
+        return false;
+      }
+      key = side == Side::Bid ? -(raw / tickRaw) : raw / tickRaw;
+      return true;
+    }
+    // key of price if it is on the tick, else of the tick just better than it
+    int64_t floorKey(Price price) const {
+      const int64_t raw = Price::toRaw(price);
+      const int64_t keyRaw = side == Side::Bid ? -raw : raw;
+      return keyRaw / tickRaw - (keyRaw % tickRaw < 0);
+    }
+
+    // move the ladder window to start at newLow, levels falling off it go to overflow, levels in
+    // overflow that now fit in go to the ladder
+    void moveLadder(int64_t newLow);
+
+    // price tick of the ladder, a cent, or a hundredth of a cent for sub-dollar prices.  It is
+    // chosen by the first price put in an empty ladder
+    int64_t tickRaw = Price::toRaw(Price(0.01));
+    Ladder ladder;
+    LevelMap overflow;
+    // the best levels in price priority, kept by insert and erase, and their depth, also kept by
+    // updateTop
+    LevelIndex tops[TopSize];
+    struct {
+      Price prices[TopSize];
+      Quantity shares[TopSize];
+      uint32_t numOrders[TopSize];
+    } depth;
+    size_t numTops = 0;
+    size_t maxLevels = 0;
   };
 
   // get a half book, useful for walking its levels
@@ -230,11 +871,7 @@ public:
   }
 
   // clear the entire book, in the order of CID value, delete all orders
-  void clear(bool callListeners) {
-    for (size_t ii = 0; ii < books.size(); ++ii) {
-      clear(static_cast<CID>(ii), callListeners);
-    }
-  }
+  void clear(bool callListeners) { clear(dynamicDispatch(), callListeners); }
 
   // return true if the book is in a consistent state: orders are in right price levels, quantities
   // are positive, levels have correct total quantities, are non-empty and ordered accordingly to
@@ -243,135 +880,740 @@ public:
   bool validate(CID cid) const;
   bool validate() const;
 
+  // a checkpoint of the book is its orders and stats, laid out to be read in place from a mapped
+  // file: the header, a CheckpointLevel for each level, by CID, bids before asks and in price
+  // priority, then a CheckpointOrder for each order, by level and in time priority.  Records are
+  // in host byte order, sizes are multiples of 8
+  struct CheckpointHeader {
+    char magic[8];
+    // book midnight, as nanoseconds since epoch
+    int64_t midnight;
+    uint64_t numCids;
+    uint64_t numLevels;
+    uint64_t numOrders;
+    uint64_t maxNumOrders;
+    uint64_t maxNumLevels;
+  };
+  struct CheckpointLevel {
+    int64_t price;
+    int32_t cid;
+    Side side;
+    uint32_t numOrders;
+  };
+  struct CheckpointOrder {
+    uint64_t refNum;
+    uint64_t quantity;
+    // nanoseconds since midnight, 0 if built without order timestamps
+    uint64_t createTime;
+    uint64_t updateTime;
+  };
+
+  // write a checkpoint of the book to out, return its size
+  size_t writeCheckpoint(std::ostream &out) const;
+  // restore the book from the checkpoint at the start of data, return its size.  Levels are
+  // created once each and orders appended to them in turn, with the order window placed over the
+  // newest reference numbers up front so that no order moves while restoring.  Listeners are not
+  // notified.  Must be called on an empty book, throw std::runtime_error if data does not start
+  // with a checkpoint
+  size_t restoreCheckpoint(std::span<const std::byte> data);
+
+protected:
+  // the mutators, notifying listeners through dispatch
+  template <BookDispatch Dispatch>
+  OrderExt *newOrder(const Dispatch &dispatch, ReferenceNum refNum, CID cid, Side side,
+                     Quantity quantity, Price price, Timestamp tm);
+  template <BookDispatch Dispatch>
+  void reduceOrderBy(const Dispatch &dispatch, OrderExt *order, Quantity changeQuantity,
+                     Timestamp ut);
+  template <BookDispatch Dispatch>
+  void reduceOrderBy(const Dispatch &dispatch, ReferenceNum refNum, Quantity changeQuantity,
+                     Timestamp ut);
+  template <BookDispatch Dispatch>
+  void reduceOrderTo(const Dispatch &dispatch, OrderExt *order, Quantity newQuantity,
+                     Timestamp ut);
+  template <BookDispatch Dispatch>
+  void reduceOrderTo(const Dispatch &dispatch, ReferenceNum refNum, Quantity newQuantity,
+                     Timestamp ut);
+  template <BookDispatch Dispatch>
+  OrderExt *replaceOrder(const Dispatch &dispatch, OrderExt *order, ReferenceNum newRefNum,
+                         Quantity newQuantity, Price newPrice, Timestamp tm);
+  template <BookDispatch Dispatch>
+  OrderExt *replaceOrder(const Dispatch &dispatch, ReferenceNum oldRefNum, ReferenceNum newRefNum,
+                         Quantity newQuantity, Price newPrice, Timestamp tm);
+  template <BookDispatch Dispatch>
+  void deleteOrder(const Dispatch &dispatch, OrderExt *order, Timestamp ut);
+  template <BookDispatch Dispatch>
+  void deleteOrder(const Dispatch &dispatch, ReferenceNum refNum, Timestamp ut);
+  template <BookDispatch Dispatch>
+  void executeOrder(const Dispatch &dispatch, OrderExt *order, Quantity quantity,
+                    const ExecInfo &ei, Timestamp ut);
+  template <BookDispatch Dispatch>
+  void executeOrder(const Dispatch &dispatch, ReferenceNum refNum, Quantity quantity,
+                    const ExecInfo &ei, Timestamp ut);
+
+  template <BookDispatch Dispatch> void apply(const Dispatch &dispatch, const BookOp &op);
+  template <BookDispatch Dispatch>
+  void apply(const Dispatch &dispatch, std::span<const BookOp> ops) {
+    apply(dispatch, ops, [](const BookOp &) {});
+  }
+  template <BookDispatch Dispatch, typename Applied>
+  void apply(const Dispatch &dispatch, std::span<const BookOp> ops, Applied &&applied);
+
+  // clear the entire book, or the book for one CID, delete its orders
+  template <BookDispatch Dispatch> void clear(const Dispatch &dispatch, bool callListeners);
+  template <BookDispatch Dispatch>
+  void clear(const Dispatch &dispatch, CID cid, bool callListeners);
+
 private:
+  DynamicDispatch dynamicDispatch() const { return {listeners, levelListeners, bboListeners}; }
+
+  static constexpr OrderIndex WindowBit = OrderIndex(1) << 31;
+  // handle of an order in orderPool, whose index is the OrderIndex of the order
+  using OrderHandle = PoolHandle<OrderExt>;
+  static constexpr int64_t PriceUnit = int64_t(Price::Scale / OrderPrice::Scale);
+
+  // whether an order can hold price, i.e. it is a multiple of 0.0001 within the uint32_t range
+  static bool isOrderPrice(Price price) {
+    const int64_t raw = Price::toRaw(price);
+    return raw % PriceUnit == 0 && std::in_range<uint32_t>(raw / PriceUnit);
+  }
+  // whether an order can hold quantity, i.e. it is within the uint32_t range
+  static bool isOrderQuantity(Quantity quantity) { return std::in_range<uint32_t>(quantity); }
+  static OrderPrice toOrderPrice(Price price) {
+    assert(isOrderPrice(price));
+    return OrderPrice::fromRaw(uint32_t(Price::toRaw(price) / PriceUnit));
+  }
+  static uint32_t toOrderQuantity(Quantity quantity) {
+    assert(isOrderQuantity(quantity));
+    return uint32_t(quantity);
+  }
+  static Price toPrice(OrderPrice price) {
+    return Price::fromRaw(int64_t(OrderPrice::toRaw(price)) * PriceUnit);
+  }
+
+  // orderPool hands out indices in chunks of this many, a power of 2 so that the indices are dense
+  // and poolCold has no holes.  Chunks of 24 byte orders are then 6MB, 3 whole 2MB huge pages
+  static constexpr size_t OrderBatchSize = size_t(1) << 18;
+  // with BOOKPROJ_ORDER_SLABS, orderPool allocates orders in slabs of this many and a level
+  // appends orders to the slab of its tail, so that walking a level out of cache touches a few
+  // lines per slab, 8 orders are 3 lines.  The replay pays for it, new orders no longer reuse the
+  // slot last freed, which is likely cached
+  static constexpr size_t OrderSlabSize = 8;
+  // levels with this many orders go on in slabs of their own once the slab of their tail is
+  // full, shallower ones share slabs
+  static constexpr uint32_t OwnSlabOrders = OrderSlabSize / 2;
+#if BOOKPROJ_ORDER_SLABS
+  using OrderPool = SlabPool<OrderExt, OrderSlabSize>;
+  static constexpr size_t OrderPoolBatch = OrderBatchSize / OrderSlabSize;
+#else
+  using OrderPool = ObjectPool<OrderExt>;
+  static constexpr size_t OrderPoolBatch = OrderBatchSize;
+#endif
+  static_assert(OrderBatchSize * sizeof(OrderExt) % (size_t(2) << 20) == 0,
+                "order chunks do not fill whole 2MB pages");
+
+  // fields of an order that only listeners read, kept in arrays parallel to orderWindow and
+  // orderPool, indexed the same as the order
+  struct OrderCold {
+    ReferenceNum refNum;
+#if BOOKPROJ_ORDER_TIMESTAMPS
+    // nanoseconds since midnight
+    uint64_t createTime;
+    uint64_t updateTime;
+#endif
+  };
+
+  uint64_t sinceMidnight(Timestamp tm) const {
+    auto ns = (tm - midnight).count();
+    assert(ns >= 0);
+    return uint64_t(ns);
+  }
+  Timestamp fromMidnight(uint64_t ns) const { return midnight + std::chrono::nanoseconds(ns); }
+
+  OrderExt *orderAt(OrderIndex index) const {
+    return (index & WindowBit) ? orderWindow.at(index & ~WindowBit)
+                               : orderPool[OrderHandle(index)];
+  }
+  OrderCold &coldAt(OrderIndex index) {
+    return (index & WindowBit) ? windowCold[index & ~WindowBit] : poolCold[index];
+  }
+  const OrderCold &coldAt(OrderIndex index) const {
+    return (index & WindowBit) ? windowCold[index & ~WindowBit] : poolCold[index];
+  }
+  Level *levelAt(LevelIndex index) const { return levelPool[index]; }
+
+  // set refNum and create/update times of a new order
+  void initCold(OrderIndex index, ReferenceNum refNum, Timestamp tm);
+  void setUpdateTime(OrderIndex index, Timestamp tm);
+
+  // Order view of order, which is or was in half
+  Order toOrder(const OrderExt &order, const Half &half) const {
+    return toOrder(order, coldAt(order.index), half);
+  }
+  Order toOrder(const OrderExt &order, const OrderCold &cold, const Half &half) const;
+
+  // levels a mutation touches, with their state before it.  A level may be changed more than
+  // once by a mutation, e.g. a replace at the same price, level listeners get a single event
+  struct LevelChanges {
+    struct Before {
+      const Half *half;
+      Price price;
+      Quantity totalShares;
+      size_t numOrders;
+    };
+    // a replace touches the old and new levels, and the level of an order it displaces
+    Before levels[3];
+    size_t size = 0;
+  };
+
+  // record the state of a level, before the mutation changes it for the first time
+  template <BookDispatch Dispatch>
+  void touchLevel(const Dispatch &dispatch, LevelChanges &changes, const Level &level) const;
+  template <BookDispatch Dispatch>
+  void touchLevel(const Dispatch &dispatch, LevelChanges &changes, const Half &half,
+                  Price price) const;
+  // notify level listeners of the levels that did change
+  template <BookDispatch Dispatch>
+  void notifyLevels(const Dispatch &dispatch, const LevelChanges &changes) const;
+
   // create an order object, add to orderMap, if order with same refNum exists, call deleteOrder
   // on it, which will notify listeners via onDeleteOrder
-  OrderExt *createOrder(ReferenceNum refNum, CID cid, Side side, Quantity quantity, Price price,
-                        Timestamp tm);
+  template <BookDispatch Dispatch>
+  OrderExt *createOrder(const Dispatch &dispatch, LevelChanges &changes, ReferenceNum refNum,
+                        const Half &half, Quantity quantity, Price price, Timestamp tm);
+  // construct an order in orderPool, next to order near of level if that one is pooled and
+  // orders are in slabs, growing poolCold along with it
+  template <typename... Args>
+  OrderExt *createPoolOrder(const Level *level, OrderIndex near, Args &&...args);
   // remove order from orderMap and delete the object
   void destroyOrder(OrderExt *order);
-
-  // insert order into its level, create level if none exists, donot call listeners
-  void linkOrder(OrderExt *order);
+  // an order with the same refNum exists, delete it and reuse it for the new one
+  template <BookDispatch Dispatch>
+  void recreateOrder(const Dispatch &dispatch, LevelChanges &changes, OrderExt *order,
+                     Quantity quantity, Price price);
+
+  // how far apply prefetches ahead the orders, levels, halves and tops of operations.  Each is
+  // found through the one before, so it is prefetched once that one had time to arrive
+  static constexpr size_t OrderPrefetchDistance = 8;
+  static constexpr size_t LevelPrefetchDistance = 4;
+  static constexpr size_t HalfPrefetchDistance = 2;
+  static constexpr size_t TopPrefetchDistance = 1;
+  // prefetch the index slots op looks up first, and the half of a new order
+  void prefetchOpIndex(const BookOp &op) const;
+  // prefetch the level op changes, and the neighbouring orders of an order it unlinks
+  void prefetchOpLevel(const BookOp &op) const;
+  // prefetch the half of the order op changes
+  void prefetchOpHalf(const BookOp &op) const;
+  // prefetch the ladder slot of the level op removes, and the top level and BBO it refreshes
+  void prefetchOpTop(const BookOp &op) const;
+  void prefetchLines(const Half &half) const;
+
+  // slide orderWindow forward if refNum is a little above it, or rebase it if it is empty
+  void slideOrderWindow(uint64_t refNum);
+  // moved is a copy of a linked order at a new index, point its neighbours and level to it
+  void relinkOrder(const OrderExt &moved);
+
+  // append order to its level in half, create level if none exists, donot call listeners
+  void linkOrder(OrderExt *order, Half &half, Price price);
   // remove order from its level level, delete level if empty, donot call listeners, donot
   // delete order
   void unlinkOrder(OrderExt *order);
 
-  Level *findOrCreateLevel(CID cid, Side side, Price price);
+  Level *findOrCreateLevel(Half &half, Price price);
   void destroyLevel(Level *level);
 
-  // clear book for one CID, delete its orders
-  void clear(CID cid, bool callListeners);
-
   // get an string for logging and order
   static std::string getLevelString(const Level &level);
   static std::string getHalfString(const Half &half);
 
   struct PerCIDBook {
-    PerCIDBook(CID cid) : halves{Half{cid, Side::Bid}, Half{cid, Side::Ask}} {}
+    PerCIDBook(const OrderBook *book, CID cid)
+        : halves{Half{book, cid, Side::Bid}, Half{book, cid, Side::Ask}} {}
     Half halves[2];
+    // tops of halves as of the end of the last mutation
+    BBO bbo;
   };
 
+  // copy the top of half to the BBO of its CID, return true if it changed
+  bool refreshBBO(const Half &half);
+  template <BookDispatch Dispatch> void notifyBBO(const Dispatch &dispatch, CID cid) const;
+
   const BookID bkid;
 
+  // order timestamps are nanoseconds since midnight
+  Timestamp midnight = {};
+
   // indexed by cid
   std::vector<PerCIDBook> books;
   std::vector<BookListener *> listeners;
+  std::vector<LevelListener *> levelListeners;
+  std::vector<BBOListener *> bboListeners;
 
   // Orders linked in price levels, this is the actual active number of orders in a book.
   // It doesnot include orders that are unlinked but not yet erased from orders map yet, because
   // we need to keep the unlinked order object alive for callback to listeners
   size_t orderCount = 0;
 
+  // number of levels in all halves
+  size_t levelCount = 0;
+
   // maximum number of orders in the book, for stats
   size_t maxOrderCount = 0;
   size_t maxLevelCount = 0;
 
-  // map of order objects
-  emhash7::HashMap<ReferenceNum, OrderExt *, ankerl::unordered_dense::hash<ReferenceNum>> orders;
+  // map of orders not in orderWindow to their orderPool indices
+  emhash7::HashMap<ReferenceNum, OrderIndex, ankerl::unordered_dense::hash<ReferenceNum>> orders;
+
+  // orders with reference numbers in the window are stored here instead of orders and orderPool
+  SlidingWindow<OrderExt> orderWindow;
+  // cold fields of orders in orderWindow and orderPool
+  std::vector<OrderCold> windowCold;
+  std::vector<OrderCold> poolCold;
 
-  // map of level objects
-  emhash7::HashMap<LevelKey, Level *, ankerl::unordered_dense::hash<LevelKey>> levels;
+  // sorted reference numbers of orders which were above orderWindow when created, they go to
+  // orders and are moved into the window once it slides over them.  So all orders with reference
+  // numbers in the window are always in it, and a window miss never needs to probe orders
+  std::vector<uint64_t> highOutliers;
+  // beyond this many high outliers, the window is moved to catch up with them
+  static constexpr size_t MaxHighOutliers = 1024;
 
-  ObjectPool<OrderExt> orderPool;
+  OrderPool orderPool{OrderPoolBatch};
   ObjectPool<Level> levelPool;
 }; // namespace bookproj
 
-inline OrderBook::Level::~Level() { half->erase(price); }
+inline OrderBook::Level::~Level() {
+  if (half != nullptr) {
+    half->erase(price);
+  }
+}
+
+inline void OrderBook::Half::insert(Price price, Level *level) {
+  maxLevels = std::max(maxLevels, size() + 1);
+  // numTops is less than TopSize only if all levels are in tops
+  const auto better = overflow.key_comp();
+  if (numTops < TopSize || better(price, depth.prices[TopSize - 1])) {
+    size_t ii = std::min(numTops, TopSize - 1);
+    for (; ii > 0 && better(price, depth.prices[ii - 1]); --ii) {
+      tops[ii] = tops[ii - 1];
+      depth.prices[ii] = depth.prices[ii - 1];
+      depth.shares[ii] = depth.shares[ii - 1];
+      depth.numOrders[ii] = depth.numOrders[ii - 1];
+    }
+    tops[ii] = level->index;
+    depth.prices[ii] = price;
+    depth.shares[ii] = level->totalShares;
+    depth.numOrders[ii] = uint32_t(level->numOrders());
+    numTops = std::min(numTops + 1, TopSize);
+  }
+  if (ladder.empty()) [[unlikely]] {
+    // pick the tick for the new ladder and center it on price.  Move it even if price is off the
+    // tick, the window must not cover overflow levels on the new tick
+    tickRaw = Price::toRaw(price < Price(1.0) ? Price(0.0001) : Price(0.01));
+    moveLadder(floorKey(price) - int64_t(LadderSize / 2));
+  }
+  if (int64_t key; toKey(price, key)) [[likely]] {
+    if (ladder.inWindow(key)) [[likely]] {
+      ladder.set(key, level->index);
+      return;
+    }
+    if (key < ladder.low()) {
+      // a better price than anything in the ladder, recenter on it
+      moveLadder(key - int64_t(LadderSize / 2));
+      ladder.set(key, level->index);
+      return;
+    }
+    // worse than the ladder, e.g. the touch moving away from a stale top.  Slide the ladder to
+    // cover both the top and price if it can, else move it to price once the ladder holds fewer
+    // levels than overflow
+    const int64_t topKey = floorKey(depth.prices[0]);
+    if (key - topKey < int64_t(LadderSize) || ladder.size() < overflow.size()) {
+      moveLadder(key - topKey < int64_t(LadderSize)
+                     ? std::min(topKey, key - int64_t(LadderSize / 2))
+                     : key - int64_t(LadderSize / 2));
+      ladder.set(key, level->index);
+      return;
+    }
+  }
+  overflow.insert2(price, level->index);
+}
+
+inline void OrderBook::Half::erase(Price price) {
+  if (int64_t key; toKey(price, key) && ladder.inWindow(key)) [[likely]] {
+    ladder.reset(key);
+  } else {
+    overflow.erase(price);
+  }
+  if (overflow.key_comp()(depth.prices[numTops - 1], price)) [[likely]] {
+    // below the top levels
+    return;
+  }
+  size_t ii = 0;
+  while (depth.prices[ii] != price) {
+    ++ii;
+  }
+  std::copy(tops + ii + 1, tops + numTops, tops + ii);
+  std::copy(depth.prices + ii + 1, depth.prices + numTops, depth.prices + ii);
+  std::copy(depth.shares + ii + 1, depth.shares + numTops, depth.shares + ii);
+  std::copy(depth.numOrders + ii + 1, depth.numOrders + numTops, depth.numOrders + ii);
+  --numTops;
+  if (size() > numTops) {
+    // pull up the next level
+    const auto [nextPrice, next] =
+        *(numTops == 0 ? begin() : upper_bound(depth.prices[numTops - 1]));
+    tops[numTops] = next->index;
+    depth.prices[numTops] = nextPrice;
+    depth.shares[numTops] = next->totalShares;
+    depth.numOrders[numTops] = uint32_t(next->numOrders());
+    ++numTops;
+  }
+  if (ii == 0 && numTops != 0) {
+    // the top got worse, recenter once it leaves the central part of the ladder
+    const int64_t topKey = floorKey(depth.prices[0]);
+    if (topKey >= ladder.low() + int64_t(LadderSize * 3 / 4)) {
+      moveLadder(topKey - int64_t(LadderSize / 2));
+    }
+  }
+}
+
+inline void OrderBook::Half::relocate(Price price, Level *level) {
+  if (int64_t key; toKey(price, key) && ladder.inWindow(key)) {
+    ladder.reset(key);
+    ladder.set(key, level->index);
+  } else {
+    overflow.find(price)->second = level->index;
+  }
+  for (size_t ii = 0; ii < numTops; ++ii) {
+    if (depth.prices[ii] == price) {
+      tops[ii] = level->index;
+      break;
+    }
+  }
+}
+
+inline void OrderBook::Half::updateTop(const Level &level) {
+  if (numTops == 0 || overflow.key_comp()(depth.prices[numTops - 1], level.price)) [[likely]] {
+    return;
+  }
+  for (size_t ii = 0; ii < numTops; ++ii) {
+    if (depth.prices[ii] == level.price) {
+      depth.shares[ii] = level.totalShares;
+      depth.numOrders[ii] = uint32_t(level.numOrders());
+      return;
+    }
+  }
+}
+
+inline void OrderBook::Half::moveLadder(int64_t newLow) {
+  ladder.moveTo(newLow, [&](int64_t, LevelIndex index) {
+    overflow.insert2(levelAt(index)->price, index);
+  });
+  if (overflow.empty()) {
+    return;
+  }
+  // overflow is ordered the same way as ladder keys, walk the part covered by the new window
+  Price first = Price::fromRaw((side == Side::Bid ? -newLow : newLow) * tickRaw);
+  Price moved[LadderSize];
+  size_t numMoved = 0;
+  for (auto iter = overflow.lower_bound(first); iter != overflow.end(); ++iter) {
+    int64_t key;
+    if (!toKey(iter->first, key)) {
+      continue;
+    }
+    if (!ladder.inWindow(key)) {
+      break;
+    }
+    ladder.set(key, iter->second);
+    moved[numMoved++] = iter->first;
+  }
+  for (size_t ii = 0; ii < numMoved; ++ii) {
+    overflow.erase(moved[ii]);
+  }
+}
 
 inline OrderBook::OrderExt *OrderBook::findOrder(ReferenceNum refNum) {
-  auto it = orders.find(refNum);
-  return it == orders.end() ? nullptr : it->second;
+  return const_cast<OrderExt *>(std::as_const(*this).findOrder(refNum));
 }
 
 inline const OrderBook::OrderExt *OrderBook::findOrder(ReferenceNum refNum) const {
+  if (orderWindow.inRange(toUnderlying(refNum))) [[likely]] {
+    return orderWindow.find(toUnderlying(refNum));
+  }
   auto it = orders.find(refNum);
-  return it == orders.end() ? nullptr : it->second;
+  return it == orders.end() ? nullptr : orderPool[OrderHandle(it->second)];
+}
+
+inline void OrderBook::initCold(OrderIndex index, ReferenceNum refNum,
+                                [[maybe_unused]] Timestamp tm) {
+  OrderCold &cold = coldAt(index);
+  cold.refNum = refNum;
+#if BOOKPROJ_ORDER_TIMESTAMPS
+  cold.createTime = cold.updateTime = sinceMidnight(tm);
+#endif
 }
 
-inline void OrderBook::linkOrder(OrderExt *order) {
-  Level *level = findOrCreateLevel(order->cid, order->side, order->price);
-  level->push_back(*order);
+inline void OrderBook::setUpdateTime([[maybe_unused]] OrderIndex index,
+                                     [[maybe_unused]] Timestamp tm) {
+#if BOOKPROJ_ORDER_TIMESTAMPS
+  coldAt(index).updateTime = sinceMidnight(tm);
+#endif
+}
+
+inline Order OrderBook::toOrder(const OrderExt &order, const OrderCold &cold,
+                                const Half &half) const {
+  Order view(cold.refNum, half.cid, half.side, order.quantity, toPrice(order.price), Timestamp{});
+#if BOOKPROJ_ORDER_TIMESTAMPS
+  view.createTime = fromMidnight(cold.createTime);
+  view.updateTime = fromMidnight(cold.updateTime);
+#endif
+  return view;
+}
+
+inline void OrderBook::linkOrder(OrderExt *order, Half &half, Price price) {
+  Level *level = findOrCreateLevel(half, price);
+  order->level = level->index;
+  order->prev = level->tail;
+  order->next = NullIndex;
+  if (level->tail != NullIndex) {
+    orderAt(level->tail)->next = order->index;
+  } else {
+    level->head = order->index;
+  }
+  level->tail = order->index;
+  ++level->count;
   level->totalShares += order->quantity;
-  order->level = level;
+  level->half->updateTop(*level);
   if (++orderCount > maxOrderCount) {
     maxOrderCount = orderCount;
   }
 }
 
 inline void OrderBook::unlinkOrder(OrderExt *order) {
-  Level *level = order->level;
-  level->erase(OrderList::s_iterator_to(*order));
+  Level *level = levelAt(order->level);
+  if (order->prev != NullIndex) {
+    orderAt(order->prev)->next = order->next;
+  } else {
+    level->head = order->next;
+  }
+  if (order->next != NullIndex) {
+    orderAt(order->next)->prev = order->prev;
+  } else {
+    level->tail = order->prev;
+  }
+  --level->count;
   level->totalShares -= order->quantity;
   if (level->empty()) {
     assert(level->totalShares == 0);
     destroyLevel(level);
-    order->level = nullptr;
+    order->level = LevelIndex();
+  } else {
+    level->half->updateTop(*level);
   }
   --orderCount;
 }
 
-inline OrderBook::OrderExt *OrderBook::createOrder(ReferenceNum refNum, CID cid, Side side,
-                                                   Quantity quantity, Price price, Timestamp tm) {
-  auto [iter, inserted] = orders.try_emplace(refNum, nullptr);
-  if (!inserted) [[unlikely]] {
-    LOG(WARNING) << "Order with refNum " << toUnderlying(refNum)
-                 << " already exists, deleting old one and creating new one";
-    OrderExt *order = iter->second;
-    unlinkOrder(order);
-    for (auto &listener : listeners) {
-      listener->onDeleteOrder(id(), order, order->quantity);
+template <typename... Args>
+OrderBook::OrderExt *OrderBook::createPoolOrder([[maybe_unused]] const Level *level,
+                                                [[maybe_unused]] OrderIndex near, Args &&...args) {
+#if BOOKPROJ_ORDER_SLABS
+  const bool pooled = near != NullIndex && !(near & WindowBit);
+  const bool ownSlab = level != nullptr && level->count >= OwnSlabOrders;
+  auto [handle, order] = orderPool.create(pooled ? OrderHandle(near) : OrderHandle(), ownSlab,
+                                          std::forward<Args>(args)...);
+#else
+  auto [handle, order] = orderPool.create(std::forward<Args>(args)...);
+#endif
+  order->index = handle.index();
+  if (order->index >= poolCold.size()) [[unlikely]] {
+    poolCold.resize(orderPool.indexLimit());
+  }
+  return order;
+}
+
+template <BookDispatch Dispatch>
+OrderBook::OrderExt *OrderBook::createOrder(const Dispatch &dispatch, LevelChanges &changes,
+                                            ReferenceNum refNum, [[maybe_unused]] const Half &half,
+                                            Quantity quantity, Price price, Timestamp tm) {
+  const uint64_t key = toUnderlying(refNum);
+  OrderExt *order = nullptr;
+  if (orderWindow.capacity() != 0) {
+    if (!orderWindow.inRange(key)) [[unlikely]] {
+      slideOrderWindow(key);
+    }
+    if (orderWindow.inRange(key)) [[likely]] {
+      order = orderWindow.find(key);
+      if (order != nullptr) [[unlikely]] {
+        recreateOrder(dispatch, changes, order, quantity, price);
+      } else {
+        order = orderWindow.emplace(key, quantity, price);
+        order->index = WindowBit | OrderIndex(orderWindow.slotOf(order));
+      }
+      initCold(order->index, refNum, tm);
+      return order;
     }
-    order->~OrderExt();
-    order = new (order) OrderExt(refNum, cid, side, quantity, price, tm);
+  }
+
+  auto [iter, inserted] = orders.try_emplace(refNum, NullIndex);
+  if (!inserted) [[unlikely]] {
+    order = orderPool[OrderHandle(iter->second)];
+    recreateOrder(dispatch, changes, order, quantity, price);
   } else {
-    iter->second = orderPool.create(refNum, cid, side, quantity, price, tm);
+#if BOOKPROJ_ORDER_SLABS
+    // next to the tail of its level-to-be
+    const Level *level = half.find(price);
+    order = createPoolOrder(level, level ? level->tail : NullIndex, quantity, price);
+#else
+    order = createPoolOrder(nullptr, NullIndex, quantity, price);
+#endif
+    iter->second = order->index;
+    if (orderWindow.capacity() != 0 && key >= orderWindow.base()) {
+      // above the window
+      highOutliers.insert(std::ranges::upper_bound(highOutliers, key), key);
+    }
   }
-  return iter->second;
+  initCold(order->index, refNum, tm);
+  return order;
+}
+
+template <BookDispatch Dispatch>
+void OrderBook::recreateOrder(const Dispatch &dispatch, LevelChanges &changes, OrderExt *order,
+                              Quantity quantity, Price price) {
+  const Level *level = levelAt(order->level);
+  const Half &half = *level->half;
+  LOG(WARNING) << "Order with refNum " << toUnderlying(coldAt(order->index).refNum)
+               << " already exists, deleting old one and creating new one";
+  touchLevel(dispatch, changes, *level);
+  unlinkOrder(order);
+  const bool bboChanged = refreshBBO(half);
+  if (dispatch.enabled()) {
+    Order view = toOrder(*order, half);
+    dispatch.onDeleteOrder(id(), &view, view.quantity);
+  }
+  // the order may be of another CID, tell BBO listeners now as for a deleteOrder
+  if (bboChanged) {
+    notifyBBO(dispatch, half.cid);
+  }
+  order->quantity = toOrderQuantity(quantity);
+  order->price = toOrderPrice(price);
 }
 
 inline void OrderBook::destroyOrder(OrderExt *order) {
-  orders.erase(order->refNum);
-  orderPool.destroy(order);
+  if (order->index & WindowBit) [[likely]] {
+    orderWindow.erase(order);
+    return;
+  }
+  const OrderIndex index = order->index;
+  const ReferenceNum refNum = poolCold[index].refNum;
+  const uint64_t key = toUnderlying(refNum);
+  if (!highOutliers.empty() && key >= orderWindow.base()) [[unlikely]] {
+    highOutliers.erase(std::ranges::lower_bound(highOutliers, key));
+  }
+  orders.erase(refNum);
+  orderPool.destroy(OrderHandle(index));
 }
 
-inline OrderBook::OrderExt *OrderBook::newOrder(ReferenceNum refNum, CID cid, Side side,
-                                                Quantity quantity, Price price, Timestamp tm) {
-  OrderExt *order = createOrder(refNum, cid, side, quantity, price, tm);
-  assert(static_cast<size_t>(toUnderlying(order->cid)) < books.size());
-  linkOrder(order);
-  for (auto &listener : listeners) {
-    listener->onNewOrder(id(), order);
+inline void OrderBook::relinkOrder(const OrderExt &moved) {
+  assert(moved.level);
+  Level *level = levelAt(moved.level);
+  if (moved.prev != NullIndex) {
+    orderAt(moved.prev)->next = moved.index;
+  } else {
+    level->head = moved.index;
+  }
+  if (moved.next != NullIndex) {
+    orderAt(moved.next)->prev = moved.index;
+  } else {
+    level->tail = moved.index;
+  }
+}
+
+inline void OrderBook::slideOrderWindow(uint64_t key) {
+  const uint64_t base = orderWindow.base();
+  const uint64_t capacity = orderWindow.capacity();
+  if (key < base) {
+    // an old reference number, it goes to orders
+    return;
+  }
+  uint64_t newBase = key - capacity + 1;
+  if (orderWindow.empty()) {
+    newBase = key;
+  } else if (key - base >= 2 * capacity && highOutliers.size() < MaxHighOutliers) {
+    // too far above, treat it as an outlier instead of evicting the whole window
+    return;
+  }
+  // slide at least a word of slots at a time
+  newBase = std::max(newBase, base + 64);
+
+  // evict orders falling off the window to orders/orderPool
+  orderWindow.advance(newBase, [this](OrderExt &order) {
+    // next to its neighbours in the level that went to orderPool before it
+    const OrderIndex near = (order.prev & WindowBit) ? order.next : order.prev;
+    OrderExt *moved = createPoolOrder(levelAt(order.level), near, order);
+    const OrderCold &cold = poolCold[moved->index] = windowCold[order.index & ~WindowBit];
+    relinkOrder(*moved);
+    orders.emplace(cold.refNum, moved->index);
+  });
+
+  // move high outliers the window now covers from orders into it
+  auto last = std::ranges::lower_bound(highOutliers, newBase + capacity);
+  for (auto it = highOutliers.begin(); it != last; ++it) {
+    if (*it >= newBase) {
+      auto oit = orders.find(ReferenceNum(*it));
+      OrderExt *order = orderPool[OrderHandle(oit->second)];
+      orders.erase(oit);
+      OrderExt *moved = orderWindow.emplace(*it, *order);
+      moved->index = WindowBit | OrderIndex(orderWindow.slotOf(moved));
+      windowCold[moved->index & ~WindowBit] = poolCold[order->index];
+      relinkOrder(*moved);
+      orderPool.destroy(OrderHandle(order->index));
+    }
+  }
+  highOutliers.erase(highOutliers.begin(), last);
+}
+
+template <BookDispatch Dispatch>
+OrderBook::OrderExt *OrderBook::newOrder(const Dispatch &dispatch, ReferenceNum refNum, CID cid,
+                                         Side side, Quantity quantity, Price price,
+                                         Timestamp tm) {
+  assert(static_cast<size_t>(toUnderlying(cid)) < books.size());
+  if (!isOrderPrice(price)) [[unlikely]] {
+    LOG(WARNING) << "Order with refNum " << toUnderlying(refNum) << " has price "
+                 << double(price) << " that orders can not hold, dropping it";
+    return nullptr;
+  }
+  if (!isOrderQuantity(quantity)) [[unlikely]] {
+    LOG(WARNING) << "Order with refNum " << toUnderlying(refNum) << " has quantity " << quantity
+                 << " that orders can not hold, dropping it";
+    return nullptr;
+  }
+  Half &half = books[toUnderlying(cid)].halves[side != Side::Bid];
+  LevelChanges changes;
+  OrderExt *order = createOrder(dispatch, changes, refNum, half, quantity, price, tm);
+  touchLevel(dispatch, changes, half, price);
+  linkOrder(order, half, price);
+  const bool bboChanged = refreshBBO(half);
+  if (dispatch.enabled()) {
+    Order view = toOrder(*order, half);
+    dispatch.onNewOrder(id(), &view);
+  }
+  notifyLevels(dispatch, changes);
+  if (bboChanged) {
+    notifyBBO(dispatch, cid);
   }
   return order;
 }
 
-inline void OrderBook::reduceOrderBy(OrderExt *order, Quantity changeQuantity, Timestamp ut) {
+template <BookDispatch Dispatch>
+void OrderBook::reduceOrderBy(const Dispatch &dispatch, OrderExt *order, Quantity changeQuantity,
+                              Timestamp ut) {
+  Level *level = levelAt(order->level);
+  const Half &half = *level->half;
+  LevelChanges changes;
+  touchLevel(dispatch, changes, *level);
   Quantity oldQuantity = order->quantity;
   if (order->quantity <= changeQuantity) {
     unlinkOrder(order);
     if (order->quantity < changeQuantity) [[unlikely]] {
-      LOG(WARNING) << "Order with refNum " << toUnderlying(order->refNum)
+      LOG(WARNING) << "Order with refNum " << toUnderlying(refNumOf(order))
                    << " has less remaining quantity (" << order->quantity
                    << ") than reduceBy quantity (" << changeQuantity << ")";
     }
@@ -379,12 +1621,19 @@ inline void OrderBook::reduceOrderBy(OrderExt *order, Quantity changeQuantity, T
     order->quantity = 0;
   } else {
     order->quantity -= changeQuantity;
-    order->level->totalShares -= changeQuantity;
+    level->totalShares -= changeQuantity;
+    level->half->updateTop(*level);
   }
+  const bool bboChanged = refreshBBO(half);
 
-  order->updateTime = ut;
-  for (auto &listener : listeners) {
-    listener->onUpdateOrder(id(), order, oldQuantity, order->price);
+  setUpdateTime(order->index, ut);
+  if (dispatch.enabled()) {
+    Order view = toOrder(*order, half);
+    dispatch.onUpdateOrder(id(), &view, oldQuantity, view.price);
+  }
+  notifyLevels(dispatch, changes);
+  if (bboChanged) {
+    notifyBBO(dispatch, half.cid);
   }
 
   if (order->quantity == 0) {
@@ -392,83 +1641,127 @@ inline void OrderBook::reduceOrderBy(OrderExt *order, Quantity changeQuantity, T
   }
 }
 
-inline void OrderBook::reduceOrderBy(ReferenceNum refNum, Quantity changeQuantity, Timestamp ut) {
+template <BookDispatch Dispatch>
+void OrderBook::reduceOrderBy(const Dispatch &dispatch, ReferenceNum refNum,
+                              Quantity changeQuantity, Timestamp ut) {
   if (auto order = findOrder(refNum)) [[likely]] {
-    reduceOrderBy(order, changeQuantity, ut);
+    reduceOrderBy(dispatch, order, changeQuantity, ut);
   } else {
     LOG(WARNING) << "Order with refNum " << toUnderlying(refNum) << " not found in reduceBy";
   }
 }
 
-inline void OrderBook::reduceOrderTo(OrderExt *order, Quantity newQuantity, Timestamp ut) {
+template <BookDispatch Dispatch>
+void OrderBook::reduceOrderTo(const Dispatch &dispatch, OrderExt *order, Quantity newQuantity,
+                              Timestamp ut) {
   if (newQuantity == 0) {
-    deleteOrder(order, ut);
+    deleteOrder(dispatch, order, ut);
+    return;
+  }
+  if (!isOrderQuantity(newQuantity)) [[unlikely]] {
+    LOG(WARNING) << "Order with refNum " << toUnderlying(refNumOf(order))
+                 << " has reduceTo quantity " << newQuantity
+                 << " that orders can not hold, deleting it";
+    deleteOrder(dispatch, order, ut);
     return;
   }
 
+  Level *level = levelAt(order->level);
+  LevelChanges changes;
+  touchLevel(dispatch, changes, *level);
   Quantity oldQuantity = order->quantity;
   if (oldQuantity < newQuantity) [[unlikely]] {
-    LOG(WARNING) << "Order with refNum " << toUnderlying(order->refNum)
+    LOG(WARNING) << "Order with refNum " << toUnderlying(refNumOf(order))
                  << " has less remaining quantity (" << oldQuantity << ") than reduceTo quantity ("
                  << newQuantity << "), increasing to new quantity";
   }
-  order->quantity = newQuantity;
-  order->level->totalShares -= oldQuantity - order->quantity;
-  order->updateTime = ut;
-  for (auto &listener : listeners) {
-    listener->onUpdateOrder(id(), order, oldQuantity, order->price);
+  order->quantity = toOrderQuantity(newQuantity);
+  level->totalShares -= oldQuantity - newQuantity;
+  level->half->updateTop(*level);
+  const bool bboChanged = refreshBBO(*level->half);
+  setUpdateTime(order->index, ut);
+  if (dispatch.enabled()) {
+    Order view = toOrder(*order, *level->half);
+    dispatch.onUpdateOrder(id(), &view, oldQuantity, view.price);
+  }
+  notifyLevels(dispatch, changes);
+  if (bboChanged) {
+    notifyBBO(dispatch, level->cid());
   }
 }
 
-inline void OrderBook::reduceOrderTo(ReferenceNum refNum, Quantity newQuantity, Timestamp ut) {
+template <BookDispatch Dispatch>
+void OrderBook::reduceOrderTo(const Dispatch &dispatch, ReferenceNum refNum, Quantity newQuantity,
+                              Timestamp ut) {
   if (auto order = findOrder(refNum)) [[likely]] {
-    reduceOrderTo(order, newQuantity, ut);
+    reduceOrderTo(dispatch, order, newQuantity, ut);
   } else {
     LOG(WARNING) << "Order with refNum " << toUnderlying(refNum) << " not found in reduceTo";
   }
 }
 
-inline OrderBook::OrderExt *OrderBook::replaceOrder(OrderExt *order, ReferenceNum newRefNum,
-                                                    Quantity newQuantity, Price newPrice,
-                                                    Timestamp tm) {
+template <BookDispatch Dispatch>
+OrderBook::OrderExt *OrderBook::replaceOrder(const Dispatch &dispatch, OrderExt *order,
+                                             ReferenceNum newRefNum, Quantity newQuantity,
+                                             Price newPrice, Timestamp tm) {
+  if (!isOrderPrice(newPrice)) [[unlikely]] {
+    LOG(WARNING) << "Order with refNum " << toUnderlying(newRefNum) << " has price "
+                 << double(newPrice) << " that orders can not hold, deleting the order "
+                 << toUnderlying(refNumOf(order)) << " it replaces";
+    deleteOrder(dispatch, order, tm);
+    return nullptr;
+  }
+  if (!isOrderQuantity(newQuantity)) [[unlikely]] {
+    LOG(WARNING) << "Order with refNum " << toUnderlying(newRefNum) << " has quantity "
+                 << newQuantity << " that orders can not hold, deleting the order "
+                 << toUnderlying(refNumOf(order)) << " it replaces";
+    deleteOrder(dispatch, order, tm);
+    return nullptr;
+  }
+  const Level *level = levelAt(order->level);
+  Half &half = *level->half;
+  LevelChanges changes;
+  touchLevel(dispatch, changes, *level);
   unlinkOrder(order);
-  OrderExt *oldOrder = order;
-  OrderExt *newOrder = nullptr;
-  std::byte buf[sizeof(OrderExt)];
-
-  // same reference number
-  if (order->refNum == newRefNum) {
-    // move old order to a temporary place, construct new order in its original place
-    oldOrder = new (buf) OrderExt(std::move(*order));
-    order->~OrderExt();
-    newOrder =
-        new (order) OrderExt(newRefNum, oldOrder->cid, oldOrder->side, newQuantity, newPrice, tm);
+  setUpdateTime(order->index, tm);
+  // keep a copy of the old order for listeners, the record has no outside references
+  const OrderExt oldOrder = *order;
+  const OrderCold oldCold = coldAt(order->index);
+
+  OrderExt *newOrder = order;
+  if (oldCold.refNum == newRefNum) {
+    // same reference number, reuse the old order in its original place
+    order->quantity = toOrderQuantity(newQuantity);
+    order->price = toOrderPrice(newPrice);
+    initCold(order->index, newRefNum, tm);
   } else {
-    newOrder = createOrder(newRefNum, order->cid, order->side, newQuantity, newPrice, tm);
+    // release the old order first, creating the new one may slide the window and move it
+    destroyOrder(order);
+    newOrder = createOrder(dispatch, changes, newRefNum, half, newQuantity, newPrice, tm);
   }
 
-  linkOrder(newOrder);
-  for (auto &listener : listeners) {
-    listener->onReplaceOrder(id(), oldOrder, newOrder);
+  touchLevel(dispatch, changes, half, newPrice);
+  linkOrder(newOrder, half, newPrice);
+  const bool bboChanged = refreshBBO(half);
+  if (dispatch.enabled()) {
+    Order view = toOrder(*newOrder, half);
+    Order oldView = toOrder(oldOrder, oldCold, half);
+    dispatch.onReplaceOrder(id(), &oldView, &view);
   }
-
-  if (order == oldOrder) {
-    // free memory
-    destroyOrder(oldOrder);
-  } else {
-    // storage is buf, just pseudo destruct
-    oldOrder->~OrderExt();
+  notifyLevels(dispatch, changes);
+  if (bboChanged) {
+    notifyBBO(dispatch, half.cid);
   }
-
   return newOrder;
 }
 
-inline OrderBook::OrderExt *OrderBook::replaceOrder(ReferenceNum oldRefNum, ReferenceNum newRefNum,
-                                                    Quantity newQuantity, Price newPrice,
-                                                    Timestamp tm) {
+template <BookDispatch Dispatch>
+OrderBook::OrderExt *OrderBook::replaceOrder(const Dispatch &dispatch, ReferenceNum oldRefNum,
+                                             ReferenceNum newRefNum, Quantity newQuantity,
+                                             Price newPrice, Timestamp tm) {
   // have to define this inline due to llvm bug
   if (OrderExt *oldOrder = findOrder(oldRefNum)) [[likely]] {
-    return replaceOrder(oldOrder, newRefNum, newQuantity, newPrice, tm);
+    return replaceOrder(dispatch, oldOrder, newRefNum, newQuantity, newPrice, tm);
   } else {
     LOG(WARNING) << "Order with refNum " << toUnderlying(oldRefNum)
                  << " not found in replaceOrder";
@@ -476,32 +1769,48 @@ inline OrderBook::OrderExt *OrderBook::replaceOrder(ReferenceNum oldRefNum, Refe
   }
 }
 
-inline void OrderBook::deleteOrder(OrderExt *order, Timestamp ut) {
+template <BookDispatch Dispatch>
+void OrderBook::deleteOrder(const Dispatch &dispatch, OrderExt *order, Timestamp ut) {
+  const Level *level = levelAt(order->level);
+  const Half &half = *level->half;
+  LevelChanges changes;
+  touchLevel(dispatch, changes, *level);
   unlinkOrder(order);
-  order->updateTime = ut;
-  for (auto &listener : listeners) {
-    listener->onDeleteOrder(id(), order, order->quantity);
+  const bool bboChanged = refreshBBO(half);
+  setUpdateTime(order->index, ut);
+  if (dispatch.enabled()) {
+    Order view = toOrder(*order, half);
+    dispatch.onDeleteOrder(id(), &view, view.quantity);
+  }
+  notifyLevels(dispatch, changes);
+  if (bboChanged) {
+    notifyBBO(dispatch, half.cid);
   }
   destroyOrder(order);
 }
 
-inline void OrderBook::deleteOrder(ReferenceNum refNum, Timestamp ut) {
+template <BookDispatch Dispatch>
+void OrderBook::deleteOrder(const Dispatch &dispatch, ReferenceNum refNum, Timestamp ut) {
   // have to define this inline due to llvm bug
   if (auto order = findOrder(refNum)) [[likely]] {
-    deleteOrder(order, ut);
+    deleteOrder(dispatch, order, ut);
   } else {
     LOG(WARNING) << "Order with refNum " << toUnderlying(refNum) << " not found in deleteOrder";
   }
 }
 
-inline void OrderBook::executeOrder(OrderExt *order, Quantity quantity, const ExecInfo &ei,
-                                    Timestamp ut) {
-  Level *level = order->level;
+template <BookDispatch Dispatch>
+void OrderBook::executeOrder(const Dispatch &dispatch, OrderExt *order, Quantity quantity,
+                             const ExecInfo &ei, Timestamp ut) {
+  Level *level = levelAt(order->level);
+  const Half &half = *level->half;
+  LevelChanges changes;
+  touchLevel(dispatch, changes, *level);
   Quantity oldQuantity = order->quantity;
   if (order->quantity <= quantity) {
     unlinkOrder(order);
     if (order->quantity < quantity) [[unlikely]] {
-      LOG(WARNING) << "Order with refNum " << toUnderlying(order->refNum)
+      LOG(WARNING) << "Order with refNum " << toUnderlying(refNumOf(order))
                    << " has less remaining quantity (" << order->quantity
                    << ") than execute quantity (" << quantity << ")";
     }
@@ -511,12 +1820,18 @@ inline void OrderBook::executeOrder(OrderExt *order, Quantity quantity, const Ex
   } else {
     level->totalShares -= quantity;
     order->quantity -= quantity;
+    level->half->updateTop(*level);
   }
-  order->updateTime = ut;
+  const bool bboChanged = refreshBBO(half);
+  setUpdateTime(order->index, ut);
 
-  // decrement level totalShares
-  for (auto &listener : listeners) {
-    listener->onExecOrder(id(), order, oldQuantity, quantity, ei);
+  if (dispatch.enabled()) {
+    Order view = toOrder(*order, half);
+    dispatch.onExecOrder(id(), &view, oldQuantity, quantity, ei);
+  }
+  notifyLevels(dispatch, changes);
+  if (bboChanged) {
+    notifyBBO(dispatch, half.cid);
   }
 
   if (order->quantity == 0) {
@@ -524,52 +1839,266 @@ inline void OrderBook::executeOrder(OrderExt *order, Quantity quantity, const Ex
   }
 }
 
-inline void OrderBook::executeOrder(ReferenceNum refNum, Quantity quantity, const ExecInfo &ei,
-                                    Timestamp ut) {
+template <BookDispatch Dispatch>
+void OrderBook::executeOrder(const Dispatch &dispatch, ReferenceNum refNum, Quantity quantity,
+                             const ExecInfo &ei, Timestamp ut) {
   // have to define this inline due to llvm bug
   if (auto order = findOrder(refNum)) [[likely]] {
-    executeOrder(order, quantity, ei, ut);
+    executeOrder(dispatch, order, quantity, ei, ut);
   } else {
     LOG(WARNING) << "Order with refNum " << toUnderlying(refNum) << " not found in executeOrder";
   }
 }
 
-inline OrderBook::Level *OrderBook::findOrCreateLevel(CID cid, Side side, Price price) {
-  auto &book = books[toUnderlying(cid)];
-  auto &half = book.halves[side != Side::Bid];
+template <BookDispatch Dispatch>
+void OrderBook::touchLevel(const Dispatch &dispatch, LevelChanges &changes,
+                           const Level &level) const {
+  touchLevel(dispatch, changes, *level.half, level.price);
+}
+
+template <BookDispatch Dispatch>
+void OrderBook::touchLevel(const Dispatch &dispatch, LevelChanges &changes, const Half &half,
+                           Price price) const {
+  if (!dispatch.levelsEnabled()) {
+    return;
+  }
+  for (size_t ii = 0; ii < changes.size; ++ii) {
+    if (changes.levels[ii].half == &half && changes.levels[ii].price == price) {
+      return;
+    }
+  }
+  assert(changes.size < std::size(changes.levels));
+  const Level *level = half.find(price);
+  changes.levels[changes.size++] = {&half, price, level ? level->totalShares : 0,
+                                    level ? level->numOrders() : 0};
+}
 
-  auto [iter, inserted] = levels.try_emplace(LevelKey(cid, side, price), nullptr);
-  if (inserted) {
-    iter->second = levelPool.create(&half, price);
-    if (levels.size() > maxLevelCount) {
-      maxLevelCount = levels.size();
+template <BookDispatch Dispatch>
+void OrderBook::notifyLevels(const Dispatch &dispatch, const LevelChanges &changes) const {
+  if (!dispatch.levelsEnabled()) {
+    return;
+  }
+  for (size_t ii = 0; ii < changes.size; ++ii) {
+    const auto &before = changes.levels[ii];
+    const Level *level = before.half->find(before.price);
+    const Quantity totalShares = level ? level->totalShares : 0;
+    const size_t numOrders = level ? level->numOrders() : 0;
+    // skip levels left as they were, or created and removed within the mutation
+    if (totalShares == before.totalShares && numOrders == before.numOrders) {
+      continue;
     }
+    dispatch.onLevelChange(id(), before.half->cid, before.half->side, before.price, totalShares,
+                           numOrders, before.numOrders == 0, numOrders == 0);
+  }
+}
+
+inline bool OrderBook::refreshBBO(const Half &half) {
+  BBO &bbo = books[toUnderlying(half.cid)].bbo;
+  BBO::Quote &quote = half.side == Side::Bid ? bbo.bid : bbo.ask;
+  BBO::Quote top;
+  if (const Level *level = half.top()) {
+    top = {level->price, level->totalShares, uint32_t(level->numOrders())};
+  }
+  if (top == quote) [[likely]] {
+    return false;
+  }
+  quote = top;
+  return true;
+}
+
+template <BookDispatch Dispatch>
+void OrderBook::notifyBBO(const Dispatch &dispatch, CID cid) const {
+  if (dispatch.bboEnabled()) {
+    dispatch.onBBOChange(id(), cid, books[toUnderlying(cid)].bbo);
+  }
+}
+
+template <BookDispatch Dispatch>
+void OrderBook::apply(const Dispatch &dispatch, const BookOp &op) {
+  switch (op.type) {
+  case BookOp::Type::NewOrder:
+    newOrder(dispatch, op.refNum, op.cid, op.side, op.quantity, op.price, op.tm);
+    break;
+  case BookOp::Type::ReduceBy:
+    reduceOrderBy(dispatch, op.refNum, op.quantity, op.tm);
+    break;
+  case BookOp::Type::ReduceTo:
+    reduceOrderTo(dispatch, op.refNum, op.quantity, op.tm);
+    break;
+  case BookOp::Type::Replace:
+    replaceOrder(dispatch, op.refNum, op.newRefNum, op.quantity, op.price, op.tm);
+    break;
+  case BookOp::Type::Delete:
+    deleteOrder(dispatch, op.refNum, op.tm);
+    break;
+  case BookOp::Type::Execute:
+    executeOrder(dispatch, op.refNum, op.quantity, op.ei, op.tm);
+    break;
+  }
+}
+
+template <BookDispatch Dispatch, typename Applied>
+void OrderBook::apply(const Dispatch &dispatch, std::span<const BookOp> ops, Applied &&applied) {
+  const size_t numOps = ops.size();
+  for (size_t ii = 0; ii < std::min(numOps, OrderPrefetchDistance); ++ii) {
+    prefetchOpIndex(ops[ii]);
+  }
+  for (size_t ii = 0; ii < numOps; ++ii) {
+    if (ii + OrderPrefetchDistance < numOps) {
+      prefetchOpIndex(ops[ii + OrderPrefetchDistance]);
+    }
+    if (ii + LevelPrefetchDistance < numOps) {
+      prefetchOpLevel(ops[ii + LevelPrefetchDistance]);
+    }
+    if (ii + HalfPrefetchDistance < numOps) {
+      prefetchOpHalf(ops[ii + HalfPrefetchDistance]);
+    }
+    if (ii + TopPrefetchDistance < numOps) {
+      prefetchOpTop(ops[ii + TopPrefetchDistance]);
+    }
+    apply(dispatch, ops[ii]);
+    applied(ops[ii]);
   }
-  return iter->second;
+}
+
+inline void OrderBook::prefetchIndex(ReferenceNum refNum) const {
+  const uint64_t key = toUnderlying(refNum);
+  if (orderWindow.inRange(key)) {
+    orderWindow.prefetch(key);
+    __builtin_prefetch(&windowCold[orderWindow.slotOfKey(key)]);
+  } else {
+    orders.prefetch(refNum);
+  }
+}
+
+inline void OrderBook::prefetchOrder(ReferenceNum refNum) const {
+  if (const OrderExt *order = findOrder(refNum)) {
+    __builtin_prefetch(order);
+    __builtin_prefetch(&coldAt(order->index));
+    __builtin_prefetch(levelAt(order->level));
+  }
+}
+
+inline void OrderBook::prefetchOpIndex(const BookOp &op) const {
+  prefetchIndex(op.refNum);
+  if (op.type == BookOp::Type::Replace) {
+    prefetchIndex(op.newRefNum);
+  } else if (op.type == BookOp::Type::NewOrder) {
+    const PerCIDBook &book = books[toUnderlying(op.cid)];
+    prefetchLines(book.halves[op.side != Side::Bid]);
+    __builtin_prefetch(&book.bbo);
+  }
+}
+
+inline void OrderBook::prefetchOpLevel(const BookOp &op) const {
+  if (op.type == BookOp::Type::NewOrder) {
+    const Half &half = books[toUnderlying(op.cid)].halves[op.side != Side::Bid];
+    if (const Level *level = half.find(op.price)) {
+      __builtin_prefetch(level);
+    }
+    return;
+  }
+  // the order may be gone by the time op is applied, it is only used for the addresses
+  const OrderExt *order = findOrder(op.refNum);
+  if (order == nullptr) {
+    return;
+  }
+  __builtin_prefetch(levelAt(order->level));
+  __builtin_prefetch(&coldAt(order->index));
+  if (op.type == BookOp::Type::Delete || op.type == BookOp::Type::Replace) {
+    if (order->prev != NullIndex) {
+      __builtin_prefetch(orderAt(order->prev));
+    }
+    if (order->next != NullIndex) {
+      __builtin_prefetch(orderAt(order->next));
+    }
+  }
+}
+
+inline void OrderBook::prefetchOpHalf(const BookOp &op) const {
+  if (op.type != BookOp::Type::NewOrder) {
+    if (const OrderExt *order = findOrder(op.refNum)) {
+      prefetchLines(*levelAt(order->level)->half);
+    }
+  }
+}
+
+inline void OrderBook::prefetchOpTop(const BookOp &op) const {
+  const Half *half = nullptr;
+  if (op.type == BookOp::Type::NewOrder) {
+    half = &books[toUnderlying(op.cid)].halves[op.side != Side::Bid];
+  } else if (const OrderExt *order = findOrder(op.refNum)) {
+    const Level *level = levelAt(order->level);
+    half = level->half;
+    half->prefetch(level->price);
+  } else {
+    return;
+  }
+  if (const Level *top = half->top()) {
+    __builtin_prefetch(top);
+  }
+  __builtin_prefetch(&books[toUnderlying(half->cid)].bbo);
+}
+
+inline void OrderBook::prefetchLines(const Half &half) const {
+  const char *bytes = reinterpret_cast<const char *>(&half);
+  for (size_t offset = 0; offset < sizeof(Half); offset += 64) {
+    __builtin_prefetch(bytes + offset);
+  }
+}
+
+inline OrderBook::Level *OrderBook::findOrCreateLevel(Half &half, Price price) {
+  // the half is the only index of levels, it links them by handle
+  Level *level = half.find(price);
+  if (level == nullptr) {
+    LevelIndex index;
+    std::tie(index, level) = levelPool.create(&half, price);
+    level->index = index;
+    half.insert(price, level);
+    if (++levelCount > maxLevelCount) {
+      maxLevelCount = levelCount;
+    }
+  }
+  return level;
 }
 
 inline void OrderBook::destroyLevel(Level *level) {
-  levels.erase(LevelKey(level->cid(), level->side(), level->price));
-  levelPool.destroy(level);
+  --levelCount;
+  levelPool.destroy(level->index);
 }
 
-inline void OrderBook::clear(CID cid, bool callListeners) {
+template <BookDispatch Dispatch>
+void OrderBook::clear(const Dispatch &dispatch, bool callListeners) {
+  for (size_t ii = 0; ii < books.size(); ++ii) {
+    clear(dispatch, static_cast<CID>(ii), callListeners);
+  }
+}
+
+template <BookDispatch Dispatch>
+void OrderBook::clear(const Dispatch &dispatch, CID cid, bool callListeners) {
   assert(toUnderlying(cid) >= 0 && std::cmp_less(toUnderlying(cid), books.size()));
   auto &book = books[toUnderlying(cid)];
   for (auto &half : book.halves) {
     for (size_t numLevels = half.size(); numLevels; --numLevels) {
       Level *level = half.begin()->second;
+      LevelChanges changes;
+      if (callListeners) {
+        touchLevel(dispatch, changes, *level);
+      }
       for (size_t numOrders = level->size(); numOrders; --numOrders) {
-        OrderExt *order = &level->front();
+        OrderExt *order = orderAt(level->head);
         unlinkOrder(order);
-        if (callListeners) {
-          for (auto &listener : listeners) {
-            listener->onDeleteOrder(id(), order, order->quantity);
-          }
+        if (callListeners && dispatch.enabled()) {
+          Order view = toOrder(*order, half);
+          dispatch.onDeleteOrder(id(), &view, view.quantity);
         }
         destroyOrder(order);
       }
       // level should have been destroyed by last eraseOrder
+      notifyLevels(dispatch, changes);
+    }
+    if (refreshBBO(half) && callListeners) {
+      notifyBBO(dispatch, cid);
     }
   }
 }
@@ -579,21 +2108,19 @@ inline void OrderBook::resize(CID maxCID) {
   assert(ubound > 0);
   if (std::cmp_less(ubound, books.size())) {
     for (auto cid = ubound; std::cmp_less(cid, books.size()); ++cid) {
-      clear(static_cast<CID>(cid), false);
+      clear(StaticDispatch<>{}, static_cast<CID>(cid), false);
     }
     books.erase(books.begin() + ubound, books.end());
   } else {
     while (std::cmp_less(books.size(), ubound)) {
-      books.emplace_back(static_cast<CID>(books.size()));
+      books.emplace_back(this, static_cast<CID>(books.size()));
     }
   }
 }
 
 inline const OrderBook::Level *OrderBook::topLevel(CID cid, Side side) const {
   assert(toUnderlying(cid) >= 0 && std::cmp_less(toUnderlying(cid), books.size()));
-  const auto &book = books[toUnderlying(cid)];
-  const auto &half = book.halves[side != Side::Bid];
-  return half.empty() ? nullptr : half.begin()->second;
+  return books[toUnderlying(cid)].halves[side != Side::Bid].top();
 }
 
 // get n-th best level for cid/side, nullptr if not enough levels
@@ -601,18 +2128,91 @@ inline const OrderBook::Level *OrderBook::nthLevel(CID cid, Side side, size_t n)
   assert(toUnderlying(cid) >= 0 && std::cmp_less(toUnderlying(cid), books.size()));
   const auto &book = books[toUnderlying(cid)];
   const auto &half = book.halves[side != Side::Bid];
+  const size_t numTops = half.numTopLevels();
+  if (n < numTops) [[likely]] {
+    return half.topLevel(n);
+  }
   if (n >= half.size()) {
     return nullptr;
   }
-  auto iter = half.begin();
-  std::advance(iter, n);
+  // walk on from the last of the top levels
+  auto iter = half.upper_bound(half.topLevel(numTops - 1)->price);
+  std::advance(iter, n - numTops);
   return iter->second;
 }
 
 inline const OrderBook::Level *OrderBook::getLevel(CID cid, Side side, Price price) const {
-  auto iter = levels.find(LevelKey(cid, side, price));
-  return iter == levels.end() ? nullptr : iter->second;
+  assert(toUnderlying(cid) >= 0 && std::cmp_less(toUnderlying(cid), books.size()));
+  return books[toUnderlying(cid)].halves[side != Side::Bid].find(price);
 }
 
+// OrderBook whose listeners are bound at compile time, see StaticDispatch.  Callbacks are called
+// directly and can be inlined into the mutators, with no listeners all notification code compiles
+// away.  Listeners are held by reference, BookListeners cannot be added at runtime
+template <typename... Listeners> class StaticOrderBook : public OrderBook {
+public:
+  explicit StaticOrderBook(BookID id_, Listeners &...listeners)
+      : OrderBook(id_), dispatch{std::tie(listeners...)} {}
+
+  void addListener(BookListener *listener) = delete;
+  void removeListener(BookListener *listener) = delete;
+  void addLevelListener(LevelListener *listener) = delete;
+  void removeLevelListener(LevelListener *listener) = delete;
+  void addBBOListener(BBOListener *listener) = delete;
+  void removeBBOListener(BBOListener *listener) = delete;
+
+  OrderExt *newOrder(ReferenceNum refNum, CID cid, Side side, Quantity quantity, Price price,
+                     Timestamp tm) {
+    return OrderBook::newOrder(dispatch, refNum, cid, side, quantity, price, tm);
+  }
+
+  void reduceOrderBy(OrderExt *order, Quantity changeQuantity, Timestamp ut) {
+    OrderBook::reduceOrderBy(dispatch, order, changeQuantity, ut);
+  }
+  void reduceOrderBy(ReferenceNum refNum, Quantity changeQuantity, Timestamp ut) {
+    OrderBook::reduceOrderBy(dispatch, refNum, changeQuantity, ut);
+  }
+
+  void reduceOrderTo(OrderExt *order, Quantity newQuantity, Timestamp ut) {
+    OrderBook::reduceOrderTo(dispatch, order, newQuantity, ut);
+  }
+  void reduceOrderTo(ReferenceNum refNum, Quantity newQuantity, Timestamp ut) {
+    OrderBook::reduceOrderTo(dispatch, refNum, newQuantity, ut);
+  }
+
+  OrderExt *replaceOrder(OrderExt *order, ReferenceNum newRefNum, Quantity newQuantity,
+                         Price newPrice, Timestamp tm) {
+    return OrderBook::replaceOrder(dispatch, order, newRefNum, newQuantity, newPrice, tm);
+  }
+  OrderExt *replaceOrder(ReferenceNum oldRefNum, ReferenceNum newRefNum, Quantity newQuantity,
+                         Price newPrice, Timestamp tm) {
+    return OrderBook::replaceOrder(dispatch, oldRefNum, newRefNum, newQuantity, newPrice, tm);
+  }
+
+  void deleteOrder(OrderExt *order, Timestamp ut) { OrderBook::deleteOrder(dispatch, order, ut); }
+  void deleteOrder(ReferenceNum refNum, Timestamp ut) {
+    OrderBook::deleteOrder(dispatch, refNum, ut);
+  }
+
+  void executeOrder(OrderExt *order, Quantity quantity, const ExecInfo &ei, Timestamp ut) {
+    OrderBook::executeOrder(dispatch, order, quantity, ei, ut);
+  }
+  void executeOrder(ReferenceNum refNum, Quantity quantity, const ExecInfo &ei, Timestamp ut) {
+    OrderBook::executeOrder(dispatch, refNum, quantity, ei, ut);
+  }
+
+  void clearBook(CID cid) { OrderBook::clear(dispatch, cid, true); }
+  void clear(bool callListeners) { OrderBook::clear(dispatch, callListeners); }
+
+  void apply(const BookOp &op) { OrderBook::apply(dispatch, op); }
+  void apply(std::span<const BookOp> ops) { OrderBook::apply(dispatch, ops); }
+  template <typename Applied> void apply(std::span<const BookOp> ops, Applied &&applied) {
+    OrderBook::apply(dispatch, ops, applied);
+  }
+
+private:
+  StaticDispatch<Listeners...> dispatch;
+};
+
 } // namespace orderbook
 } // namespace bookproj
@@ -0,0 +1,194 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace bookproj {
+
+// PriceLadder maps integer keys (price ticks) in a window [low, low + Size) to values of T, a
+// pointer or pool handle whose default value T() is empty.  Entries are kept in a ring of Size
+// slots, key k in slot k & (Size - 1), so moving the window leaves the entries that stay in it in
+// place.  A two-level occupancy bitmap finds the next or previous occupied key in constant time.
+// Slots are allocated on first use.
+template <typename T, size_t Size> class PriceLadder {
+  static_assert(std::has_single_bit(Size) && Size >= 64 && Size <= 64 * 64);
+  static constexpr size_t Words = Size / 64;
+  static constexpr size_t Mask = Size - 1;
+  static constexpr size_t NotFound = Size;
+
+public:
+  PriceLadder() = default;
+  PriceLadder(PriceLadder &&) = default;
+  PriceLadder &operator=(PriceLadder &&) = default;
+
+  static constexpr size_t capacity() { return Size; }
+
+  int64_t low() const { return lo; }
+  int64_t high() const { return lo + int64_t(Size); }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  bool inWindow(int64_t key) const { return uint64_t(key - lo) < Size; }
+
+  // key must be in window, T() if it is not occupied
+  T get(int64_t key) const {
+    assert(inWindow(key));
+    return slots ? slots[key & Mask] : T();
+  }
+
+  // prefetch the slot of key, key must be in window
+  void prefetch(int64_t key) const {
+    assert(inWindow(key));
+    if (slots) {
+      __builtin_prefetch(&slots[key & Mask]);
+    }
+  }
+
+  // allocate the slots ahead of the first set
+  void reserve() {
+    if (!slots) {
+      slots.reset(new T[Size]());
+    }
+  }
+
+  // key must be in window and not occupied
+  void set(int64_t key, T t) {
+    assert(inWindow(key) && t && !get(key));
+    if (!slots) [[unlikely]] {
+      reserve();
+    }
+    size_t slot = key & Mask;
+    slots[slot] = t;
+    bits[slot / 64] |= uint64_t(1) << (slot % 64);
+    summary |= uint64_t(1) << (slot / 64);
+    ++count;
+  }
+
+  // key must be in window and occupied
+  void reset(int64_t key) {
+    assert(get(key));
+    size_t slot = key & Mask;
+    slots[slot] = T();
+    bits[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    if (bits[slot / 64] == 0) {
+      summary &= ~(uint64_t(1) << (slot / 64));
+    }
+    --count;
+  }
+
+  // the first occupied key no less than key, high() if none, key must be in [low, high]
+  int64_t next(int64_t key) const {
+    assert(key >= lo && key <= high());
+    if (count == 0 || key == high()) {
+      return high();
+    }
+    const size_t loSlot = lo & Mask;
+    const size_t slot = key & Mask;
+    size_t found = NotFound;
+    if (slot >= loSlot) {
+      found = findFirst(slot, Size);
+      if (found == NotFound) {
+        found = findFirst(0, loSlot);
+      }
+    } else {
+      found = findFirst(slot, loSlot);
+    }
+    return found == NotFound ? high() : toKey(found);
+  }
+
+  // the last occupied key less than key, low() - 1 if none, key must be in [low, high]
+  int64_t prev(int64_t key) const {
+    assert(key >= lo && key <= high());
+    if (count == 0 || key == lo) {
+      return lo - 1;
+    }
+    const size_t loSlot = lo & Mask;
+    // search slots of keys in [low, key)
+    const size_t endSlot = key == high() ? loSlot : key & Mask;
+    size_t found = NotFound;
+    if (endSlot > loSlot) {
+      found = findLast(loSlot, endSlot);
+    } else {
+      found = findLast(0, endSlot);
+      if (found == NotFound) {
+        found = findLast(loSlot, Size);
+      }
+    }
+    return found == NotFound ? lo - 1 : toKey(found);
+  }
+
+  // move the window to start at newLow, entries falling out of it are passed to evict(key, T)
+  // and removed
+  template <typename F> void moveTo(int64_t newLow, F &&evict) {
+    if (count != 0) {
+      // keys in the old window but not in the new one
+      int64_t first = lo, last = lo;
+      if (newLow > lo) {
+        last = std::min(newLow, high());
+      } else if (newLow < lo) {
+        first = std::max(newLow + int64_t(Size), lo);
+        last = high();
+      }
+      for (int64_t key = next(first); key < last; key = next(key + 1)) {
+        T t = get(key);
+        reset(key);
+        evict(key, t);
+      }
+    }
+    lo = newLow;
+  }
+
+private:
+  int64_t toKey(size_t slot) const { return lo + int64_t((slot - lo) & Mask); }
+
+  // first occupied slot in [begin, end), NotFound if none
+  size_t findFirst(size_t begin, size_t end) const {
+    if (begin >= end) {
+      return NotFound;
+    }
+    size_t word = begin / 64;
+    uint64_t w = bits[word] & (~uint64_t(0) << (begin % 64));
+    if (w == 0) {
+      uint64_t s = word + 1 < 64 ? summary & (~uint64_t(0) << (word + 1)) : 0;
+      if (s == 0) {
+        return NotFound;
+      }
+      word = std::countr_zero(s);
+      w = bits[word];
+    }
+    size_t slot = word * 64 + std::countr_zero(w);
+    return slot < end ? slot : NotFound;
+  }
+
+  // last occupied slot in [begin, end), NotFound if none
+  size_t findLast(size_t begin, size_t end) const {
+    if (begin >= end) {
+      return NotFound;
+    }
+    size_t word = (end - 1) / 64;
+    uint64_t w = bits[word] & (~uint64_t(0) >> (63 - (end - 1) % 64));
+    if (w == 0) {
+      uint64_t s = summary & ((uint64_t(1) << word) - 1);
+      if (s == 0) {
+        return NotFound;
+      }
+      word = 63 - std::countl_zero(s);
+      w = bits[word];
+    }
+    size_t slot = word * 64 + 63 - std::countl_zero(w);
+    return slot >= begin ? slot : NotFound;
+  }
+
+  std::unique_ptr<T[]> slots;
+  // bit per slot, set if occupied
+  uint64_t bits[Words] = {};
+  // bit per word of bits, set if the word is non-zero
+  uint64_t summary = 0;
+  size_t count = 0;
+  int64_t lo = 0;
+};
+
+} // namespace bookproj
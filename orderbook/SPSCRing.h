@@ -0,0 +1,95 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <thread>
+
+namespace bookproj {
+// SPSCRing is a bounded lock-free queue between one producer and one consumer thread.  The
+// consumer reads items in place, as a span of the ones readable without wrapping around, so a
+// batch can be handed on without copying.  The producer closes the ring after its last push.
+// Waiting for room or items yields the thread, the threads may share a core.
+template <typename T> class SPSCRing {
+public:
+  // capacity is rounded up to a power of 2
+  explicit SPSCRing(size_t capacity)
+      : size(std::bit_ceil(capacity)), mask(size - 1), slots(new T[size]) {}
+
+  SPSCRing(const SPSCRing &) = delete;
+  SPSCRing &operator=(const SPSCRing &) = delete;
+
+  // producer, wait until there is room for t
+  void push(const T &t) {
+    while (!tryPush(t)) {
+      std::this_thread::yield();
+    }
+  }
+
+  // producer, false if the ring is full
+  bool tryPush(const T &t) {
+    assert(!closed.load(std::memory_order_relaxed));
+    const size_t tail = producer.tail;
+    if (tail - producer.headCache == size) {
+      producer.headCache = consumer.head.load(std::memory_order_acquire);
+      if (tail - producer.headCache == size) {
+        return false;
+      }
+    }
+    slots[tail & mask] = t;
+    producer.tail = tail + 1;
+    published.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // producer, no more pushes
+  void close() { closed.store(true, std::memory_order_release); }
+
+  // consumer, wait for items and return the ones up to the end of the buffer.  Empty once the
+  // ring is closed and all items are popped
+  std::span<const T> front() {
+    const size_t head = consumer.head.load(std::memory_order_relaxed);
+    while (consumer.tailCache == head) {
+      // closed is read before the tail, so no item pushed before close is missed
+      const bool isClosed = closed.load(std::memory_order_acquire);
+      consumer.tailCache = published.load(std::memory_order_acquire);
+      if (consumer.tailCache != head) {
+        break;
+      }
+      if (isClosed) {
+        return {};
+      }
+      std::this_thread::yield();
+    }
+    const size_t begin = head & mask;
+    return {slots.get() + begin, std::min(consumer.tailCache - head, size - begin)};
+  }
+
+  // consumer, release n items returned by front
+  void pop(size_t n) {
+    const size_t head = consumer.head.load(std::memory_order_relaxed);
+    assert(n <= consumer.tailCache - head);
+    consumer.head.store(head + n, std::memory_order_release);
+  }
+
+private:
+  const size_t size;
+  const size_t mask;
+  std::unique_ptr<T[]> slots;
+
+  // producer and consumer state on separate cache lines, each caches the other's index
+  struct alignas(64) Producer {
+    size_t tail = 0;
+    size_t headCache = 0;
+  } producer;
+  alignas(64) std::atomic<size_t> published = 0;
+  alignas(64) std::atomic<bool> closed = false;
+  struct alignas(64) Consumer {
+    std::atomic<size_t> head = 0;
+    size_t tailCache = 0;
+  } consumer;
+};
+} // namespace bookproj
\ No newline at end of file
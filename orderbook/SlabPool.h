@@ -0,0 +1,259 @@
+#pragma once
+#include "ObjectPool.h"
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bookproj {
+// SlabPool allocates objects of T in slabs of SlabSize slots, the slabs coming from an ObjectPool.
+// An object is created next to another one, in the slab of that one while it has a free slot, so
+// that runs of objects used together, e.g. the orders of a price level, sit together in memory
+// instead of wherever the last free slot was.  Other objects share slabs with free slots, those
+// left by destroyed objects first, except that long runs go on in slabs of their own, so that
+// short runs do not take a slab each.  A slab goes back to the ObjectPool when its last object is
+// destroyed.  Objects are addressed by handles with 32-bit indices, the slab index
+// times SlabSize plus the slot, below 2^31 as those of ObjectPool.  T must be trivially copyable,
+// compact moves objects bytewise
+template <typename T, size_t SlabSize> class SlabPool {
+  static_assert(std::has_single_bit(SlabSize) && SlabSize <= 32);
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  using Handle = PoolHandle<T>;
+  using Index = typename Handle::Index;
+
+private:
+  struct Slab {
+    Slab() {}
+    // compact copies the objects of a slab moved one by one, see moveObject
+    Slab(Slab &&) noexcept {}
+
+    alignas(T) std::byte slots[SlabSize][sizeof(T)];
+  };
+  using SlabHandle = typename ObjectPool<Slab>::Handle;
+
+  static constexpr int SlotBits = std::countr_zero(SlabSize);
+  static constexpr Index SlotMask = SlabSize - 1;
+  static constexpr uint32_t FullMask = uint32_t(~uint64_t(0) >> (64 - SlabSize));
+  // slab indices are below this, so that object indices stay below 2^31
+  static constexpr Index SlabLimit = Index(1) << (31 - SlotBits);
+  static constexpr Index NoSlab = ~Index(0);
+
+public:
+  // slabsPerChunk is slabs to allocate in one go
+  explicit SlabPool(size_t slabsPerChunk) noexcept
+      : slabs(slabsPerChunk), slabsPerChunk(slabsPerChunk) {}
+
+  SlabPool(const SlabPool &) = delete;
+  SlabPool &operator=(const SlabPool &) = delete;
+
+  // allocate chunks from provider, which must outlive the pool.  Must be called before any
+  // chunk is allocated
+  void setChunkProvider(ChunkProvider &p) { slabs.setChunkProvider(p); }
+
+  // construct an object next to the one of handle near.  If near is null or its slab is full, it
+  // goes to a new slab if ownSlab, else to a shared one.  Return its handle and address
+  template <typename... Args>
+  std::pair<Handle, T *> create(Handle near, bool ownSlab, Args &&...args) {
+    Index slab;
+    if (near && used[near.index() >> SlotBits] != FullMask) [[likely]] {
+      slab = near.index() >> SlotBits;
+    } else if (ownSlab) {
+      slab = newSlab();
+    } else {
+      slab = partialSlab();
+    }
+    const Index slot = Index(std::countr_one(used[slab]));
+    used[slab] |= uint32_t(1) << slot;
+    ++count;
+    T *t = new (slabs[SlabHandle(slab)]->slots[slot]) T(std::forward<Args>(args)...);
+    return {Handle((slab << SlotBits) | slot), t};
+  }
+
+  void destroy(Handle handle) {
+    (*this)[handle]->~T();
+    --count;
+    const Index slab = handle.index() >> SlotBits;
+    if ((used[slab] &= ~(uint32_t(1) << (handle.index() & SlotMask))) == 0) {
+      slabs.destroy(SlabHandle(slab));
+    } else {
+      addPartial(slab);
+    }
+  }
+
+  // address of a live object
+  T *operator[](Handle handle) const {
+    return std::launder(reinterpret_cast<T *>(
+        slabs[SlabHandle(handle.index() >> SlotBits)]->slots[handle.index() & SlotMask]));
+  }
+
+  // reserve slabs for nobjs objects
+  void reserve(size_t nobjs) {
+    slabs.reserve((nobjs + SlabSize - 1) / SlabSize);
+    grown();
+  }
+
+  // move up to maxMoves objects out of the last chunk and give back the chunks that become empty.
+  // Whole slabs are moved first, see ObjectPool::compact, which keeps their objects together,
+  // a slab counting a move per object.  Once the other chunks have no free slabs left for them,
+  // the objects of the last chunk are moved one by one to free slots of the others, as long as
+  // those have room for all of them and a quarter chunk more.  moved(from, to) is called for each
+  // object moved, after it is copied to its new handle.  Returns false once there is nothing to
+  // compact
+  template <typename Moved> bool compact(size_t maxMoves, Moved &&moved) {
+    const bool more = slabs.compact(
+        maxMoves,
+        [&](SlabHandle from, SlabHandle to) {
+          const uint32_t mask = used[to.index()] = std::exchange(used[from.index()], 0);
+          for (uint32_t bits = mask; bits != 0; bits &= bits - 1) {
+            const Index slot = Index(std::countr_zero(bits));
+            moveObject(Handle((from.index() << SlotBits) | slot),
+                       Handle((to.index() << SlotBits) | slot), moved);
+          }
+          if (mask != FullMask) {
+            addPartial(to.index());
+          }
+        },
+        [&](SlabHandle slab) { return size_t(std::popcount(used[slab.index()])); });
+    return more || merge(maxMoves, moved);
+  }
+
+  // all handle indices handed out so far are below this, for arrays kept in parallel to the pool
+  size_t indexLimit() const { return slabs.indexLimit() << SlotBits; }
+
+  size_t numAllocated() const { return count; }
+  size_t numSlabs() const { return slabs.numAllocated(); }
+  size_t numChunks() const { return slabs.numChunks(); }
+  ChunkCounts chunkCounts() const { return slabs.chunkCounts(); }
+
+private:
+  // a slab with a free slot to share, the last one listed or a new one
+  Index partialSlab() {
+    while (!partial.empty()) {
+      const Index slab = partial.back();
+      if (used[slab] != 0 && used[slab] != FullMask) [[likely]] {
+        return slab;
+      }
+      // full again, or given back
+      partial.pop_back();
+      listed[slab] = false;
+    }
+    const Index slab = newSlab();
+    addPartial(slab);
+    return slab;
+  }
+
+  Index newSlab() {
+    const SlabHandle slab = slabs.create().first;
+    if (slab.index() >= SlabLimit) [[unlikely]] {
+      slabs.destroy(slab);
+      throw std::bad_alloc();
+    }
+    if (slab.index() >= used.size()) [[unlikely]] {
+      grown();
+    }
+    return slab.index();
+  }
+
+  // list a slab with free slots, unless it is listed already
+  void addPartial(Index slab) {
+    if (!listed[slab]) {
+      listed[slab] = true;
+      partial.push_back(slab);
+    }
+  }
+
+  void grown() {
+    used.resize(slabs.indexLimit());
+    listed.resize(slabs.indexLimit());
+  }
+
+  // move up to maxMoves objects of the last chunk to free slots of the others, returns false if
+  // there is nothing to move or no room for it
+  template <typename Moved> bool merge(size_t maxMoves, Moved &moved) {
+    if (slabs.numChunks() < 2) {
+      return false;
+    }
+    // slabs of the last chunk are in [first, first + slabsPerChunk)
+    const Index first = Index(slabs.indexLimit() - slabs.indexLimit() / slabs.numChunks());
+    const Index last = first + Index(slabsPerChunk);
+    size_t lastObjs = 0;
+    for (Index slab = first; slab < last; ++slab) {
+      lastObjs += std::popcount(used[slab]);
+    }
+    const size_t othersSize = (slabs.numChunks() - 1) * slabsPerChunk * SlabSize;
+    const size_t freeOthers = othersSize - (count - lastObjs);
+    if (lastObjs == 0) {
+      // emptied by a merge before, the others may have too few free slabs for slabs.compact
+      return slabs.releaseEmptyLast();
+    }
+    if (freeOthers < lastObjs + slabsPerChunk * SlabSize / 4) {
+      return false;
+    }
+    for (Index slab = first; slab < last && maxMoves != 0; ++slab) {
+      while (used[slab] != 0 && maxMoves != 0) {
+        const Handle from((slab << SlotBits) | Index(std::countr_zero(used[slab])));
+        const Index to = otherSlab(first);
+        if (to == NoSlab) {
+          // the free slots left are in slabs of runs, which are listed once one of their
+          // objects is destroyed
+          return false;
+        }
+        const Index toSlot = Index(std::countr_one(used[to]));
+        used[to] |= uint32_t(1) << toSlot;
+        ++count;
+        moveObject(from, Handle((to << SlotBits) | toSlot), moved);
+        destroy(from);
+        --maxMoves;
+      }
+    }
+    return true;
+  }
+
+  // copy an object to its new slot and let moved point references to it there.  Objects are
+  // copied one at a time, so that moved sees the others of a slab where their references are
+  template <typename Moved> void moveObject(Handle from, Handle to, Moved &moved) {
+    std::memcpy(static_cast<void *>((*this)[to]), (*this)[from], sizeof(T));
+    moved(from, to);
+  }
+
+  // a slab with a free slot before first, a listed one or a new one, NoSlab if none
+  Index otherSlab(Index first) {
+    while (!partial.empty()) {
+      const Index slab = partial.back();
+      if (slab < first && used[slab] != 0 && used[slab] != FullMask) {
+        return slab;
+      }
+      partial.pop_back();
+      listed[slab] = false;
+    }
+    if (slabs.numFree() == 0) {
+      return NoSlab;
+    }
+    // slabs are created in the lowest chunk with a free one
+    const SlabHandle slab = slabs.create().first;
+    if (slab.index() >= first) {
+      slabs.destroy(slab);
+      return NoSlab;
+    }
+    addPartial(slab.index());
+    return slab.index();
+  }
+
+  ObjectPool<Slab> slabs;
+  const size_t slabsPerChunk;
+  // bit per slot of each slab, set if it holds an object
+  std::vector<uint32_t> used;
+  // slabs that had free slots when listed, the last one listed is shared.  Slabs are listed once,
+  // those full or given back since are dropped lazily
+  std::vector<Index> partial;
+  std::vector<bool> listed;
+  size_t count = 0;
+};
+} // namespace bookproj
\ No newline at end of file
@@ -0,0 +1,160 @@
+#pragma once
+#include <absl/log/log.h>
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace bookproj {
+
+// SlidingWindow stores objects directly in an array of slots indexed by an integer key.  It
+// covers keys in [base, base + capacity), capacity is a power of 2 so that key maps to slot
+// key & (capacity - 1) without any hashing.  It suits keys handed out in nearly increasing order,
+// such as order reference numbers: the window is moved forward as keys grow, objects falling off
+// its low end are handed to a callback to be moved elsewhere.  Keys outside of the window are left
+// to the caller.
+template <typename T> class SlidingWindow {
+  struct Slot {
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+
+  static constexpr size_t WordBits = 64;
+
+public:
+  SlidingWindow() = default;
+  SlidingWindow(const SlidingWindow &) = delete;
+  SlidingWindow &operator=(const SlidingWindow &) = delete;
+
+  ~SlidingWindow() {
+    if (count != 0) {
+      LOG(ERROR) << count << " objects are not destroyed at destruction of SlidingWindow";
+    }
+  }
+
+  // (re)allocate the slots, capacity is rounded up to a power of 2 no less than 64, 0 releases
+  // the slots.  Must be called when the window is empty
+  void reset(size_t capacity) {
+    assert(count == 0);
+    if (capacity != 0) {
+      capacity = std::bit_ceil(std::max(capacity, WordBits));
+    }
+    slots.reset(capacity ? new Slot[capacity] : nullptr);
+    occupied.assign(capacity / WordBits, 0);
+    mask = capacity - 1;
+    cap = capacity;
+    lo = 0;
+  }
+
+  size_t capacity() const { return cap; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  uint64_t base() const { return lo; }
+
+  // true if key is within [base, base + capacity)
+  bool inRange(uint64_t key) const { return key - lo < cap; }
+
+  // true if t is stored in one of the slots
+  bool owns(const T *t) const {
+    auto p = reinterpret_cast<const Slot *>(t);
+    return p >= slots.get() && p < slots.get() + cap;
+  }
+
+  // slot of an object owned by the window
+  size_t slotOf(const T *t) const {
+    assert(owns(t));
+    return reinterpret_cast<const Slot *>(t) - slots.get();
+  }
+
+  // object in an occupied slot
+  T *at(size_t slot) const {
+    assert(isOccupied(slot));
+    return std::launder(reinterpret_cast<T *>(slots[slot].storage));
+  }
+
+  // slot key maps to if it is in range
+  size_t slotOfKey(uint64_t key) const { return key & mask; }
+
+  // prefetch the slot of key and its occupied bit, key must be in range
+  void prefetch(uint64_t key) const {
+    assert(inRange(key));
+    const size_t slot = key & mask;
+    __builtin_prefetch(slots.get() + slot);
+    __builtin_prefetch(&occupied[slot / WordBits]);
+  }
+
+  // find object of key, key must be in range
+  T *find(uint64_t key) const {
+    assert(inRange(key));
+    size_t slot = key & mask;
+    return isOccupied(slot) ? at(slot) : nullptr;
+  }
+
+  // construct an object for key, key must be in range and not occupied
+  template <typename... Args> T *emplace(uint64_t key, Args &&...args) {
+    assert(inRange(key) && find(key) == nullptr);
+    size_t slot = key & mask;
+    occupied[slot / WordBits] |= uint64_t(1) << (slot % WordBits);
+    ++count;
+    return new (slots[slot].storage) T(std::forward<Args>(args)...);
+  }
+
+  // destroy an object owned by the window
+  void erase(T *t) {
+    assert(owns(t));
+    size_t slot = slotOf(t);
+    t->~T();
+    occupied[slot / WordBits] &= ~(uint64_t(1) << (slot % WordBits));
+    --count;
+  }
+
+  // move the window forward so that it starts at newBase.  Each object whose key falls below
+  // newBase is passed to evict(T &) before it is destroyed, evict is expected to move it out
+  template <typename F> void advance(uint64_t newBase, F &&evict) {
+    assert(newBase >= lo);
+    const uint64_t end = newBase - lo < cap ? newBase : lo + cap;
+    for (uint64_t key = lo; key < end && count != 0;) {
+      const size_t slot = key & mask;
+      const size_t bit = slot % WordBits;
+      const size_t nbits = std::min<uint64_t>(WordBits - bit, end - key);
+      uint64_t word = occupied[slot / WordBits] >> bit;
+      if (nbits < WordBits) {
+        word &= (uint64_t(1) << nbits) - 1;
+      }
+      while (word != 0) {
+        T *t = at(slot + std::countr_zero(word));
+        word &= word - 1;
+        evict(*t);
+        erase(t);
+      }
+      key += nbits;
+    }
+    lo = newBase;
+  }
+
+  // call f(T &) on all objects in slot order
+  template <typename F> void forEach(F &&f) const {
+    for (size_t ii = 0; ii < occupied.size(); ++ii) {
+      for (uint64_t word = occupied[ii]; word != 0; word &= word - 1) {
+        f(*at(ii * WordBits + std::countr_zero(word)));
+      }
+    }
+  }
+
+private:
+  bool isOccupied(size_t slot) const {
+    return (occupied[slot / WordBits] >> (slot % WordBits)) & 1;
+  }
+
+  std::unique_ptr<Slot[]> slots;
+  // one bit per slot, set if the slot holds a live object
+  std::vector<uint64_t> occupied;
+  size_t mask = 0;
+  size_t cap = 0;
+  size_t count = 0;
+  uint64_t lo = 0;
+};
+} // namespace bookproj
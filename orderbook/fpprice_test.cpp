@@ -0,0 +1,67 @@
+#include "FPPrice.h"
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace bookproj;
+using Price = FPPrice<int64_t, 8>;
+using OrderPrice = FPPrice<int32_t, 4>;
+
+static_assert(Price::fromScaled<4>(uint32_t(123400)) == Price::fromRaw(1234000000));
+static_assert(OrderPrice::fromScaled<4>(uint32_t(123400)) == OrderPrice::fromRaw(123400));
+
+// an itch Price4 converted as before fromScaled, through its double value
+static Price viaDouble(uint32_t scaled) { return Price(scaled * 1e-4); }
+
+TEST_CASE("fromScaled") {
+  CHECK(Price::fromScaled<4>(uint32_t(0)) == Price(0.0));
+  CHECK(Price::fromScaled<4>(uint32_t(1)) == Price(0.0001));
+  CHECK(Price::fromScaled<8>(int64_t(-150)) == Price::fromRaw(-150));
+  CHECK(Price::fromScaled<0>(-3) == Price(-3.0));
+  CHECK(OrderPrice::fromScaled<2>(1234) == OrderPrice(12.34));
+
+  // dropping decimals rounds half away from zero
+  CHECK(OrderPrice::fromScaled<6>(123450) == OrderPrice::fromRaw(1235));
+  CHECK(OrderPrice::fromScaled<6>(123449) == OrderPrice::fromRaw(1234));
+  CHECK(OrderPrice::fromScaled<6>(-123450) == OrderPrice::fromRaw(-1235));
+  CHECK(OrderPrice::fromScaled<6>(uint64_t(123450)) == OrderPrice::fromRaw(1235));
+
+  // same as the double round trip over the Price4 range
+  std::vector<uint32_t> prices{0, 1, 9999, 10000, 1999990000, 2000000000, ~uint32_t(0)};
+  std::mt19937 rng(1);
+  for (int ii = 0; ii < 1000000; ++ii) {
+    prices.push_back(rng());
+  }
+  size_t mismatches = 0;
+  for (uint32_t price : prices) {
+    mismatches += Price::fromScaled<4>(price) != viaDouble(price);
+  }
+  CHECK(mismatches == 0);
+}
+
+// run with fpprice_test "[benchmark]"
+TEST_CASE("fromScaled benchmark", "[.][benchmark]") {
+  // prices up to $2000
+  std::vector<uint32_t> prices(4096);
+  std::mt19937 rng(1);
+  for (auto &price : prices) {
+    price = rng() % 20000000;
+  }
+
+  BENCHMARK("double round trip") {
+    int64_t sum = 0;
+    for (uint32_t price : prices) {
+      sum += Price::toRaw(viaDouble(price));
+    }
+    return sum;
+  };
+  BENCHMARK("fromScaled") {
+    int64_t sum = 0;
+    for (uint32_t price : prices) {
+      sum += Price::toRaw(Price::fromScaled<4>(price));
+    }
+    return sum;
+  };
+}
\ No newline at end of file
@@ -1,5 +1,11 @@
 #include "OrderBook.h"
 #include <algorithm>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <sstream>
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_session.hpp>
 #include <catch2/catch_test_macros.hpp>
 
@@ -11,33 +17,40 @@ int main(int argc, char *argv[]) {
 using namespace bookproj::orderbook;
 
 struct Listener : public BookListener {
-
-  std::vector<std::tuple<BookID, const Order *>> newOrders;
-  std::vector<std::tuple<BookID, const Order *, Quantity>> deleteOrders;
-  std::vector<std::tuple<BookID, const Order *, const Order *>> replaceOrders;
-  std::vector<std::tuple<BookID, const Order *, Quantity, Quantity, Price>> execOrders;
-  std::vector<std::tuple<BookID, const Order *, Quantity, Price>> updateOrders;
+  // orders passed to listeners are views that only live for the callback, keep refNums
+  std::vector<std::tuple<BookID, ReferenceNum>> newOrders;
+  std::vector<std::tuple<BookID, ReferenceNum, Quantity>> deleteOrders;
+  std::vector<std::tuple<BookID, ReferenceNum, ReferenceNum>> replaceOrders;
+  std::vector<std::tuple<BookID, ReferenceNum, Quantity, Quantity, Price>> execOrders;
+  std::vector<std::tuple<BookID, ReferenceNum, Quantity, Price>> updateOrders;
+  // copy of the last order seen
+  std::optional<Order> lastOrder;
 
   void onNewOrder(BookID book, const Order *order) override {
-    newOrders.emplace_back(book, order);
+    newOrders.emplace_back(book, order->refNum);
+    lastOrder = *order;
   }
 
   void onDeleteOrder(BookID book, const Order *order, Quantity oldQuantity) override {
-    deleteOrders.emplace_back(book, order, oldQuantity);
+    deleteOrders.emplace_back(book, order->refNum, oldQuantity);
+    lastOrder = *order;
   }
 
   void onReplaceOrder(BookID book, const Order *order, const Order *oldOrder) override {
-    replaceOrders.emplace_back(book, order, oldOrder);
+    replaceOrders.emplace_back(book, order->refNum, oldOrder->refNum);
+    lastOrder = *order;
   }
 
   void onExecOrder(BookID book, const Order *order, Quantity oldQuantity, Quantity fillQuantity,
                    const ExecInfo &ei) override {
-    execOrders.emplace_back(book, order, oldQuantity, fillQuantity, ei.price);
+    execOrders.emplace_back(book, order->refNum, oldQuantity, fillQuantity, ei.price);
+    lastOrder = *order;
   }
 
   void onUpdateOrder(BookID book, const Order *order, Quantity oldQuantity,
                      Price oldPrice) override {
-    updateOrders.emplace_back(book, order, oldQuantity, oldPrice);
+    updateOrders.emplace_back(book, order->refNum, oldQuantity, oldPrice);
+    lastOrder = *order;
   }
 };
 
@@ -59,12 +72,12 @@ TEST_CASE("Basic") {
   CHECK(level1->totalShares == 100);
   CHECK(level1->numOrders() == 1);
   CHECK(&level1->front() == order1);
-  CHECK(order1->refNum == ReferenceNum(1));
+  CHECK(book.refNumOf(order1) == ReferenceNum(1));
   CHECK(order1->quantity == 100);
   CHECK(order1->price == 100.0);
-  CHECK(order1->cid == CID(0));
-  CHECK(order1->side == Side::Bid);
-  CHECK(order1->level == level1);
+  CHECK(book.toOrder(order1).cid == CID(0));
+  CHECK(book.toOrder(order1).side == Side::Bid);
+  CHECK(book.levelOf(order1) == level1);
   CHECK(book.nthLevel(CID(0), Side::Bid, 0) == level1);
   CHECK(book.nthLevel(CID(0), Side::Bid, 1) == nullptr);
   CHECK(book.getLevel(CID(0), Side::Bid, 100.0) == level1);
@@ -84,12 +97,12 @@ TEST_CASE("Basic") {
   CHECK(level2->totalShares == 100);
   CHECK(level2->numOrders() == 1);
   CHECK(&level2->front() == order2);
-  CHECK(order2->refNum == ReferenceNum(2));
+  CHECK(book.refNumOf(order2) == ReferenceNum(2));
   CHECK(order2->quantity == 100);
   CHECK(order2->price == 102.00);
-  CHECK(order2->cid == CID(1));
-  CHECK(order2->side == Side::Ask);
-  CHECK(order2->level == level2);
+  CHECK(book.toOrder(order2).cid == CID(1));
+  CHECK(book.toOrder(order2).side == Side::Ask);
+  CHECK(book.levelOf(order2) == level2);
   CHECK(book.numOrders() == 2);
 
   // new better order on bid side, best bid is updated
@@ -103,12 +116,12 @@ TEST_CASE("Basic") {
   auto order3 = book.findOrder(ReferenceNum(3));
   REQUIRE(order3 != nullptr);
   CHECK(&level3->front() == order3);
-  CHECK(order3->refNum == ReferenceNum(3));
+  CHECK(book.refNumOf(order3) == ReferenceNum(3));
   CHECK(order3->quantity == 100);
   CHECK(order3->price == 101.00);
-  CHECK(order3->cid == CID(0));
-  CHECK(order3->side == Side::Bid);
-  CHECK(order3->level == level3);
+  CHECK(book.toOrder(order3).cid == CID(0));
+  CHECK(book.toOrder(order3).side == Side::Bid);
+  CHECK(book.levelOf(order3) == level3);
   CHECK(book.topLevel(CID(0), Side::Bid) == level3);
   CHECK(book.nthLevel(CID(0), Side::Bid, 0) == level3);
   CHECK(book.nthLevel(CID(0), Side::Bid, 1) == level1);
@@ -126,12 +139,12 @@ TEST_CASE("Basic") {
   auto order4 = book.findOrder(ReferenceNum(4));
   REQUIRE(order4 != nullptr);
   CHECK(&level4->front() == order4);
-  CHECK(order4->refNum == ReferenceNum(4));
+  CHECK(book.refNumOf(order4) == ReferenceNum(4));
   CHECK(order4->quantity == 100);
   CHECK(order4->price == 103.00);
-  CHECK(order4->cid == CID(1));
-  CHECK(order4->side == Side::Ask);
-  CHECK(order4->level == level4);
+  CHECK(book.toOrder(order4).cid == CID(1));
+  CHECK(book.toOrder(order4).side == Side::Ask);
+  CHECK(book.levelOf(order4) == level4);
   CHECK(book.topLevel(CID(1), Side::Ask) == level2);
   CHECK(book.nthLevel(CID(1), Side::Ask, 0) == level2);
   CHECK(book.nthLevel(CID(1), Side::Ask, 1) == level4);
@@ -177,18 +190,18 @@ TEST_CASE("Basic") {
   CHECK(book.findOrder(ReferenceNum(1)) == nullptr);
   auto order5 = book.findOrder(ReferenceNum(5));
   REQUIRE(order5 != nullptr);
-  CHECK(order5->refNum == ReferenceNum(5));
+  CHECK(book.refNumOf(order5) == ReferenceNum(5));
   CHECK(order5->quantity == 80);
   CHECK(order5->price == 101.10);
-  CHECK(order5->cid == CID(0));
-  CHECK(order5->side == Side::Bid);
+  CHECK(book.toOrder(order5).cid == CID(0));
+  CHECK(book.toOrder(order5).side == Side::Bid);
   auto level5 = book.getLevel(CID(0), Side::Bid, 101.10);
   REQUIRE(level5 != nullptr);
   CHECK(level5->price == 101.10);
   CHECK(level5->totalShares == 80);
   CHECK(level5->numOrders() == 1);
   CHECK(&level5->front() == order5);
-  CHECK(order5->level == level5);
+  CHECK(book.levelOf(order5) == level5);
   CHECK(book.topLevel(CID(0), Side::Bid) == level5);
   CHECK(book.nthLevel(CID(0), Side::Bid, 0) == level5);
   CHECK(book.nthLevel(CID(0), Side::Bid, 1) == level3);
@@ -215,7 +228,7 @@ TEST_CASE("listener") {
   book.resize(CID(2));
   auto order1 = book.newOrder(ReferenceNum(1), CID(0), Side::Bid, 100, 100.00, Timestamp{});
   CHECK(listener.newOrders.size() == 1);
-  CHECK((listener.newOrders[0] == std::tuple(BookID(1), order1)));
+  CHECK((listener.newOrders[0] == std::tuple(BookID(1), ReferenceNum(1))));
   listener.newOrders.clear();
 
   ExecInfo ei;
@@ -223,49 +236,55 @@ TEST_CASE("listener") {
   ei.price = 100.00;
   book.executeOrder(order1, 10, ei, Timestamp{});
   CHECK(listener.execOrders.size() == 1);
-  CHECK((listener.execOrders[0] == std::tuple(BookID(1), order1, 100, 10, 100.00)));
+  CHECK((listener.execOrders[0] == std::tuple(BookID(1), ReferenceNum(1), 100, 10, 100.00)));
   listener.execOrders.clear();
 
   ei.price = 100.10;
-  book.executeOrder(order1->refNum, 5, ei, Timestamp{});
+  book.executeOrder(book.refNumOf(order1), 5, ei, Timestamp{});
   CHECK(listener.execOrders.size() == 1);
-  CHECK((listener.execOrders[0] == std::tuple(BookID(1), order1, 90, 5, 100.10)));
+  CHECK((listener.execOrders[0] == std::tuple(BookID(1), ReferenceNum(1), 90, 5, 100.10)));
   CHECK(order1->quantity == 85);
   CHECK(order1->price == 100.00);
   listener.execOrders.clear();
 
-  book.reduceOrderBy(order1->refNum, 10, Timestamp{});
+  book.reduceOrderBy(book.refNumOf(order1), 10, Timestamp{});
   CHECK(listener.updateOrders.size() == 1);
-  CHECK((listener.updateOrders[0] == std::tuple(BookID(1), order1, 85, 100.00)));
+  CHECK((listener.updateOrders[0] == std::tuple(BookID(1), ReferenceNum(1), 85, 100.00)));
   CHECK(order1->quantity == 75);
   CHECK(order1->price == 100.00);
   listener.updateOrders.clear();
 
   book.reduceOrderTo(order1, 10, Timestamp{});
   CHECK(listener.updateOrders.size() == 1);
-  CHECK((listener.updateOrders[0] == std::tuple(BookID(1), order1, 75, 100.00)));
+  CHECK((listener.updateOrders[0] == std::tuple(BookID(1), ReferenceNum(1), 75, 100.00)));
   CHECK(order1->quantity == 10);
   CHECK(order1->price == 100.00);
   listener.updateOrders.clear();
 
-  auto order2 = book.replaceOrder(order1->refNum, ReferenceNum(2), 20, 100.10, Timestamp{});
+  auto order2 = book.replaceOrder(book.refNumOf(order1), ReferenceNum(2), 20, 100.10, Timestamp{});
   CHECK(listener.replaceOrders.size() == 1);
-  CHECK((listener.replaceOrders[0] == std::tuple(BookID(1), order1, order2)));
-  CHECK(order2->refNum == ReferenceNum(2));
+  CHECK((listener.replaceOrders[0] == std::tuple(BookID(1), ReferenceNum(1), ReferenceNum(2))));
+  REQUIRE(listener.lastOrder.has_value());
+  CHECK(listener.lastOrder->refNum == ReferenceNum(1));
+  CHECK(listener.lastOrder->cid == CID(0));
+  CHECK(listener.lastOrder->side == Side::Bid);
+  CHECK(listener.lastOrder->quantity == 10);
+  CHECK(listener.lastOrder->price == 100.00);
+  CHECK(book.refNumOf(order2) == ReferenceNum(2));
   CHECK(order2->quantity == 20);
   CHECK(order2->price == 100.10);
-  CHECK(order2->cid == CID(0));
-  CHECK(order2->side == Side::Bid);
+  CHECK(book.toOrder(order2).cid == CID(0));
+  CHECK(book.toOrder(order2).side == Side::Bid);
   listener.replaceOrders.clear();
 
-  book.deleteOrder(order2->refNum, Timestamp{});
+  book.deleteOrder(book.refNumOf(order2), Timestamp{});
   CHECK(listener.deleteOrders.size() == 1);
-  CHECK((listener.deleteOrders[0] == std::tuple(BookID(1), order2, 20)));
+  CHECK((listener.deleteOrders[0] == std::tuple(BookID(1), ReferenceNum(2), 20)));
   listener.deleteOrders.clear();
 
   auto order3 = book.newOrder(ReferenceNum(3), CID(1), Side::Bid, 100, 102.00, Timestamp{});
   CHECK(listener.newOrders.size() == 1);
-  CHECK((listener.newOrders[0] == std::tuple(BookID(1), order3)));
+  CHECK((listener.newOrders[0] == std::tuple(BookID(1), book.refNumOf(order3))));
   listener.newOrders.clear();
 
   // replace an unknown refnum
@@ -278,7 +297,7 @@ TEST_CASE("listener") {
   book.clearBook(CID(1));
   CHECK(listener.deleteOrders.size() == 1);
   CHECK(std::find(listener.deleteOrders.begin(), listener.deleteOrders.end(),
-                  std::tuple(BookID(1), order3, 100)) != listener.deleteOrders.end());
+                  std::tuple(BookID(1), ReferenceNum(3), 100)) != listener.deleteOrders.end());
   listener.deleteOrders.clear();
   book.removeListener(&listener);
 
@@ -300,24 +319,24 @@ TEST_CASE("priority") {
   CHECK(level->price == 100.00);
   CHECK(level->totalShares == 500);
   CHECK(level->numOrders() == 5);
-  CHECK(level->front().refNum == ReferenceNum(10));
-  CHECK(level->back().refNum == ReferenceNum(50));
+  CHECK(book.refNumOf(&level->front()) == ReferenceNum(10));
+  CHECK(book.refNumOf(&level->back()) == ReferenceNum(50));
   auto oit = level->begin();
-  CHECK((*oit++).refNum == ReferenceNum(10));
-  CHECK((*oit++).refNum == ReferenceNum(20));
-  CHECK((*oit++).refNum == ReferenceNum(30));
-  CHECK((*oit++).refNum == ReferenceNum(40));
-  CHECK((*oit++).refNum == ReferenceNum(50));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(10));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(20));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(30));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(40));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(50));
   CHECK(oit == level->end());
 
   book.replaceOrder(ReferenceNum(20), ReferenceNum(22), 100, 100.00, Timestamp{});
   CHECK(level->numOrders() == 5);
   oit = level->begin();
-  CHECK((*oit++).refNum == ReferenceNum(10));
-  CHECK((*oit++).refNum == ReferenceNum(30));
-  CHECK((*oit++).refNum == ReferenceNum(40));
-  CHECK((*oit++).refNum == ReferenceNum(50));
-  CHECK((*oit++).refNum == ReferenceNum(22));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(10));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(30));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(40));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(50));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(22));
   CHECK(oit == level->end());
 
   book.deleteOrder(ReferenceNum(30), Timestamp{});
@@ -325,8 +344,8 @@ TEST_CASE("priority") {
   book.deleteOrder(ReferenceNum(50), Timestamp{});
   CHECK(level->numOrders() == 2);
   oit = level->begin();
-  CHECK((*oit++).refNum == ReferenceNum(10));
-  CHECK((*oit++).refNum == ReferenceNum(22));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(10));
+  CHECK(book.refNumOf(&*oit++) == ReferenceNum(22));
   CHECK(book.validate());
 
   book.clearBook(CID(0));
@@ -377,7 +396,7 @@ TEST_CASE("erroneous input") {
   book.resize(CID(4));
   auto order1 = book.newOrder(ReferenceNum(100), CID(0), Side::Bid, 100, 100.04, Timestamp{});
   CHECK(listener.newOrders.size() == 1);
-  CHECK((listener.newOrders[0] == std::tuple(BookID(4), order1)));
+  CHECK((listener.newOrders[0] == std::tuple(BookID(4), book.refNumOf(order1))));
   listener.newOrders.clear();
 
   book.reduceOrderBy(ReferenceNum(101), 10, Timestamp{});
@@ -396,7 +415,7 @@ TEST_CASE("erroneous input") {
   book.executeOrder(ReferenceNum(100), 101, ExecInfo{.hasPrice = true, .price = 100.03},
                     Timestamp{});
   CHECK(listener.execOrders.size() == 1);
-  CHECK((listener.execOrders[0] == std::tuple(BookID(4), order1, 100, 101, 100.03)));
+  CHECK((listener.execOrders[0] == std::tuple(BookID(4), ReferenceNum(100), 100, 101, 100.03)));
   listener.execOrders.clear();
   CHECK(book.validate());
 
@@ -407,9 +426,9 @@ TEST_CASE("erroneous input") {
 
   auto order3 = book.newOrder(ReferenceNum(102), CID(0), Side::Ask, 150, 100.04, Timestamp{});
   CHECK(listener.deleteOrders.size() == 1);
-  CHECK((listener.deleteOrders[0] == std::tuple(BookID(4), order2, 100)));
+  CHECK((listener.deleteOrders[0] == std::tuple(BookID(4), ReferenceNum(102), 100)));
   CHECK(listener.newOrders.size() == 1);
-  CHECK((listener.newOrders[0] == std::tuple(BookID(4), order3)));
+  CHECK((listener.newOrders[0] == std::tuple(BookID(4), book.refNumOf(order3))));
   listener.deleteOrders.clear();
   listener.newOrders.clear();
   CHECK(book.validate());
@@ -417,13 +436,1225 @@ TEST_CASE("erroneous input") {
   // increasing order quantity
   book.reduceOrderTo(ReferenceNum(102), 160, Timestamp{});
   CHECK(listener.updateOrders.size() == 1);
-  CHECK((listener.updateOrders[0] == std::tuple(BookID(4), order3, 150, 100.04)));
+  CHECK((listener.updateOrders[0] == std::tuple(BookID(4), ReferenceNum(102), 150, 100.04)));
   listener.updateOrders.clear();
   CHECK(book.validate());
 
   book.reduceOrderBy(ReferenceNum(102), 200, Timestamp{});
   CHECK(listener.updateOrders.size() == 1);
-  CHECK((listener.updateOrders[0] == std::tuple(BookID(4), order2, 160, 100.04)));
+  CHECK((listener.updateOrders[0] == std::tuple(BookID(4), ReferenceNum(102), 160, 100.04)));
   listener.updateOrders.clear();
   CHECK(book.validate());
+
+  // prices orders can not hold, too large, negative or finer than 0.0001, are dropped
+  const size_t numOrders = book.numOrders();
+  CHECK(book.newOrder(ReferenceNum(103), CID(1), Side::Bid, 100, 429496.7296, Timestamp{}) ==
+        nullptr);
+  CHECK(book.newOrder(ReferenceNum(104), CID(1), Side::Ask, 100, 10.00005, Timestamp{}) ==
+        nullptr);
+  book.apply(BookOp::newOrder(ReferenceNum(105), CID(1), Side::Bid, 100, -300000.00, Timestamp{}));
+  CHECK(listener.newOrders.empty());
+  CHECK(book.numOrders() == numOrders);
+  CHECK(book.half(CID(1), Side::Bid).empty());
+  CHECK(book.half(CID(1), Side::Ask).empty());
+  book.newOrder(ReferenceNum(106), CID(1), Side::Bid, 100, 10.00, Timestamp{});
+  listener.newOrders.clear();
+  CHECK(book.replaceOrder(ReferenceNum(106), ReferenceNum(107), 100, 429496.7296, Timestamp{}) ==
+        nullptr);
+  REQUIRE(listener.deleteOrders.size() == 1);
+  CHECK((listener.deleteOrders[0] == std::tuple(BookID(4), ReferenceNum(106), 100)));
+  CHECK(listener.replaceOrders.empty());
+  CHECK(book.findOrder(ReferenceNum(106)) == nullptr);
+  CHECK(book.findOrder(ReferenceNum(107)) == nullptr);
+  CHECK(book.numOrders() == numOrders);
+  // the largest price an order can hold, that of ITCH, and one of BRK.A
+  auto order4 = book.newOrder(ReferenceNum(108), CID(1), Side::Ask, 100, 429496.7295, Timestamp{});
+  REQUIRE(order4 != nullptr);
+  CHECK(book.toOrder(order4).price == 429496.7295);
+  auto order5 = book.newOrder(ReferenceNum(109), CID(1), Side::Bid, 2, 339590.00, Timestamp{});
+  REQUIRE(order5 != nullptr);
+  CHECK(book.toOrder(order5).price == 339590.00);
+  CHECK(book.topLevel(CID(1), Side::Bid)->totalShares == 2);
+  CHECK(book.validate());
+
+  // quantities orders can not hold are dropped too, rather than truncated
+  const Quantity tooLarge = (Quantity(1) << 32) + 5;
+  CHECK(book.newOrder(ReferenceNum(110), CID(1), Side::Bid, tooLarge, 10.00, Timestamp{}) ==
+        nullptr);
+  CHECK(book.newOrder(ReferenceNum(110), CID(1), Side::Bid, -5, 10.00, Timestamp{}) == nullptr);
+  CHECK(book.findOrder(ReferenceNum(110)) == nullptr);
+  book.reduceOrderTo(ReferenceNum(109), tooLarge, Timestamp{});
+  CHECK(book.findOrder(ReferenceNum(109)) == nullptr);
+  CHECK(book.half(CID(1), Side::Bid).empty());
+  CHECK(book.replaceOrder(ReferenceNum(108), ReferenceNum(111), tooLarge, 10.00, Timestamp{}) ==
+        nullptr);
+  CHECK(book.findOrder(ReferenceNum(108)) == nullptr);
+  CHECK(book.findOrder(ReferenceNum(111)) == nullptr);
+  CHECK(book.numOrders() == numOrders);
+  // the largest quantity an order can hold
+  auto order6 = book.newOrder(ReferenceNum(112), CID(1), Side::Bid, Quantity(UINT32_MAX), 10.00,
+                              Timestamp{});
+  REQUIRE(order6 != nullptr);
+  CHECK(book.toOrder(order6).quantity == UINT32_MAX);
+  CHECK(book.topLevel(CID(1), Side::Bid)->totalShares == UINT32_MAX);
+  CHECK(book.validate());
+}
+TEST_CASE("order window") {
+  OrderBook book(BookID(5));
+  book.resize(CID(2));
+  // smallest window, 64 reference numbers
+  book.reserveOrderWindow(10);
+
+  Listener listener;
+  book.addListener(&listener);
+  for (uint64_t ref = 1; ref <= 40; ++ref) {
+    book.newOrder(ReferenceNum(ref), CID(ref % 2), ref % 3 ? Side::Bid : Side::Ask, 100,
+                  100.00 + (ref % 5) * 0.01, Timestamp{});
+  }
+  CHECK(book.numOrders() == 40);
+  CHECK(book.validate());
+
+  // far above the window, goes to the hashmap as an outlier
+  book.newOrder(ReferenceNum(1000), CID(0), Side::Bid, 100, 100.00, Timestamp{});
+  CHECK(book.findOrder(ReferenceNum(1000)) != nullptr);
+  CHECK(book.validate());
+
+  // slide the window, orders 1-40 are moved out of it but keep their priority
+  for (uint64_t ref = 100; ref <= 300; ++ref) {
+    book.newOrder(ReferenceNum(ref), CID(0), Side::Bid, 10, 99.00, Timestamp{});
+    book.deleteOrder(ReferenceNum(ref), Timestamp{});
+  }
+  CHECK(book.numOrders() == 41);
+  CHECK(book.validate());
+  for (uint64_t ref = 1; ref <= 40; ++ref) {
+    auto order = book.findOrder(ReferenceNum(ref));
+    REQUIRE(order != nullptr);
+    CHECK(book.refNumOf(order) == ReferenceNum(ref));
+  }
+  auto level = book.getLevel(CID(0), Side::Bid, 100.00);
+  REQUIRE(level != nullptr);
+  CHECK(book.refNumOf(&level->front()) == ReferenceNum(10));
+  CHECK(book.refNumOf(&level->back()) == ReferenceNum(1000));
+
+  // an old reference number replaced by a new one
+  auto order = book.replaceOrder(ReferenceNum(10), ReferenceNum(301), 50, 100.00, Timestamp{});
+  REQUIRE(order != nullptr);
+  CHECK(book.findOrder(ReferenceNum(10)) == nullptr);
+  CHECK(book.refNumOf(&level->back()) == ReferenceNum(301));
+  CHECK(listener.replaceOrders.size() == 1);
+
+  // the window catches up with the outlier
+  for (uint64_t ref = 951; ref <= 1011; ref += 2) {
+    book.newOrder(ReferenceNum(ref), CID(1), Side::Ask, 10, 101.00, Timestamp{});
+  }
+  CHECK(book.validate());
+  order = book.findOrder(ReferenceNum(1000));
+  REQUIRE(order != nullptr);
+  CHECK(order->quantity == 100);
+
+  // duplicate reference number in window
+  listener.deleteOrders.clear();
+  book.newOrder(ReferenceNum(1011), CID(1), Side::Bid, 20, 98.00, Timestamp{});
+  CHECK(listener.deleteOrders.size() == 1);
+  CHECK(book.toOrder(book.findOrder(ReferenceNum(1011))).side == Side::Bid);
+  CHECK(book.validate());
+
+  // replace with the same reference number in window
+  book.replaceOrder(ReferenceNum(1011), ReferenceNum(1011), 30, 98.01, Timestamp{});
+  CHECK(book.findOrder(ReferenceNum(1011))->price == 98.01);
+  CHECK(book.validate());
+
+  book.clear(true);
+  CHECK(book.numOrders() == 0);
+  CHECK(book.validate());
+  book.removeListener(&listener);
+}
+
+TEST_CASE("price ladder") {
+  OrderBook book(BookID(6));
+  book.resize(CID(2));
+
+  auto checkHalf = [&](CID cid, Side side, std::vector<Price> expected) {
+    auto &half = book.half(cid, Side(side));
+    REQUIRE(half.size() == expected.size());
+    std::vector<Price> forward, backward;
+    for (auto iter = half.begin(); iter != half.end(); ++iter) {
+      forward.push_back(iter->first);
+      CHECK(iter->second->price == iter->first);
+    }
+    for (auto iter = half.rbegin(); iter != half.rend(); ++iter) {
+      backward.insert(backward.begin(), iter->second->price);
+    }
+    CHECK(forward == expected);
+    CHECK(backward == expected);
+    for (size_t ii = 0; ii < expected.size(); ++ii) {
+      auto level = book.nthLevel(cid, side, ii);
+      REQUIRE(level != nullptr);
+      CHECK(level->price == expected[ii]);
+      CHECK(book.getLevel(cid, side, expected[ii]) == level);
+    }
+    CHECK(book.nthLevel(cid, side, expected.size()) == nullptr);
+  };
+
+  uint64_t ref = 1;
+  auto add = [&](CID cid, Side side, Price price) {
+    book.newOrder(ReferenceNum(ref++), cid, side, 100, price, Timestamp{});
+  };
+  auto remove = [&](CID cid, Side side, Price price) {
+    auto level = book.getLevel(cid, side, price);
+    REQUIRE(level != nullptr);
+    book.deleteOrder(book.refNumOf(&level->front()), Timestamp{});
+  };
+
+  // near, far away and sub-penny prices
+  add(CID(0), Side::Bid, 50.00);
+  add(CID(0), Side::Bid, 49.99);
+  add(CID(0), Side::Bid, 1.00);
+  add(CID(0), Side::Bid, 49.995);
+  add(CID(0), Side::Bid, 48.00);
+  add(CID(0), Side::Bid, 0.0001);
+  CHECK(book.validate());
+  checkHalf(CID(0), Side::Bid, {50.00, 49.995, 49.99, 48.00, 1.00, 0.0001});
+  CHECK(book.half(CID(0), Side::Bid).overflowSize() == 3);
+
+  // a much better price moves the ladder, levels left behind go to overflow
+  add(CID(0), Side::Bid, 60.00);
+  CHECK(book.validate());
+  checkHalf(CID(0), Side::Bid, {60.00, 50.00, 49.995, 49.99, 48.00, 1.00, 0.0001});
+  CHECK(book.half(CID(0), Side::Bid).overflowSize() == 6);
+  // the top getting much worse moves the ladder back, pulling the levels out of overflow
+  remove(CID(0), Side::Bid, 60.00);
+  CHECK(book.half(CID(0), Side::Bid).overflowSize() == 3);
+  remove(CID(0), Side::Bid, 49.995);
+  checkHalf(CID(0), Side::Bid, {50.00, 49.99, 48.00, 1.00, 0.0001});
+  add(CID(0), Side::Bid, 50.01);
+  CHECK(book.validate());
+  checkHalf(CID(0), Side::Bid, {50.01, 50.00, 49.99, 48.00, 1.00, 0.0001});
+  CHECK(book.half(CID(0), Side::Bid).overflowSize() == 2);
+
+  // asks across the ring boundary and a sub-dollar ladder
+  for (int ii = 0; ii < 600; ii += 3) {
+    add(CID(1), Side::Ask, 10.00 + ii * 0.01);
+  }
+  CHECK(book.validate());
+  for (int ii = 0; ii < 300; ii += 3) {
+    remove(CID(1), Side::Ask, 10.00 + ii * 0.01);
+  }
+  std::vector<Price> asks;
+  for (int ii = 300; ii < 600; ii += 3) {
+    asks.push_back(10.00 + ii * 0.01);
+  }
+  for (Price price : {Price(11.50), Price(13.005), Price(14.51), Price(20.00)}) {
+    add(CID(1), Side::Ask, price);
+    asks.push_back(price);
+  }
+  std::sort(asks.begin(), asks.end());
+  CHECK(book.validate());
+  checkHalf(CID(1), Side::Ask, asks);
+
+  book.clear(false);
+  add(CID(1), Side::Ask, 0.5123);
+  add(CID(1), Side::Ask, 0.5125);
+  add(CID(1), Side::Ask, 0.51);
+  CHECK(book.half(CID(1), Side::Ask).overflowSize() == 0);
+  checkHalf(CID(1), Side::Ask, {0.51, 0.5123, 0.5125});
+  CHECK(book.numLevels() == 3);
+  CHECK(book.maxNumLevels() == 206);
+  CHECK(book.validate());
+
+  // an empty sub-dollar ladder is moved to an off-tick price, so that it does not cover levels
+  // in overflow once it switches to the cent tick
+  add(CID(0), Side::Ask, 0.50);
+  add(CID(0), Side::Ask, 50.00);
+  remove(CID(0), Side::Ask, 0.50);
+  add(CID(0), Side::Ask, 50.005);
+  checkHalf(CID(0), Side::Ask, {50.00, 50.005});
+  remove(CID(0), Side::Ask, 50.00);
+  checkHalf(CID(0), Side::Ask, {50.005});
+  CHECK(book.validate());
+
+  // bids falling away from a stale top level, 5 levels at a time, slide the ladder along while
+  // it can cover the stale level, then move it to the touch once most levels are in overflow,
+  // leaving the stale level alone there
+  book.clear(false);
+  add(CID(0), Side::Bid, 100.00);
+  auto &bids = book.half(CID(0), Side::Bid);
+  size_t maxOverflow = 0;
+  for (int ii = 1; ii <= 1000; ++ii) {
+    add(CID(0), Side::Bid, 100.00 - ii * 0.01);
+    if (ii > 5) {
+      remove(CID(0), Side::Bid, 100.00 - (ii - 5) * 0.01);
+    }
+    if (ii == 500) {
+      CHECK(maxOverflow == 0);
+    }
+    maxOverflow = std::max(maxOverflow, bids.overflowSize());
+  }
+  CHECK(maxOverflow <= 5);
+  CHECK(bids.overflowSize() == 1);
+  checkHalf(CID(0), Side::Bid, {100.00, 90.04, 90.03, 90.02, 90.01, 90.00});
+  // the stale top going recenters the ladder on the touch
+  remove(CID(0), Side::Bid, 100.00);
+  CHECK(bids.overflowSize() == 0);
+  checkHalf(CID(0), Side::Bid, {90.04, 90.03, 90.02, 90.01, 90.00});
+  CHECK(book.validate());
+}
+
+
+TEST_CASE("order view") {
+  OrderBook book(BookID(6));
+  const Timestamp midnight = Timestamp{} + std::chrono::hours(24 * 18000);
+  book.setMidnight(midnight);
+  book.resize(CID(2));
+  book.reserveOrderWindow(64);
+
+  Listener listener;
+  book.addListener(&listener);
+
+  const Timestamp t1 = midnight + std::chrono::nanoseconds(34200123456789);
+  const Timestamp t2 = t1 + std::chrono::nanoseconds(1);
+  // one order in the window, one far below it in orders
+  auto order1 = book.newOrder(ReferenceNum(1000), CID(1), Side::Ask, 300, 12.3456, t1);
+  auto order2 = book.newOrder(ReferenceNum(3), CID(1), Side::Ask, 200, 12.3456, t1);
+  REQUIRE(order1 != nullptr);
+  REQUIRE(order2 != nullptr);
+  CHECK(book.levelOf(order1) == book.topLevel(CID(1), Side::Ask));
+  CHECK(book.levelOf(order2) == book.levelOf(order1));
+  CHECK(&book.levelOf(order1)->front() == order1);
+  CHECK(&book.levelOf(order1)->back() == order2);
+  CHECK(book.levelOf(order1)->size() == 2);
+
+  book.reduceOrderBy(order1, 100, t2);
+  REQUIRE(listener.lastOrder.has_value());
+  Order view = book.toOrder(order1);
+  CHECK(view.refNum == ReferenceNum(1000));
+  CHECK(view.cid == CID(1));
+  CHECK(view.side == Side::Ask);
+  CHECK(view.quantity == 200);
+  CHECK(view.price == 12.3456);
+  if (BOOKPROJ_ORDER_TIMESTAMPS) {
+    CHECK(view.createTime == t1);
+    CHECK(view.updateTime == t2);
+    CHECK(listener.lastOrder->updateTime == t2);
+    CHECK(listener.lastOrder->createTime == t1);
+  } else {
+    CHECK(view.updateTime == Timestamp{});
+  }
+
+  // deleting the head leaves the other order linked alone
+  book.deleteOrder(order1, t2);
+  CHECK(book.topLevel(CID(1), Side::Ask)->size() == 1);
+  CHECK(&book.topLevel(CID(1), Side::Ask)->front() == order2);
+  CHECK(book.validate());
+  book.removeListener(&listener);
+}
+
+// a listener bound at compile time needs not derive from BookListener
+struct CountingListener {
+  int events = 0;
+  Quantity lastQuantity = 0;
+  void onNewOrder(BookID, const Order *order) { count(order); }
+  void onDeleteOrder(BookID, const Order *order, Quantity) { count(order); }
+  void onReplaceOrder(BookID, const Order *, const Order *order) { count(order); }
+  void onExecOrder(BookID, const Order *order, Quantity, Quantity, const ExecInfo &) {
+    count(order);
+  }
+  void onUpdateOrder(BookID, const Order *order, Quantity, Price) { count(order); }
+
+private:
+  void count(const Order *order) {
+    ++events;
+    lastQuantity = order->quantity;
+  }
+};
+
+TEST_CASE("static listeners") {
+  Listener listener;
+  CountingListener counter;
+  StaticOrderBook<Listener, CountingListener> book(BookID(7), listener, counter);
+  book.resize(CID(2));
+
+  auto order1 = book.newOrder(ReferenceNum(1), CID(0), Side::Bid, 100, 100.00, Timestamp{});
+  CHECK((listener.newOrders == std::vector{std::tuple(BookID(7), ReferenceNum(1))}));
+  CHECK(counter.events == 1);
+  book.executeOrder(order1, 10, ExecInfo{}, Timestamp{});
+  CHECK(listener.execOrders.size() == 1);
+  CHECK(counter.lastQuantity == 90);
+  book.reduceOrderBy(ReferenceNum(1), 10, Timestamp{});
+  book.reduceOrderTo(ReferenceNum(1), 50, Timestamp{});
+  CHECK(listener.updateOrders.size() == 2);
+  CHECK(counter.lastQuantity == 50);
+  book.replaceOrder(ReferenceNum(1), ReferenceNum(2), 60, 100.01, Timestamp{});
+  CHECK((listener.replaceOrders ==
+         std::vector{std::tuple(BookID(7), ReferenceNum(1), ReferenceNum(2))}));
+  CHECK(counter.lastQuantity == 60);
+  book.newOrder(ReferenceNum(3), CID(1), Side::Ask, 100, 101.00, Timestamp{});
+  book.deleteOrder(ReferenceNum(2), Timestamp{});
+  book.clearBook(CID(1));
+  CHECK(listener.deleteOrders.size() == 2);
+  CHECK(counter.events == 8);
+  CHECK(book.numOrders() == 0);
+  CHECK(book.validate());
+
+  // no listeners at all
+  StaticOrderBook<> quiet(BookID(8));
+  quiet.resize(CID(1));
+  auto order = quiet.newOrder(ReferenceNum(1), CID(0), Side::Ask, 100, 10.00, Timestamp{});
+  quiet.executeOrder(order, 40, ExecInfo{}, Timestamp{});
+  CHECK(quiet.topLevel(CID(0), Side::Ask)->totalShares == 60);
+  quiet.deleteOrder(ReferenceNum(1), Timestamp{});
+  CHECK(quiet.numOrders() == 0);
+  CHECK(quiet.validate());
+}
+struct LevelRecorder : public LevelListener {
+  using Change = std::tuple<CID, Side, Price, Quantity, size_t, bool, bool>;
+  std::vector<Change> changes;
+
+  void onLevelChange(BookID, CID cid, Side side, Price price, Quantity totalShares,
+                     size_t numOrders, bool isNew, bool isRemoved) override {
+    changes.emplace_back(cid, side, price, totalShares, numOrders, isNew, isRemoved);
+  }
+
+  // changes since the last call
+  std::vector<Change> take() { return std::exchange(changes, {}); }
+};
+
+TEST_CASE("level changes") {
+  using Change = LevelRecorder::Change;
+  OrderBook book(BookID(0));
+  book.resize(CID(2));
+  LevelRecorder recorder;
+  book.addLevelListener(&recorder);
+
+  auto order1 = book.newOrder(ReferenceNum(1), CID(0), Side::Bid, 100, 100.00, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{Change(CID(0), Side::Bid, 100.00, 100, 1, true, false)}));
+  book.newOrder(ReferenceNum(2), CID(0), Side::Bid, 50, 100.00, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{Change(CID(0), Side::Bid, 100.00, 150, 2, false, false)}));
+  book.executeOrder(order1, 30, ExecInfo{}, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{Change(CID(0), Side::Bid, 100.00, 120, 2, false, false)}));
+  book.reduceOrderTo(ReferenceNum(2), 20, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{Change(CID(0), Side::Bid, 100.00, 90, 2, false, false)}));
+
+  // a replace moving the price changes two levels
+  auto order3 = book.replaceOrder(ReferenceNum(1), ReferenceNum(3), 70, 100.01, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{Change(CID(0), Side::Bid, 100.00, 20, 1, false, false),
+                     Change(CID(0), Side::Bid, 100.01, 70, 1, true, false)}));
+
+  // the only order of a level replaced at the same price, the level is removed and created
+  // again, but listeners see one change, or none if it ends up the same
+  book.replaceOrder(order3, ReferenceNum(4), 80, 100.01, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{Change(CID(0), Side::Bid, 100.01, 80, 1, false, false)}));
+  book.replaceOrder(ReferenceNum(4), ReferenceNum(5), 80, 100.01, Timestamp{});
+  CHECK(recorder.take().empty());
+
+  // a new order displacing one with the same refNum at the same level
+  book.newOrder(ReferenceNum(5), CID(0), Side::Bid, 10, 100.01, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{Change(CID(0), Side::Bid, 100.01, 10, 1, false, false)}));
+
+  book.reduceOrderBy(ReferenceNum(5), 10, Timestamp{});
+  CHECK((recorder.take() == std::vector{Change(CID(0), Side::Bid, 100.01, 0, 0, false, true)}));
+
+  book.newOrder(ReferenceNum(6), CID(0), Side::Bid, 10, 99.99, Timestamp{});
+  book.newOrder(ReferenceNum(7), CID(0), Side::Bid, 10, 99.99, Timestamp{});
+  recorder.take();
+  book.clearBook(CID(0));
+  auto changes = recorder.take();
+  std::ranges::sort(changes);
+  CHECK((changes == std::vector{Change(CID(0), Side::Bid, 99.99, 0, 0, false, true),
+                                Change(CID(0), Side::Bid, 100.00, 0, 0, false, true)}));
+  CHECK(book.numOrders() == 0);
+  book.removeLevelListener(&recorder);
+}
+
+// listens to levels only, order views are then never built
+struct TopOfBook {
+  Quantity bidShares = 0;
+  void onLevelChange(BookID, CID, Side side, Price, Quantity totalShares, size_t, bool, bool) {
+    if (side == Side::Bid) {
+      bidShares = totalShares;
+    }
+  }
+};
+
+TEST_CASE("static level listeners") {
+  static_assert(!StaticDispatch<TopOfBook>::enabled());
+  static_assert(StaticDispatch<TopOfBook>::levelsEnabled());
+  static_assert(!StaticDispatch<CountingListener>::levelsEnabled());
+
+  TopOfBook top;
+  CountingListener counter;
+  StaticOrderBook<TopOfBook, CountingListener> book(BookID(1), top, counter);
+  book.resize(CID(1));
+  auto order = book.newOrder(ReferenceNum(1), CID(0), Side::Bid, 100, 10.00, Timestamp{});
+  CHECK(top.bidShares == 100);
+  book.executeOrder(order, 40, ExecInfo{}, Timestamp{});
+  CHECK(top.bidShares == 60);
+  book.deleteOrder(ReferenceNum(1), Timestamp{});
+  CHECK(top.bidShares == 0);
+  CHECK(counter.events == 3);
+}
+
+struct BBORecorder : public BBOListener {
+  std::vector<std::tuple<CID, BBO>> changes;
+
+  void onBBOChange(BookID, CID cid, const BBO &bbo) override { changes.emplace_back(cid, bbo); }
+
+  std::vector<std::tuple<CID, BBO>> take() { return std::exchange(changes, {}); }
+};
+
+TEST_CASE("bbo") {
+  static_assert(StaticDispatch<BBORecorder>::bboEnabled());
+  static_assert(!StaticDispatch<Listener>::bboEnabled());
+
+  OrderBook book(BookID(0));
+  book.resize(CID(2));
+  BBORecorder recorder;
+  book.addBBOListener(&recorder);
+  const BBO::Quote none;
+
+  auto order1 = book.newOrder(ReferenceNum(1), CID(0), Side::Bid, 100, 100.00, Timestamp{});
+  CHECK((recorder.take() == std::vector{std::tuple(CID(0), BBO{{100.00, 100, 1}, none})}));
+  CHECK(book.bbo(CID(0)).bid == BBO::Quote{100.00, 100, 1});
+  CHECK(book.topLevel(CID(0), Side::Bid) == book.levelOf(order1));
+
+  // below the top, nothing to tell
+  auto order2 = book.newOrder(ReferenceNum(2), CID(0), Side::Bid, 50, 99.99, Timestamp{});
+  book.executeOrder(order2, 10, ExecInfo{}, Timestamp{});
+  CHECK(recorder.take().empty());
+  CHECK(book.bbo(CID(0)).bid == BBO::Quote{100.00, 100, 1});
+
+  book.newOrder(ReferenceNum(3), CID(0), Side::Ask, 30, 100.05, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{std::tuple(CID(0), BBO{{100.00, 100, 1}, {100.05, 30, 1}})}));
+  book.reduceOrderBy(order1, 20, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{std::tuple(CID(0), BBO{{100.00, 80, 1}, {100.05, 30, 1}})}));
+
+  // the top level is removed and created again, but the top stays the same
+  order1 = book.replaceOrder(order1, ReferenceNum(4), 80, 100.00, Timestamp{});
+  CHECK(recorder.take().empty());
+  CHECK(book.topLevel(CID(0), Side::Bid) == book.levelOf(order1));
+
+  book.deleteOrder(order1, Timestamp{});
+  CHECK((recorder.take() ==
+         std::vector{std::tuple(CID(0), BBO{{99.99, 40, 1}, {100.05, 30, 1}})}));
+  CHECK(book.topLevel(CID(0), Side::Bid)->price == 99.99);
+  CHECK(book.validate());
+
+  // other CIDs have their own BBO
+  book.newOrder(ReferenceNum(5), CID(1), Side::Ask, 10, 5.00, Timestamp{});
+  CHECK((recorder.take() == std::vector{std::tuple(CID(1), BBO{none, {5.00, 10, 1}})}));
+  CHECK(book.bbo(CID(0)) == BBO{{99.99, 40, 1}, {100.05, 30, 1}});
+
+  book.clearBook(CID(0));
+  auto changes = recorder.take();
+  REQUIRE(changes.size() == 2);
+  CHECK(changes.back() == std::tuple(CID(0), BBO{}));
+  CHECK(book.topLevel(CID(0), Side::Bid) == nullptr);
+  CHECK(book.nthLevel(CID(1), Side::Ask, 0)->price == 5.00);
+  CHECK(book.validate());
+  book.removeBBOListener(&recorder);
+}
+
+TEST_CASE("top levels") {
+  using Half = OrderBook::Half;
+  OrderBook book(BookID(0));
+  book.resize(CID(1));
+  auto &bids = book.half(CID(0), Side::Bid);
+
+  // on and off the tick, with a far away tail in overflow
+  std::vector<Price> prices;
+  for (size_t ii = 0; ii < Half::TopSize + 2; ++ii) {
+    prices.push_back(20.00 - ii * 0.005);
+  }
+  prices.push_back(1.00);
+  prices.push_back(0.5001);
+  uint64_t ref = 1;
+  for (Price price : prices | std::views::reverse) {
+    book.newOrder(ReferenceNum(ref++), CID(0), Side::Bid, 100, price, Timestamp{});
+  }
+
+  auto checkTops = [&] {
+    REQUIRE(book.validate());
+    REQUIRE(bids.numTopLevels() == std::min(prices.size(), Half::TopSize));
+    REQUIRE(bids.topLevels().size() == bids.numTopLevels());
+    CHECK(std::ranges::equal(bids.topPrices(), prices | std::views::take(bids.numTopLevels())));
+    for (size_t ii = 0; ii < prices.size(); ++ii) {
+      if (ii < bids.numTopLevels()) {
+        CHECK(bids.topLevel(ii)->price == prices[ii]);
+        CHECK(book.levelOf(bids.topLevels()[ii]) == bids.topLevel(ii));
+      }
+      CHECK(book.nthLevel(CID(0), Side::Bid, ii)->price == prices[ii]);
+    }
+    CHECK(book.nthLevel(CID(0), Side::Bid, prices.size()) == nullptr);
+  };
+  checkTops();
+
+  // the depth of the top levels follows their orders
+  // the second level is only checked when it is a top level
+  auto checkSecond = [&](Quantity shares, uint32_t numOrders) {
+    if constexpr (Half::TopSize >= 2) {
+      CHECK(bids.topShares()[1] == shares);
+      CHECK(bids.topNumOrders()[1] == numOrders);
+    }
+    CHECK(book.nthLevel(CID(0), Side::Bid, 1)->totalShares == shares);
+    CHECK(book.nthLevel(CID(0), Side::Bid, 1)->numOrders() == numOrders);
+  };
+  auto order = book.newOrder(ReferenceNum(ref++), CID(0), Side::Bid, 50, prices[1], Timestamp{});
+  checkSecond(150, 2);
+  book.reduceOrderBy(order, 20, Timestamp{});
+  checkSecond(130, 2);
+  book.reduceOrderTo(order, 10, Timestamp{});
+  checkSecond(110, 2);
+  const auto topRef = ReferenceNum(prices.size());
+  book.executeOrder(topRef, 40, ExecInfo{}, Timestamp{});
+  CHECK(bids.topShares()[0] == 60);
+  checkSecond(110, 2);
+  book.reduceOrderTo(topRef, 100, Timestamp{});
+  book.deleteOrder(order, Timestamp{});
+  checkSecond(100, 1);
+  CHECK(std::ranges::all_of(bids.topShares(), [](Quantity q) { return q == 100; }));
+  checkTops();
+
+  // removing top levels pulls up the next ones, from the ladder or overflow
+  while (!prices.empty()) {
+    book.deleteOrder(book.refNumOf(&book.topLevel(CID(0), Side::Bid)->front()), Timestamp{});
+    prices.erase(prices.begin());
+    checkTops();
+  }
+  CHECK(bids.numTopLevels() == 0);
+  // the peak of levels stays, for sizing the next day
+  CHECK(bids.maxSize() == Half::TopSize + 4);
+  CHECK(book.maxNumLevels(CID(0)) == Half::TopSize + 4);
+
+  // a half reserved ahead takes levels as one allocated by its first level
+  book.reserveLevels(CID(0), 10);
+  book.newOrder(ReferenceNum(ref++), CID(0), Side::Ask, 100, 20.01, Timestamp{});
+  CHECK(book.half(CID(0), Side::Ask).maxSize() == 1);
+  CHECK(book.maxNumLevels(CID(0)) == Half::TopSize + 5);
+  CHECK(book.validate());
+}
+
+TEST_CASE("apply batch") {
+  // random operations on live orders, some of them outliers of the order window
+  std::mt19937 rng(7);
+  std::vector<BookOp> ops;
+  std::vector<std::pair<ReferenceNum, Quantity>> live;
+  uint64_t nextRef = 1;
+  for (size_t ii = 0; ii < 3000; ++ii) {
+    const Timestamp tm{};
+    const Price price = 10.00 + (rng() % 40) * 0.01;
+    const uint32_t pick = rng() % 10;
+    if (live.size() < 20 || pick < 4) {
+      const auto ref = ReferenceNum(rng() % 50 ? nextRef++ : 1000000 + ii);
+      live.emplace_back(ref, 100);
+      ops.push_back(BookOp::newOrder(ref, CID(rng() % 3), rng() % 2 ? Side::Bid : Side::Ask, 100,
+                                     price, tm));
+      continue;
+    }
+    const size_t at = rng() % live.size();
+    auto &[ref, quantity] = live[at];
+    if (pick == 4 && quantity > 10) {
+      ops.push_back(BookOp::reduceOrderBy(ref, 10, tm));
+      quantity -= 10;
+    } else if (pick == 5 && quantity > 1) {
+      quantity /= 2;
+      ops.push_back(BookOp::reduceOrderTo(ref, quantity, tm));
+    } else if (pick == 6 && quantity > 10) {
+      ops.push_back(BookOp::executeOrder(ref, 10, ExecInfo{}, tm));
+      quantity -= 10;
+    } else if (pick == 7) {
+      const auto newRef = ReferenceNum(nextRef++);
+      ops.push_back(BookOp::replaceOrder(ref, newRef, 200, price, tm));
+      live[at] = {newRef, 200};
+    } else {
+      ops.push_back(BookOp::deleteOrder(ref, tm));
+      live.erase(live.begin() + at);
+    }
+  }
+
+  auto run = [&](size_t batchSize, Listener &listener, LevelRecorder &levels) {
+    OrderBook book(BookID(0));
+    book.resize(CID(3));
+    book.reserveOrderWindow(1000);
+    book.addListener(&listener);
+    book.addLevelListener(&levels);
+    std::span<const BookOp> rest(ops);
+    while (!rest.empty()) {
+      const size_t size = std::min(batchSize, rest.size());
+      if (size == 1) {
+        book.apply(rest.front());
+      } else {
+        book.apply(rest.first(size));
+      }
+      rest = rest.subspan(size);
+    }
+    REQUIRE(book.validate());
+    CHECK(book.numOrders() == live.size());
+    book.removeListener(&listener);
+    book.removeLevelListener(&levels);
+  };
+
+  Listener expected;
+  LevelRecorder expectedLevels;
+  run(1, expected, expectedLevels);
+  CHECK(expected.deleteOrders.size() > 100);
+  CHECK(expected.replaceOrders.size() > 100);
+  for (size_t batchSize : {size_t(3), size_t(32), ops.size()}) {
+    Listener listener;
+    LevelRecorder levels;
+    run(batchSize, listener, levels);
+    CHECK(listener.newOrders == expected.newOrders);
+    CHECK(listener.deleteOrders == expected.deleteOrders);
+    CHECK(listener.replaceOrders == expected.replaceOrders);
+    CHECK(listener.execOrders == expected.execOrders);
+    CHECK(listener.updateOrders == expected.updateOrders);
+    CHECK(levels.changes == expectedLevels.changes);
+  }
+}
+
+TEST_CASE("checkpoint") {
+  // random operations, half of them applied before the checkpoint and half after it
+  std::mt19937 rng(11);
+  std::vector<BookOp> ops;
+  std::vector<std::pair<ReferenceNum, Quantity>> live;
+  uint64_t nextRef = 1;
+  for (size_t ii = 0; ii < 4000; ++ii) {
+    const Timestamp tm(std::chrono::nanoseconds(1000 + ii));
+    const Price price = rng() % 20 ? 10.00 + (rng() % 40) * 0.01 : 30.00 + (rng() % 9) * 0.1;
+    const uint32_t pick = rng() % 10;
+    if (live.size() < 20 || pick < 5) {
+      const auto ref = ReferenceNum(rng() % 50 ? nextRef++ : 1000000 + ii);
+      live.emplace_back(ref, 100);
+      ops.push_back(BookOp::newOrder(ref, CID(rng() % 3), rng() % 2 ? Side::Bid : Side::Ask, 100,
+                                     price, tm));
+      continue;
+    }
+    const size_t at = rng() % live.size();
+    auto &[ref, quantity] = live[at];
+    if (pick == 5 && quantity > 10) {
+      ops.push_back(BookOp::executeOrder(ref, 10, ExecInfo{}, tm));
+      quantity -= 10;
+    } else if (pick == 6) {
+      const auto newRef = ReferenceNum(nextRef++);
+      ops.push_back(BookOp::replaceOrder(ref, newRef, 200, price, tm));
+      live[at] = {newRef, 200};
+    } else {
+      ops.push_back(BookOp::deleteOrder(ref, tm));
+      live.erase(live.begin() + at);
+    }
+  }
+  const std::span<const BookOp> before = std::span(ops).first(ops.size() / 2);
+  const std::span<const BookOp> after = std::span(ops).subspan(ops.size() / 2);
+
+  // levels and orders of the book in priority order, as listeners see them
+  auto dump = [](const OrderBook &book) {
+    std::vector<std::tuple<CID, Side, Price, Quantity, ReferenceNum, Quantity, Timestamp,
+                           Timestamp>>
+        out;
+    for (int cid = 0; cid < 3; ++cid) {
+      for (Side side : {Side::Bid, Side::Ask}) {
+        for (const auto &[price, level] : book.half(CID(cid), side)) {
+          for (const auto &order : *level) {
+            const Order view = book.toOrder(&order);
+            out.emplace_back(view.cid, view.side, price, level->totalShares, view.refNum,
+                             view.quantity, view.createTime, view.updateTime);
+          }
+        }
+      }
+    }
+    return out;
+  };
+
+  for (size_t windowSize : {size_t(0), size_t(1000)}) {
+    OrderBook book(BookID(0));
+    book.resize(CID(3));
+    book.reserveOrderWindow(windowSize);
+    book.apply(before);
+    std::stringstream out;
+    const size_t size = book.writeCheckpoint(out);
+    const std::string bytes = out.str();
+    REQUIRE(bytes.size() == size);
+    // read in place from 8-byte aligned memory, as from a mapped file
+    std::vector<uint64_t> aligned(size / 8);
+    std::memcpy(aligned.data(), bytes.data(), size);
+    const std::span<const std::byte> data(reinterpret_cast<const std::byte *>(aligned.data()),
+                                          size);
+
+    OrderBook restored(BookID(0));
+    restored.reserveOrderWindow(windowSize);
+    REQUIRE(restored.restoreCheckpoint(data) == size);
+    REQUIRE(restored.validate());
+    CHECK(restored.numOrders() == book.numOrders());
+    CHECK(restored.numLevels() == book.numLevels());
+    CHECK(restored.maxNumOrders() == book.maxNumOrders());
+    CHECK(restored.maxNumLevels() == book.maxNumLevels());
+    CHECK(dump(restored) == dump(book));
+    bool sameBBO = true;
+    for (int cid = 0; cid < 3; ++cid) {
+      sameBBO = sameBBO && restored.bbo(CID(cid)) == book.bbo(CID(cid));
+    }
+    CHECK(sameBBO);
+
+    // both books go on the same
+    Listener expected, listener;
+    book.addListener(&expected);
+    restored.addListener(&listener);
+    book.apply(after);
+    restored.apply(after);
+    REQUIRE(restored.validate());
+    CHECK(dump(restored) == dump(book));
+    CHECK(listener.deleteOrders == expected.deleteOrders);
+    CHECK(listener.replaceOrders == expected.replaceOrders);
+    CHECK(listener.execOrders == expected.execOrders);
+    book.removeListener(&expected);
+    restored.removeListener(&listener);
+
+    OrderBook bad(BookID(2));
+    CHECK_THROWS_AS(bad.restoreCheckpoint(data.first(size - 1)), std::runtime_error);
+
+    // corrupt copies: a level count whose size wraps around to the right one, CID counts out
+    // of range, a level of no side, an order of no quantity and an order record left over
+    auto restoreCorrupt = [&](auto &&corrupt) {
+      std::vector<uint64_t> copy(aligned);
+      copy.resize(copy.size() + sizeof(OrderBook::CheckpointOrder) / 8);
+      OrderBook::CheckpointHeader header;
+      OrderBook::CheckpointLevel level;
+      OrderBook::CheckpointOrder order;
+      std::memcpy(&header, copy.data(), sizeof(header));
+      const size_t orderAt = (sizeof(header) + header.numLevels * sizeof(level)) / 8;
+      std::memcpy(&level, copy.data() + sizeof(header) / 8, sizeof(level));
+      std::memcpy(&order, copy.data() + orderAt, sizeof(order));
+      corrupt(header, level, order);
+      std::memcpy(copy.data(), &header, sizeof(header));
+      std::memcpy(copy.data() + sizeof(header) / 8, &level, sizeof(level));
+      std::memcpy(copy.data() + orderAt, &order, sizeof(order));
+      OrderBook corrupted(BookID(3));
+      corrupted.reserveOrderWindow(windowSize);
+      corrupted.restoreCheckpoint(std::as_bytes(std::span(copy)));
+    };
+    CHECK_NOTHROW(restoreCorrupt([](auto &, auto &, auto &) {}));
+    CHECK_THROWS_AS(restoreCorrupt([](auto &header, auto &, auto &) {
+                      header.numLevels += uint64_t(1) << 61;
+                    }),
+                    std::runtime_error);
+    CHECK_THROWS_AS(restoreCorrupt([](auto &header, auto &, auto &) {
+                      header.numCids = (uint64_t(1) << 32) + 2;
+                    }),
+                    std::runtime_error);
+    CHECK_THROWS_AS(restoreCorrupt([](auto &header, auto &, auto &) {
+                      header.numCids = uint64_t(std::numeric_limits<int32_t>::max());
+                    }),
+                    std::runtime_error);
+    CHECK_THROWS_AS(restoreCorrupt([](auto &, auto &level, auto &) { level.side = Side(2); }),
+                    std::runtime_error);
+    CHECK_THROWS_AS(restoreCorrupt([](auto &, auto &, auto &order) { order.quantity = 0; }),
+                    std::runtime_error);
+    CHECK_THROWS_AS(restoreCorrupt([](auto &header, auto &, auto &) { ++header.numOrders; }),
+                    std::runtime_error);
+  }
+}
+
+TEST_CASE("chunk provider") {
+  using bookproj::ChunkBacking;
+  using bookproj::ObjectPool;
+  auto heapChunks = [](const bookproj::ChunkCounts &counts) {
+    return counts[size_t(ChunkBacking::Heap)];
+  };
+  auto numChunks = [](const bookproj::ChunkCounts &counts) {
+    return std::accumulate(counts.begin(), counts.end(), size_t(0));
+  };
+
+  // objects spanning several huge page chunks
+  ObjectPool<uint64_t> pool(1 << 18);
+  pool.setChunkProvider(bookproj::HugePageChunkProvider::instance());
+  std::vector<ObjectPool<uint64_t>::Handle> indices;
+  for (uint64_t ii = 0; ii < 600000; ++ii) {
+    indices.push_back(pool.create(ii).first);
+  }
+  bool same = true;
+  for (uint64_t ii = 0; ii < indices.size(); ++ii) {
+    same = same && *pool[indices[ii]] == ii;
+    pool.destroy(indices[ii]);
+  }
+  CHECK(same);
+  CHECK(numChunks(pool.chunkCounts()) == 3);
+  CHECK(heapChunks(pool.chunkCounts()) == 0);
+  CHECK(bookproj::toString(pool.chunkCounts()).starts_with("3 "));
+
+  ObjectPool<uint64_t> heapPool(1 << 10);
+  CHECK(bookproj::toString(heapPool.chunkCounts()) == "none");
+  heapPool.reserve(1);
+  CHECK(bookproj::toString(heapPool.chunkCounts()) == "1 heap");
+
+  OrderBook book(BookID(0));
+  book.setChunkProvider(bookproj::HugePageChunkProvider::instance());
+  book.resize(CID(2));
+  for (uint64_t ii = 1; ii <= 1000; ++ii) {
+    book.newOrder(ReferenceNum(ii), CID(ii % 2), ii % 3 ? Side::Bid : Side::Ask, 100,
+                  10.00 + (ii % 50) * 0.01, Timestamp{});
+  }
+  CHECK(book.validate());
+  CHECK(numChunks(book.orderChunks()) == 1);
+  CHECK(heapChunks(book.orderChunks()) == 0);
+  CHECK(numChunks(book.levelChunks()) == 1);
+  CHECK(heapChunks(book.levelChunks()) == 0);
+}
+
+TEST_CASE("compaction") {
+  // a peak of orders at many levels, most of which are then deleted
+  std::mt19937 rng(13);
+  std::vector<BookOp> peak, drop;
+  std::vector<ReferenceNum> live;
+  for (uint64_t ii = 0; ii < 800000; ++ii) {
+    const auto ref = ReferenceNum(ii + 1);
+    peak.push_back(BookOp::newOrder(ref, CID(ii % 3), (ii / 3) % 2 ? Side::Ask : Side::Bid, 100,
+                                    1.00 + int64_t((ii / 6) % 25000) * 0.01, Timestamp{}));
+    if (rng() % 20 != 0) {
+      drop.push_back(BookOp::deleteOrder(ref, Timestamp{}));
+    } else {
+      live.push_back(ref);
+    }
+  }
+  // later operations, some of them in between compaction steps
+  std::vector<BookOp> later;
+  for (uint64_t ii = 0; ii < 4000; ++ii) {
+    const auto ref = ReferenceNum(1000000 + ii);
+    later.push_back(BookOp::newOrder(ref, CID(ii % 3), ii % 2 ? Side::Ask : Side::Bid, 100,
+                                     1.00 + int64_t(rng() % 25000) * 0.01, Timestamp{}));
+    if (ii % 2 == 0) {
+      const size_t at = rng() % live.size();
+      later.push_back(BookOp::executeOrder(live[at], 10, ExecInfo{}, Timestamp{}));
+      later.push_back(BookOp::deleteOrder(live[at], Timestamp{}));
+      live.erase(live.begin() + at);
+    }
+  }
+
+  auto dump = [](const OrderBook &book) {
+    std::vector<std::tuple<CID, Side, Price, Quantity, ReferenceNum, Quantity>> out;
+    for (int cid = 0; cid < 3; ++cid) {
+      for (Side side : {Side::Bid, Side::Ask}) {
+        for (const auto &[price, level] : book.half(CID(cid), side)) {
+          for (const auto &order : *level) {
+            const Order view = book.toOrder(&order);
+            out.emplace_back(view.cid, view.side, price, level->totalShares, view.refNum,
+                             view.quantity);
+          }
+        }
+      }
+    }
+    return out;
+  };
+  auto numChunks = [](const bookproj::ChunkCounts &counts) {
+    return std::accumulate(counts.begin(), counts.end(), size_t(0));
+  };
+
+  OrderBook book(BookID(0)), expected(BookID(0));
+  for (OrderBook *b : {&book, &expected}) {
+    b->resize(CID(3));
+    b->apply(peak);
+    b->apply(drop);
+  }
+  // with slabs, a level whose tail slab is full takes a new one and leaves free slots behind
+  CHECK(numChunks(book.orderChunks()) == (BOOKPROJ_ORDER_SLABS ? 7 : 4));
+  CHECK(numChunks(book.levelChunks()) == 3);
+
+  Listener listener, expectedListener;
+  book.addListener(&listener);
+  expected.addListener(&expectedListener);
+  std::span<const BookOp> rest(later);
+  size_t steps = 0;
+  bool valid = true;
+  while (book.compact(1000)) {
+    ++steps;
+    const size_t size = std::min(rest.size(), size_t(10));
+    book.apply(rest.first(size));
+    expected.apply(rest.first(size));
+    rest = rest.subspan(size);
+    valid = valid && (steps % 20 != 0 || book.validate());
+  }
+  CHECK(valid);
+  CHECK(steps > 10);
+  REQUIRE(book.validate());
+  CHECK(numChunks(book.orderChunks()) == 1);
+  CHECK(numChunks(book.levelChunks()) == 1);
+  CHECK(dump(book) == dump(expected));
+
+  book.apply(rest);
+  expected.apply(rest);
+  REQUIRE(book.validate());
+  CHECK(dump(book) == dump(expected));
+  CHECK(listener.newOrders == expectedListener.newOrders);
+  CHECK(listener.deleteOrders == expectedListener.deleteOrders);
+  CHECK(listener.execOrders == expectedListener.execOrders);
+  bool sameBBO = true;
+  for (int cid = 0; cid < 3; ++cid) {
+    sameBBO = sameBBO && book.bbo(CID(cid)) == expected.bbo(CID(cid));
+  }
+  CHECK(sameBBO);
+  book.removeListener(&listener);
+  expected.removeListener(&expectedListener);
+
+  // objects are charged their cost, one costing more than the moves left waits for the next call
+  // and is moved alone if it costs more than a call has
+  using Pool = bookproj::ObjectPool<uint64_t>;
+  Pool pool(64);
+  std::vector<Pool::Handle> handles;
+  for (uint64_t ii = 0; ii < 192; ++ii) {
+    handles.push_back(pool.create(ii).first);
+  }
+  for (uint64_t ii = 0; ii < 128; ++ii) {
+    if (ii % 8 != 0) {
+      pool.destroy(handles[ii]);
+      handles[ii] = Pool::Handle();
+    }
+  }
+  auto cost = [&](Pool::Handle handle) { return *pool[handle] % 10 == 3 ? size_t(20) : 1; };
+  bool bounded = true;
+  size_t alone = 0;
+  while (true) {
+    size_t moves = 0, objects = 0;
+    const bool more = pool.compact(
+        8,
+        [&](Pool::Handle from, Pool::Handle to) {
+          *std::ranges::find(handles, from) = to;
+          moves += cost(to);
+          ++objects;
+        },
+        cost);
+    bounded = bounded && (moves <= 8 || objects == 1);
+    alone += moves == 20;
+    if (!more) {
+      break;
+    }
+  }
+  CHECK(bounded);
+  CHECK(alone == 6);
+  CHECK(pool.numChunks() == 2);
+  CHECK(pool.numAllocated() == 80);
+  bool same = true;
+  for (uint64_t ii = 0; ii < handles.size(); ++ii) {
+    if (handles[ii]) {
+      same = same && *pool[handles[ii]] == ii;
+      pool.destroy(handles[ii]);
+    }
+  }
+  CHECK(same);
+
+  // a level deeper than maxMoves in the last level chunk, moved by a call of its own
+  OrderBook deep(BookID(0));
+  deep.resize(CID(3));
+  const size_t numLevels = 60000;
+  uint64_t ref = 1;
+  for (size_t ii = 0; ii < numLevels; ++ii) {
+    deep.newOrder(ReferenceNum(ref++), CID(0), Side::Ask, 100, 1.00 + int64_t(ii) * 0.01,
+                  Timestamp{});
+  }
+  for (size_t ii = 0; ii < 2000; ++ii) {
+    deep.newOrder(ReferenceNum(ref++), CID(0), Side::Bid, 100, 0.50, Timestamp{});
+  }
+  for (size_t ii = 0; ii < numLevels - 10000; ++ii) {
+    if (ii % 20 != 0) {
+      deep.deleteOrder(ReferenceNum(ii + 1), Timestamp{});
+    }
+  }
+  CHECK(numChunks(deep.levelChunks()) == 2);
+  const auto before = dump(deep);
+  steps = 0;
+  while (deep.compact(16)) {
+    ++steps;
+  }
+  REQUIRE(deep.validate());
+  CHECK(numChunks(deep.levelChunks()) == 1);
+  CHECK(dump(deep) == before);
+  CHECK(deep.half(CID(0), Side::Bid).top()->numOrders() == 2000);
+}
+
+TEST_CASE("slab pool") {
+  using Pool = bookproj::SlabPool<uint64_t, 8>;
+  // 4 slabs per chunk, 32 objects
+  Pool pool(4);
+  auto slabOf = [](Pool::Handle handle) { return handle.index() / 8; };
+
+  // a run fills the slab of its first object, then goes on in a slab of its own
+  std::vector<Pool::Handle> run{pool.create(Pool::Handle(), false, 0).first};
+  for (uint64_t ii = 1; ii < 10; ++ii) {
+    run.push_back(pool.create(run.back(), true, ii).first);
+  }
+  for (uint64_t ii = 0; ii < run.size(); ++ii) {
+    CHECK(*pool[run[ii]] == ii);
+    CHECK(slabOf(run[ii]) == slabOf(run[ii < 8 ? 0 : 8]));
+  }
+  CHECK(slabOf(run[8]) != slabOf(run[0]));
+  CHECK(pool.numSlabs() == 2);
+
+  // objects not near another share a slab, slabs of runs are shared once they free a slot
+  const Pool::Handle shared = pool.create(Pool::Handle(), false, 100).first;
+  CHECK(pool.numSlabs() == 3);
+  pool.destroy(run[3]);
+  const Pool::Handle reused = pool.create(Pool::Handle(), false, 103).first;
+  CHECK(reused == run[3]);
+  CHECK(*pool[reused] == 103);
+  run[3] = reused;
+  CHECK(slabOf(pool.create(Pool::Handle(), false, 101).first) == slabOf(shared));
+
+  // a slab is given back with its last object
+  pool.destroy(run[8]);
+  pool.destroy(run[9]);
+  CHECK(pool.numSlabs() == 2);
+  pool.destroy(shared);
+  pool.destroy(Pool::Handle(shared.index() + 1));
+  CHECK(pool.numSlabs() == 1);
+  CHECK(pool.numAllocated() == 8);
+
+  // runs over several chunks, most objects of which are destroyed, are compacted to one chunk
+  std::vector<std::pair<Pool::Handle, uint64_t>> live;
+  for (uint64_t ii = 0; ii < 8; ++ii) {
+    live.emplace_back(run[ii], *pool[run[ii]]);
+  }
+  std::vector<Pool::Handle> dead;
+  Pool::Handle near;
+  for (uint64_t ii = 0; ii < 120; ++ii) {
+    near = pool.create(ii % 24 == 0 ? Pool::Handle() : near, true, 1000 + ii).first;
+    if (ii % 9 == 0) {
+      live.emplace_back(near, 1000 + ii);
+    } else {
+      dead.push_back(near);
+    }
+  }
+  CHECK(pool.numChunks() == 4);
+  for (Pool::Handle handle : dead) {
+    pool.destroy(handle);
+  }
+  size_t steps = 0;
+  bool known = true;
+  while (pool.compact(4, [&](Pool::Handle from, Pool::Handle to) {
+    auto iter = std::ranges::find(live, from, &std::pair<Pool::Handle, uint64_t>::first);
+    known = known && iter != live.end();
+    if (iter != live.end()) {
+      iter->first = to;
+    }
+  })) {
+    ++steps;
+  }
+  CHECK(known);
+  CHECK(steps > 1);
+  CHECK(pool.numChunks() == 1);
+  CHECK(pool.numAllocated() == live.size());
+  bool same = true;
+  for (const auto &[handle, value] : live) {
+    same = same && *pool[handle] == value;
+    pool.destroy(handle);
+  }
+  CHECK(same);
+  CHECK(pool.numSlabs() == 0);
+}
+
+namespace {
+// a book of levels deep enough to have slabs of their own, built with orders added to them in
+// turn and deleted at random, as a day of quotes does
+OrderBook &deepLevels(OrderBook &book, int numLevels, int depth) {
+  book.resize(CID(1));
+  std::mt19937 rng(5);
+  std::vector<ReferenceNum> live;
+  uint64_t ref = 0;
+  while (live.size() < size_t(numLevels * depth)) {
+    for (int ii = 0; ii < numLevels; ++ii) {
+      live.push_back(ReferenceNum(++ref));
+      book.newOrder(live.back(), CID(0), ii % 2 ? Side::Ask : Side::Bid, 100,
+                    10.00 + (ii % 2 ? 1 : -1) * (ii / 2) * 0.01, Timestamp{});
+    }
+    for (int ii = 0; ii < numLevels / 4; ++ii) {
+      const size_t at = rng() % live.size();
+      book.deleteOrder(live[at], Timestamp{});
+      live[at] = live.back();
+      live.pop_back();
+    }
+  }
+  return book;
+}
+} // namespace
+
+TEST_CASE("order slabs") {
+  OrderBook book(BookID(0));
+  deepLevels(book, 16, 40);
+  REQUIRE(book.validate());
+  // orders of a level next to each other in memory, as adjacent slots of a slab
+  size_t pairs = 0, adjacent = 0;
+  for (Side side : {Side::Bid, Side::Ask}) {
+    for (const auto &[price, level] : book.half(CID(0), side)) {
+      const std::byte *last = nullptr;
+      for (const auto &order : *level) {
+        const auto *at = reinterpret_cast<const std::byte *>(&order);
+        adjacent += last != nullptr && at - last == sizeof(order);
+        pairs += last != nullptr;
+        last = at;
+      }
+    }
+  }
+  CHECK(pairs == book.numOrders() - book.numLevels());
+  if (BOOKPROJ_ORDER_SLABS) {
+    CHECK(adjacent * 2 > pairs);
+  }
+
+  // the memory of levels removed is taken by new ones
+  auto numChunks = [&book] {
+    const bookproj::ChunkCounts counts = book.orderChunks();
+    return std::accumulate(counts.begin(), counts.end(), size_t(0));
+  };
+  const size_t chunks = numChunks();
+  for (int ii = 0; ii < 4; ++ii) {
+    for (size_t n = book.topLevel(CID(0), Side::Bid)->size(); n > 0; --n) {
+      book.deleteOrder(book.refNumOf(&book.topLevel(CID(0), Side::Bid)->front()), Timestamp{});
+    }
+  }
+  for (uint64_t ii = 0; ii < 4 * 40; ++ii) {
+    book.newOrder(ReferenceNum(100000 + ii), CID(0), Side::Bid, 100, 20.00 + (ii % 4) * 0.01,
+                  Timestamp{});
+  }
+  CHECK(numChunks() == chunks);
+  CHECK(book.validate());
+}
+
+TEST_CASE("order slab benchmarks", "[.][benchmark]") {
+  OrderBook book(BookID(0));
+  deepLevels(book, 2000, 64);
+  std::vector<const OrderBook::Level *> levels;
+  for (Side side : {Side::Bid, Side::Ask}) {
+    for (const auto &[price, level] : book.half(CID(0), side)) {
+      levels.push_back(level);
+    }
+  }
+
+  BENCHMARK("level walk") {
+    uint64_t shares = 0;
+    for (const OrderBook::Level *level : levels) {
+      for (const auto &order : *level) {
+        shares += order.quantity;
+      }
+    }
+    return shares;
+  };
+  // shares ahead of each order of the first levels
+  BENCHMARK("queue position") {
+    uint64_t ahead = 0;
+    for (size_t ii = 0; ii < 100; ++ii) {
+      for (const auto &target : *levels[ii]) {
+        for (const auto &order : *levels[ii]) {
+          if (&order == &target) {
+            break;
+          }
+          ahead += order.quantity;
+        }
+      }
+    }
+    return ahead;
+  };
 }
\ No newline at end of file
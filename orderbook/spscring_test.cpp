@@ -0,0 +1,62 @@
+#include "SPSCRing.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <thread>
+
+using namespace bookproj;
+
+TEST_CASE("basic") {
+  SPSCRing<uint64_t> ring(3);
+  CHECK(ring.tryPush(1));
+  CHECK(ring.tryPush(2));
+  CHECK(ring.tryPush(3));
+  CHECK(ring.tryPush(4));
+  // capacity is rounded up to 4
+  CHECK(!ring.tryPush(5));
+
+  auto items = ring.front();
+  REQUIRE(items.size() == 4);
+  CHECK(items[0] == 1);
+  CHECK(items[3] == 4);
+  ring.pop(3);
+  CHECK(ring.tryPush(5));
+  CHECK(ring.tryPush(6));
+
+  // front stops at the end of the buffer
+  items = ring.front();
+  REQUIRE(items.size() == 1);
+  CHECK(items[0] == 4);
+  ring.pop(1);
+  items = ring.front();
+  REQUIRE(items.size() == 2);
+  CHECK(items[0] == 5);
+  CHECK(items[1] == 6);
+  ring.pop(2);
+
+  ring.close();
+  CHECK(ring.front().empty());
+}
+
+TEST_CASE("threads") {
+  // items arrive in order and none are lost when the producer closes right after its last push
+  constexpr uint64_t N = 1'000'000;
+  SPSCRing<uint64_t> ring(64);
+  std::thread producer([&] {
+    for (uint64_t ii = 0; ii < N; ++ii) {
+      ring.push(ii);
+    }
+    ring.close();
+  });
+  uint64_t expected = 0;
+  bool inOrder = true;
+  for (auto items = ring.front(); !items.empty(); items = ring.front()) {
+    for (uint64_t item : items) {
+      inOrder &= item == expected++;
+    }
+    ring.pop(items.size());
+  }
+  producer.join();
+  CHECK(inOrder);
+  CHECK(expected == N);
+}
\ No newline at end of file